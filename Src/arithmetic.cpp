@@ -0,0 +1,159 @@
+#include "interpreter.h"
+#include <cmath>
+
+namespace {
+
+bool isTermOperator(TokenType type) {
+    return type == TokenType::PLUS || type == TokenType::MINUS;
+}
+
+// Everything the factor level of the grammar parses, including the power
+// and tensor operators the lexer produces
+bool isFactorOperator(TokenType type) {
+    switch (type) {
+        case TokenType::MULTIPLY:
+        case TokenType::DIVIDE:
+        case TokenType::MODULO:
+        case TokenType::POWER:
+        case TokenType::MATRIX_MULTIPLY:
+        case TokenType::TENSOR_DOT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool endsStatement(const std::vector<Token>& tokens, size_t pos) {
+    if (pos >= tokens.size()) return true;
+    TokenType type = tokens[pos].type;
+    return type == TokenType::SEMICOLON || type == TokenType::RIGHT_BRACE ||
+           type == TokenType::NEWLINE || type == TokenType::EOF_TOKEN;
+}
+
+// True when the expression at pos uses nothing looser than + and - at the top
+// level, so evaluateUpdate can parse it as a term without losing operators
+bool isArithmeticOnly(const std::vector<Token>& tokens, size_t pos) {
+    int depth = 0;
+    for (; pos < tokens.size(); ++pos) {
+        TokenType type = tokens[pos].type;
+        if (type == TokenType::LEFT_PAREN || type == TokenType::LEFT_BRACKET) {
+            depth++;
+        } else if (type == TokenType::RIGHT_PAREN || type == TokenType::RIGHT_BRACKET) {
+            if (--depth < 0) return false;
+        } else if (depth > 0) {
+            continue;
+        } else if (endsStatement(tokens, pos)) {
+            return true;
+        } else if (!isTermOperator(type) && !isFactorOperator(type) &&
+                   type != TokenType::IDENTIFIER && type != TokenType::NUMBER &&
+                   type != TokenType::STRING && type != TokenType::DOT) {
+            return false;
+        }
+    }
+    return depth == 0;
+}
+
+} // namespace
+
+// Consumes left, so a temporary's string or tensor buffer is reused
+Value NexusInterpreter::applyOperator(Value&& left, TokenType op, const Value& right) {
+    switch (op) {
+        case TokenType::PLUS: return std::move(left) + right;
+        case TokenType::MINUS: return std::move(left) - right;
+        case TokenType::MULTIPLY: return std::move(left) * right;
+        case TokenType::DIVIDE: return std::move(left) / right;
+        case TokenType::POWER: return Value(std::pow(left.asNumber(), right.asNumber()));
+        case TokenType::MATRIX_MULTIPLY: return left.matmul(right);
+        case TokenType::TENSOR_DOT: return left.dot(right);
+        default: return left % right;
+    }
+}
+
+// PLUS and MINUS at the term level; MULTIPLY, DIVIDE, MODULO, POWER,
+// MATRIX_MULTIPLY and TENSOR_DOT at the factor level.
+//
+// Every intermediate result is an owned temporary, so after the first
+// operation the chain updates one buffer: 'a + b + c + d' allocates once
+Value NexusInterpreter::evaluateTerm(const std::vector<Token>& tokens, size_t& pos) {
+    Value left = evaluateFactor(tokens, pos);
+    while (pos < tokens.size() && isTermOperator(tokens[pos].type)) {
+        TokenType op = tokens[pos++].type;
+        Value right = evaluateFactor(tokens, pos);
+        left = applyOperator(std::move(left), op, right);
+    }
+    return left;
+}
+
+Value NexusInterpreter::evaluateFactor(const std::vector<Token>& tokens, size_t& pos) {
+    Value left = evaluateUnary(tokens, pos);
+    while (pos < tokens.size() && isFactorOperator(tokens[pos].type)) {
+        TokenType op = tokens[pos++].type;
+        Value right = evaluateUnary(tokens, pos);
+        left = applyOperator(std::move(left), op, right);
+    }
+    return left;
+}
+
+// Right-hand side of 'target = ...'. For 'target op operand;' the old value
+// dies with the assignment, so the variable is updated in place rather than
+// copied. Longer chains copy once at the first operation and reuse that
+// temporary.
+Value NexusInterpreter::evaluateUpdate(const std::vector<Token>& tokens, size_t& pos,
+                                       const std::string& target) {
+    if (!check(tokens, pos, TokenType::IDENTIFIER) || tokens[pos].value != target ||
+        pos + 1 >= tokens.size() ||
+        !(isTermOperator(tokens[pos + 1].type) || isFactorOperator(tokens[pos + 1].type)) ||
+        !isArithmeticOnly(tokens, pos)) {
+        return evaluateExpression(tokens, pos);
+    }
+
+    const Token& name = tokens[pos++];
+    TokenType op = tokens[pos++].type;
+    Value operand = isTermOperator(op) ? evaluateFactor(tokens, pos) : evaluateUnary(tokens, pos);
+    if (endsStatement(tokens, pos)) {
+        return updateVariable(name, op, operand);
+    }
+
+    Value result = applyOperator(lookupVariable(name), op, operand);
+    if (isFactorOperator(op)) {
+        while (pos < tokens.size() && isFactorOperator(tokens[pos].type)) {
+            TokenType next = tokens[pos++].type;
+            Value right = evaluateUnary(tokens, pos);
+            result = applyOperator(std::move(result), next, right);
+        }
+    }
+    while (pos < tokens.size() && isTermOperator(tokens[pos].type)) {
+        TokenType next = tokens[pos++].type;
+        Value right = evaluateFactor(tokens, pos);
+        result = applyOperator(std::move(result), next, right);
+    }
+    return result;
+}
+
+// Computes 'name op operand' for an assignment back to name (also used for
+// the compound forms: PLUS_ASSIGN passes PLUS). The variable's reference is
+// dropped first so an unshared string or tensor is modified in place; it is
+// restored if the operation throws.
+Value NexusInterpreter::updateVariable(const Token& name, TokenType op, const Value& operand) {
+    Value* local = resolveLocal(name);
+    if (!local) local = globalCell(name, true);
+    if (local) {
+        Value current = std::move(*local);
+        try {
+            return applyOperator(std::move(current), op, operand);
+        } catch (...) {
+            *local = std::move(current);
+            throw;
+        }
+    }
+
+    touchOwner(name.value);
+    Value current = environment->get(name.value);
+    bool released = environment->release(name.value, current);
+    try {
+        return applyOperator(std::move(current), op, operand);
+    } catch (...) {
+        if (released) environment->assign(name.value, current);
+        throw;
+    }
+}
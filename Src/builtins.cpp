@@ -0,0 +1,298 @@
+#include "interpreter.h"
+#include "hash_table.h"
+#include "native_binding.h"
+#include "serialization.h"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <unordered_set>
+
+namespace {
+
+// I/O
+Value nativePrint(ArgSpan args) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i > 0) std::cout << ' ';
+        std::cout << args[i].toString();
+    }
+    std::cout << std::endl;
+    return Value();
+}
+
+// Introspection and conversion
+int64_t nativeLen(const Value& value) { return static_cast<int64_t>(value.length()); }
+std::string nativeType(const Value& value) { return value.getTypeString(); }
+std::string nativeStr(const Value& value) { return value.toString(); }
+double nativeNum(const Value& value) { return value.toNumber(); }
+
+// Builtin objects are plain objects whose methods are native closures over
+// one shared State; a fork rebinds every method to its copy of the State
+template<typename State, typename Method>
+Value nativeMethod(const std::shared_ptr<State>& state, const std::string& name, size_t arity, Method method) {
+    NativeCallable::Binder bind = [method](const std::shared_ptr<NativeState>& bound) -> NativeFunction {
+        return [state = std::static_pointer_cast<State>(bound), method](ArgSpan args) {
+            return method(*state, args);
+        };
+    };
+    return Value(std::static_pointer_cast<Callable>(
+        std::make_shared<NativeCallable>(name, arity, state, std::move(bind))));
+}
+
+void expectArguments(ArgSpan args, size_t count, const char* method) {
+    if (args.size() != count) {
+        throw NativeArgumentError(std::string(method) + "() expects " + std::to_string(count) +
+                                  " arguments but got " + std::to_string(args.size()));
+    }
+}
+
+// Strings
+struct BuilderState : NativeState {
+    std::string buffer;
+    HeapCharge charge{MemoryCategory::STRINGS};
+
+    std::shared_ptr<NativeState> blank() const override { return std::make_shared<BuilderState>(); }
+    void copyInto(NativeState& target, const ValueCopier&) const override {
+        auto& copy = static_cast<BuilderState&>(target);
+        copy.buffer = buffer;
+        copy.recharge();
+    }
+    void recharge() { charge.update(buffer.capacity()); }
+};
+
+std::string builderText(ArgSpan args, const char* method) {
+    expectArguments(args, 1, method);
+    return args[0].isString() ? args[0].asString() : args[0].toString();
+}
+
+// StringBuilder() returns an object whose methods share one growable buffer,
+// so building a long string is amortized linear in its final length
+Value nativeStringBuilder() {
+    auto state = std::make_shared<BuilderState>();
+
+    Value builder = Value::emptyObject();
+    builder.setProperty("append", nativeMethod(state, "append", 1, [](BuilderState& self, ArgSpan args) {
+        self.buffer += builderText(args, "append");
+        self.recharge();
+        return Value();
+    }));
+    builder.setProperty("appendLine", nativeMethod(state, "appendLine", 1, [](BuilderState& self, ArgSpan args) {
+        self.buffer += builderText(args, "appendLine");
+        self.buffer += '\n';
+        self.recharge();
+        return Value();
+    }));
+    builder.setProperty("length", nativeMethod(state, "length", 0, [](BuilderState& self, ArgSpan) {
+        return Value(static_cast<int64_t>(self.buffer.size()));
+    }));
+    builder.setProperty("clear", nativeMethod(state, "clear", 0, [](BuilderState& self, ArgSpan) {
+        self.buffer.clear();
+        return Value();
+    }));
+    builder.setProperty("toString", nativeMethod(state, "toString", 0, [](BuilderState& self, ArgSpan) {
+        return Value(self.buffer);
+    }));
+    return builder;
+}
+
+// Collections. Map keys and Set members may be any value; arrays and objects
+// are copy-on-write, so mutating the original never disturbs a stored key.
+// The table is charged as an object; its keys and values pay for themselves.
+struct TableState : NativeState {
+    ValueHashTable table;
+    HeapCharge charge{MemoryCategory::OBJECTS};
+
+    std::shared_ptr<NativeState> blank() const override { return std::make_shared<TableState>(); }
+    void copyInto(NativeState& target, const ValueCopier& copy) const override {
+        auto& state = static_cast<TableState&>(target);
+        state.table.reserve(table.size());
+        table.forEach([&](const Value& key, const Value& value) { state.table.insert(copy(key), copy(value)); });
+        state.recharge();
+    }
+    void recharge() { charge.update(table.footprint()); }
+};
+
+Value nativeMap() {
+    auto state = std::make_shared<TableState>();
+
+    Value map = Value::emptyObject();
+    map.setProperty("set", nativeMethod(state, "set", 2, [](TableState& self, ArgSpan args) {
+        expectArguments(args, 2, "set");
+        self.table.insert(args[0], args[1]);
+        self.recharge();
+        return Value();
+    }));
+    map.setProperty("get", nativeMethod(state, "get", 1, [](TableState& self, ArgSpan args) {
+        expectArguments(args, 1, "get");
+        const Value* found = self.table.find(args[0]);
+        return found ? *found : Value();
+    }));
+    map.setProperty("has", nativeMethod(state, "has", 1, [](TableState& self, ArgSpan args) {
+        expectArguments(args, 1, "has");
+        return Value(self.table.find(args[0]) != nullptr);
+    }));
+    map.setProperty("delete", nativeMethod(state, "delete", 1, [](TableState& self, ArgSpan args) {
+        expectArguments(args, 1, "delete");
+        return Value(self.table.erase(args[0]));
+    }));
+    map.setProperty("size", nativeMethod(state, "size", 0, [](TableState& self, ArgSpan) {
+        return Value(static_cast<int64_t>(self.table.size()));
+    }));
+    map.setProperty("keys", nativeMethod(state, "keys", 0, [](TableState& self, ArgSpan) {
+        std::vector<Value> keys;
+        keys.reserve(self.table.size());
+        self.table.forEach([&keys](const Value& key, const Value&) { keys.push_back(key); });
+        return Value(std::move(keys));
+    }));
+    map.setProperty("values", nativeMethod(state, "values", 0, [](TableState& self, ArgSpan) {
+        std::vector<Value> values;
+        values.reserve(self.table.size());
+        self.table.forEach([&values](const Value&, const Value& value) { values.push_back(value); });
+        return Value(std::move(values));
+    }));
+    map.setProperty("clear", nativeMethod(state, "clear", 0, [](TableState& self, ArgSpan) {
+        self.table.clear();
+        return Value();
+    }));
+    return map;
+}
+
+// Set() or Set(array); members are stored as keys with nil values
+Value nativeSet(ArgSpan args) {
+    auto state = std::make_shared<TableState>();
+    if (args.size() > 1 || (args.size() == 1 && !args[0].isArray())) {
+        throw NativeArgumentError("Set() expects no arguments or one array");
+    }
+    if (args.size() == 1) {
+        size_t size = args[0].arraySize();
+        state->table.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            state->table.insert(args[0].elementAt(static_cast<int64_t>(i)), Value());
+        }
+        state->recharge();
+    }
+
+    Value set = Value::emptyObject();
+    set.setProperty("add", nativeMethod(state, "add", 1, [](TableState& self, ArgSpan args) {
+        expectArguments(args, 1, "add");
+        bool added = self.table.insert(args[0], Value());
+        self.recharge();
+        return Value(added);
+    }));
+    set.setProperty("has", nativeMethod(state, "has", 1, [](TableState& self, ArgSpan args) {
+        expectArguments(args, 1, "has");
+        return Value(self.table.find(args[0]) != nullptr);
+    }));
+    set.setProperty("delete", nativeMethod(state, "delete", 1, [](TableState& self, ArgSpan args) {
+        expectArguments(args, 1, "delete");
+        return Value(self.table.erase(args[0]));
+    }));
+    set.setProperty("size", nativeMethod(state, "size", 0, [](TableState& self, ArgSpan) {
+        return Value(static_cast<int64_t>(self.table.size()));
+    }));
+    set.setProperty("values", nativeMethod(state, "values", 0, [](TableState& self, ArgSpan) {
+        std::vector<Value> members;
+        members.reserve(self.table.size());
+        self.table.forEach([&members](const Value& key, const Value&) { members.push_back(key); });
+        return Value(std::move(members));
+    }));
+    set.setProperty("clear", nativeMethod(state, "clear", 0, [](TableState& self, ArgSpan) {
+        self.table.clear();
+        return Value();
+    }));
+    return set;
+}
+
+// Binary persistence for passing results between pipeline stages
+void nativeSaveBinary(std::string path, const Value& value) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) throw SerializationError("Cannot write " + path);
+    BinaryWriter writer(file);
+    writer.write(value);
+}
+
+Value nativeLoadBinary(std::string path) {
+    BinaryReader reader = BinaryReader::open(path);
+    return reader.read();
+}
+
+// Math
+double nativeSqrt(double x) { return std::sqrt(x); }
+double nativePow(double base, double exponent) { return std::pow(base, exponent); }
+double nativeAbs(double x) { return std::fabs(x); }
+double nativeFloor(double x) { return std::floor(x); }
+double nativeCeil(double x) { return std::ceil(x); }
+double nativeRound(double x) { return std::round(x); }
+double nativeExp(double x) { return std::exp(x); }
+double nativeLog(double x) { return std::log(x); }
+double nativeMin(double a, double b) { return a < b ? a : b; }
+double nativeMax(double a, double b) { return a > b ? a : b; }
+
+// Bytes held by the running interpreter's values, by type
+Value nativeMemoryStats() {
+    Value stats = Value::emptyObject();
+    HeapAccount* account = HeapAccount::active();
+    for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; ++i) {
+        auto category = static_cast<MemoryCategory>(i);
+        stats.setProperty(memoryCategoryName(category),
+                          Value(static_cast<int64_t>(account ? account->getBytes(category) : 0)));
+    }
+    stats.setProperty("total", Value(static_cast<int64_t>(account ? account->getTotal() : 0)));
+    stats.setProperty("peak", Value(static_cast<int64_t>(account ? account->getPeak() : 0)));
+    stats.setProperty("limit", Value(static_cast<int64_t>(account ? account->getLimit() : 0)));
+    return stats;
+}
+
+double nativeClock() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Tensors
+Value nativeMatmul(const Value& a, const Value& b) { return a.matmul(b); }
+Value nativeTranspose(const Value& a) { return a.transpose(); }
+
+} // namespace
+
+void NexusInterpreter::setupBuiltins() {
+    globals->define("print", Value(bindNative<&nativePrint>("print")));
+
+    globals->define("len", Value(bindNative<&nativeLen>("len")));
+    globals->define("type", Value(bindNative<&nativeType>("type")));
+    globals->define("str", Value(bindNative<&nativeStr>("str")));
+    globals->define("num", Value(bindNative<&nativeNum>("num")));
+    globals->define("StringBuilder", Value(bindNative<&nativeStringBuilder>("StringBuilder")));
+    globals->define("Map", Value(bindNative<&nativeMap>("Map")));
+    globals->define("Set", Value(bindNative<&nativeSet>("Set")));
+    globals->define("saveBinary", Value(bindNative<&nativeSaveBinary>("saveBinary")));
+    globals->define("loadBinary", Value(bindNative<&nativeLoadBinary>("loadBinary")));
+
+    globals->define("sqrt", Value(bindNative<&nativeSqrt>("sqrt")));
+    globals->define("pow", Value(bindNative<&nativePow>("pow")));
+    globals->define("abs", Value(bindNative<&nativeAbs>("abs")));
+    globals->define("floor", Value(bindNative<&nativeFloor>("floor")));
+    globals->define("ceil", Value(bindNative<&nativeCeil>("ceil")));
+    globals->define("round", Value(bindNative<&nativeRound>("round")));
+    globals->define("exp", Value(bindNative<&nativeExp>("exp")));
+    globals->define("log", Value(bindNative<&nativeLog>("log")));
+    globals->define("min", Value(bindNative<&nativeMin>("min")));
+    globals->define("max", Value(bindNative<&nativeMax>("max")));
+    globals->define("clock", Value(bindNative<&nativeClock>("clock")));
+    globals->define("memoryStats", Value(bindNative<&nativeMemoryStats>("memoryStats")));
+
+    globals->define("matmul", Value(bindNative<&nativeMatmul>("matmul")));
+    globals->define("transpose", Value(bindNative<&nativeTranspose>("transpose")));
+}
+
+// Models are charged for their parameters; a model bound under two names is
+// counted once
+void NexusInterpreter::accountModels() {
+    std::unordered_set<const NeuralNetwork*> seen;
+    size_t bytes = 0;
+    for (const auto& [name, model] : models) {
+        if (model && seen.insert(model.get()).second) bytes += model->getParameterCount() * sizeof(double);
+    }
+    HeapAccount& account = context.getHeapAccount();
+    account.adjust(MemoryCategory::MODELS, account.getBytes(MemoryCategory::MODELS), bytes);
+}
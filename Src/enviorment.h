@@ -1,6 +1,7 @@
 #pragma once
 
 #include "value.h"
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -23,6 +24,9 @@ private:
     std::unordered_set<std::string> constants;  // Variables that cannot be reassigned
     std::string scopeName;
     int depth;
+    uint64_t version = nextVersion();  // See renewVersion
+    bool tenured = false;  // Survived a collection (GarbageCollector)
+    bool touched = false;  // Accessed while a major pass was marking
     
 public:
     explicit Environment(std::shared_ptr<Environment> enclosing = nullptr, 
@@ -37,6 +41,41 @@ public:
     bool existsInCurrentScope(const std::string& name) const;
     void remove(const std::string& name);
     
+    // Structural version. std::map never moves a value while its key stays,
+    // so a cell from findCell is valid while the version is unchanged.
+    uint64_t getVersion() const { return version; }
+    const std::map<std::string, Value>& getVariables() const { return variables; }
+    bool isTenured() const { return tenured; }
+    void setTenured() { tenured = true; }
+    bool isTouched() const { return touched; }
+    void setTouched(bool value) { touched = value; }
+    
+    // Copy-on-write image of this scope's own bindings. Values share their
+    // payloads until either side writes, so taking one costs a handle per
+    // name no matter how large the arrays and tensors behind them are.
+    struct Snapshot {
+        std::map<std::string, Value> variables;
+        std::unordered_set<std::string> constants;
+    };
+    Snapshot snapshot() const { return {variables, constants}; }
+    void restore(const Snapshot& image) {
+        variables = image.variables;
+        constants = image.constants;
+        renewVersion();
+    }
+    
+    // Drops the scope chain's reference to a variable if it still holds
+    // expected, leaving nil, so the caller's copy becomes the only owner.
+    // Used right before the variable is reassigned from that copy.
+    bool release(const std::string& name, const Value& expected) {
+        Environment* owner = findEnvironmentWithVariable(name);
+        if (!owner || owner->isConstant(name)) return false;
+        Value& slot = owner->variables.find(name)->second;
+        if (!slot.isSameObject(expected)) return false;
+        slot = Value();
+        return true;
+    }
+    
     // Scope management
     std::shared_ptr<Environment> getParent() const { return parent; }
     const std::string& getScopeName() const { return scopeName; }
@@ -64,18 +103,34 @@ public:
     void importVariables(const std::map<std::string, Value>& vars);
     
 private:
+    friend class NexusInterpreter;  // Caches cells per access site (globalCell)
+    
+    Value* findCell(const std::string& name) {
+        auto it = variables.find(name);
+        return it == variables.end() ? nullptr : &it->second;
+    }
+    
+    // Versions come from one process-wide counter, so no two environments
+    // (or two states of one) share a value, even when a new environment is
+    // allocated where a freed one lived. Whatever adds or removes a name
+    // renews it: define of a new name, remove, clear and importVariables
+    // (environment.cpp, not part of this tree) as well as restore above.
+    static uint64_t nextVersion() {
+        static std::atomic<uint64_t> counter{1};
+        return counter.fetch_add(1, std::memory_order_relaxed);
+    }
+    void renewVersion() { version = nextVersion(); }
+    
     // Helper methods
     Environment* findEnvironmentWithVariable(const std::string& name) const;
     void validateAssignment(const std::string& name) const;
     std::string getFullScopePath() const;
 };
 
-// Global environment manager for the entire interpreter
+// Static facade over the running interpreter's RuntimeContext (see
+// runtime_context.h). It no longer holds state of its own, so interpreters
+// on different threads see their own global environment and stack.
 class GlobalEnvironmentManager {
-private:
-    static std::shared_ptr<Environment> globalEnv;
-    static std::vector<std::shared_ptr<Environment>> environmentStack;
-    
 public:
     // Global environment access
     static std::shared_ptr<Environment> getGlobal();
@@ -0,0 +1,320 @@
+#include "frame.h"
+
+namespace {
+
+// Index of the token closing the bracket opened at open, or the last token
+size_t matching(const std::vector<Token>& tokens, size_t open, TokenType left, TokenType right) {
+    int depth = 0;
+    for (size_t pos = open; pos < tokens.size(); ++pos) {
+        if (tokens[pos].type == left) {
+            depth++;
+        } else if (tokens[pos].type == right && --depth == 0) {
+            return pos;
+        }
+    }
+    return tokens.empty() ? 0 : tokens.size() - 1;
+}
+
+size_t matchingBrace(const std::vector<Token>& tokens, size_t open) {
+    return matching(tokens, open, TokenType::LEFT_BRACE, TokenType::RIGHT_BRACE);
+}
+
+size_t matchingParen(const std::vector<Token>& tokens, size_t open) {
+    return matching(tokens, open, TokenType::LEFT_PAREN, TokenType::RIGHT_PAREN);
+}
+
+bool isType(const std::vector<Token>& tokens, size_t pos, TokenType type) {
+    return pos < tokens.size() && tokens[pos].type == type;
+}
+
+bool isIdentifier(const std::vector<Token>& tokens, size_t pos) {
+    return isType(tokens, pos, TokenType::IDENTIFIER);
+}
+
+// Identifier that names a variable: not a property after '.', nor the 'in'
+// of 'for (x in items)'
+bool isVariableReference(const std::vector<Token>& tokens, size_t pos) {
+    if (!isIdentifier(tokens, pos) || pos == 0) return isIdentifier(tokens, pos);
+    if (tokens[pos].value == "in" && tokens[pos - 1].type == TokenType::IDENTIFIER) return false;
+    return tokens[pos - 1].type != TokenType::DOT;
+}
+
+// Keywords that start a typed declaration ('int n = 0', 'tensor t = ...')
+bool isTypeKeyword(TokenType type) {
+    switch (type) {
+        case TokenType::INT:
+        case TokenType::LONG:
+        case TokenType::FLOAT:
+        case TokenType::DOUBLE:
+        case TokenType::STRING_TYPE:
+        case TokenType::BOOLEAN_TYPE:
+        case TokenType::CHAR:
+        case TokenType::BYTE:
+        case TokenType::SHORT:
+        case TokenType::TENSOR:
+        case TokenType::MATRIX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Where the '{' of the function whose keyword is at pos opens
+size_t functionBody(const std::vector<Token>& tokens, size_t pos, size_t end) {
+    while (pos < end && tokens[pos].type != TokenType::LEFT_BRACE) pos++;
+    return pos;
+}
+
+// Parameter names of the function whose keyword is at pos: the identifiers
+// that open each comma-separated entry of its parameter list, past any type
+std::vector<std::string> functionParameters(const std::vector<Token>& tokens, size_t pos, size_t open) {
+    std::vector<std::string> parameters;
+    while (pos < open && tokens[pos].type != TokenType::LEFT_PAREN) pos++;
+    if (pos >= open) return parameters;
+    size_t close = matchingParen(tokens, pos);
+    int depth = 0;
+    bool expecting = true;
+    for (size_t inner = pos + 1; inner < close; ++inner) {
+        TokenType type = tokens[inner].type;
+        if (type == TokenType::LEFT_PAREN || type == TokenType::LEFT_BRACKET) depth++;
+        else if (type == TokenType::RIGHT_PAREN || type == TokenType::RIGHT_BRACKET) depth--;
+        else if (depth == 0 && type == TokenType::COMMA) expecting = true;
+        else if (depth == 0 && expecting && type == TokenType::IDENTIFIER) {
+            parameters.push_back(tokens[inner].value);
+            expecting = false;
+        }
+    }
+    return parameters;
+}
+
+// Declarations and name resolution for one function body, in token order.
+// Each block is a scope; its declarations are hoisted to the top of it.
+class Resolver {
+public:
+    struct Declaration {
+        bool captured = false;
+    };
+
+    // A resolved name: a declaration of this body, or a free name
+    struct Reference {
+        bool local;
+        size_t index;
+    };
+
+    std::vector<Declaration> declarations;
+    std::vector<size_t> parameterDeclarations;
+    std::vector<std::pair<uint64_t, Reference>> references;  // By identifier site
+    std::vector<std::pair<uint64_t, size_t>> freshDeclarations;
+    std::vector<std::string> freeNames;
+
+    struct Nested {
+        uint64_t site;
+        std::shared_ptr<const FrameLayout> layout;
+        std::vector<Reference> captures;
+    };
+    std::vector<Nested> nested;
+
+    explicit Resolver(const std::vector<Token>& source) : tokens(source) {}
+
+    void open(size_t end) { scopes.push_back({end, {}}); }
+
+    // Leaves the scopes that ended before pos
+    void leave(size_t pos) {
+        while (scopes.size() > 1 && scopes.back().end < pos) scopes.pop_back();
+    }
+
+    void declareParameter(const std::string& name) { parameterDeclarations.push_back(declare(name)); }
+
+    // Declarations directly in [from, to): not in nested blocks, loop
+    // headers or function bodies, which have scopes of their own
+    void hoist(size_t from, size_t to) {
+        for (size_t pos = from; pos < to; ++pos) {
+            switch (tokens[pos].type) {
+                case TokenType::LEFT_BRACE:
+                    pos = matchingBrace(tokens, pos);
+                    break;
+                case TokenType::FOR:
+                case TokenType::CATCH:
+                    if (isType(tokens, pos + 1, TokenType::LEFT_PAREN)) pos = matchingParen(tokens, pos + 1);
+                    break;
+                case TokenType::FUNCTION:
+                    if (isIdentifier(tokens, pos + 1)) declare(tokens[pos + 1].value);
+                    pos = matchingBrace(tokens, functionBody(tokens, pos, to));
+                    break;
+                default:
+                    declaration(pos, to);
+                    break;
+            }
+        }
+    }
+
+    // Variable of a loop or catch header: 'for (var i = 0; ...)',
+    // 'for (int x : items)', 'for (x in items)', 'catch (e)'
+    void hoistHeader(size_t from, size_t to) {
+        if (declaration(from, to)) return;
+        if (isIdentifier(tokens, from) &&
+            (isType(tokens, from + 1, TokenType::COLON) || isType(tokens, from + 1, TokenType::RIGHT_PAREN) ||
+             (isIdentifier(tokens, from + 1) && tokens[from + 1].value == "in"))) {
+            declareFresh(from);
+        }
+    }
+
+    void reference(size_t pos) { references.push_back({tokens[pos].site, resolve(tokens[pos].value)}); }
+
+    // Analyzes the function whose keyword is at pos and returns the index of
+    // the '}' closing its body. Its free names are references made here, at
+    // the point of definition.
+    size_t function(size_t pos, size_t end) {
+        if (isIdentifier(tokens, pos + 1)) reference(pos + 1);
+        size_t open = functionBody(tokens, pos, end);
+        size_t close = matchingBrace(tokens, open);
+        if (open >= end) return close;
+
+        Nested inner{tokens[open].site, FrameLayout::analyze(functionParameters(tokens, pos, open), tokens, open), {}};
+        for (const std::string& name : inner.layout->getFreeNames()) {
+            Reference captured = resolve(name);
+            if (captured.local) declarations[captured.index].captured = true;
+            inner.captures.push_back(captured);
+        }
+        nested.push_back(std::move(inner));
+        return close;
+    }
+
+private:
+    struct Scope {
+        size_t end;  // Index of the token that closes it
+        std::unordered_map<std::string, size_t> names;
+    };
+
+    const std::vector<Token>& tokens;
+    std::vector<Scope> scopes;
+    std::unordered_map<std::string, size_t> freeIndex;
+
+    size_t declare(const std::string& name) {
+        auto [it, added] = scopes.back().names.emplace(name, declarations.size());
+        if (added) declarations.emplace_back();
+        return it->second;
+    }
+
+    void declareFresh(size_t pos) { freshDeclarations.push_back({tokens[pos].site, declare(tokens[pos].value)}); }
+
+    // 'var x', 'var [a, b]', 'model m' or '<type> x' starting at pos
+    bool declaration(size_t pos, size_t to) {
+        TokenType type = tokens[pos].type;
+        if (type == TokenType::VAR) {
+            if (isIdentifier(tokens, pos + 1)) {
+                declareFresh(pos + 1);
+            } else if (isType(tokens, pos + 1, TokenType::LEFT_BRACKET)) {
+                for (size_t inner = pos + 2; inner < to && tokens[inner].type != TokenType::RIGHT_BRACKET; ++inner) {
+                    if (isIdentifier(tokens, inner)) declareFresh(inner);
+                }
+            }
+            return true;
+        }
+        if (type == TokenType::MODEL) {
+            if (isIdentifier(tokens, pos + 1)) declareFresh(pos + 1);
+            return true;
+        }
+        if (!isTypeKeyword(type)) return false;
+
+        // int[] xs, tensor<float> t; a type followed by '(' is a conversion
+        size_t name = pos + 1;
+        while (name < to) {
+            if (isType(tokens, name, TokenType::LEFT_BRACKET) && isType(tokens, name + 1, TokenType::RIGHT_BRACKET)) {
+                name += 2;
+            } else if (isType(tokens, name, TokenType::GENERIC_START)) {
+                while (name < to && tokens[name].type != TokenType::GENERIC_END) name++;
+                name++;
+            } else {
+                break;
+            }
+        }
+        if (!isIdentifier(tokens, name) || isType(tokens, name + 1, TokenType::LEFT_PAREN)) return false;
+        declareFresh(name);
+        return true;
+    }
+
+    Reference resolve(const std::string& name) {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto found = scope->names.find(name);
+            if (found != scope->names.end()) return {true, found->second};
+        }
+        auto [it, added] = freeIndex.emplace(name, freeNames.size());
+        if (added) freeNames.push_back(name);
+        return {false, it->second};
+    }
+};
+
+} // namespace
+
+std::shared_ptr<const FrameLayout> FrameLayout::analyze(const std::vector<std::string>& parameters,
+                                                        const std::vector<Token>& tokens,
+                                                        size_t bodyStart) {
+    Resolver resolver(tokens);
+    size_t end = matchingBrace(tokens, bodyStart);
+    resolver.open(end);
+    for (const std::string& parameter : parameters) resolver.declareParameter(parameter);
+    resolver.hoist(bodyStart + 1, end);
+
+    for (size_t pos = bodyStart + 1; pos < end; ++pos) {
+        resolver.leave(pos);
+        switch (tokens[pos].type) {
+            case TokenType::LEFT_BRACE: {
+                size_t close = matchingBrace(tokens, pos);
+                resolver.open(close);
+                resolver.hoist(pos + 1, close);
+                break;
+            }
+            case TokenType::FOR:
+            case TokenType::CATCH: {
+                // The header's variable is scoped to the loop or handler
+                if (!isType(tokens, pos + 1, TokenType::LEFT_PAREN)) break;
+                size_t header = matchingParen(tokens, pos + 1);
+                if (isType(tokens, header + 1, TokenType::LEFT_BRACE)) {
+                    resolver.open(matchingBrace(tokens, header + 1));
+                }
+                resolver.hoistHeader(pos + 2, header);
+                break;
+            }
+            case TokenType::FUNCTION:
+                pos = resolver.function(pos, end);
+                break;
+            default:
+                if (isVariableReference(tokens, pos)) resolver.reference(pos);
+                break;
+        }
+    }
+
+    // Storage for every declaration, then bindings for the sites
+    auto layout = std::make_shared<FrameLayout>();
+    std::vector<Binding> storage;
+    storage.reserve(resolver.declarations.size());
+    for (const Resolver::Declaration& declaration : resolver.declarations) {
+        if (declaration.captured) {
+            storage.push_back({BindingKind::CELL, static_cast<uint32_t>(layout->cellCount++)});
+        } else {
+            storage.push_back({BindingKind::SLOT, static_cast<uint32_t>(layout->slotCount++)});
+        }
+    }
+    auto bind = [&storage](const Resolver::Reference& reference) {
+        return reference.local ? storage[reference.index]
+                               : Binding{BindingKind::UPVALUE, static_cast<uint32_t>(reference.index)};
+    };
+
+    for (size_t index : resolver.parameterDeclarations) layout->parameterBindings.push_back(storage[index]);
+    for (const auto& [site, reference] : resolver.references) layout->sites[site] = bind(reference);
+    for (const auto& [site, index] : resolver.freshDeclarations) {
+        if (resolver.declarations[index].captured) layout->freshCells.insert(site);
+    }
+    for (Resolver::Nested& inner : resolver.nested) {
+        Closure& closure = layout->closures[inner.site];
+        closure.layout = std::move(inner.layout);
+        for (const Resolver::Reference& capture : inner.captures) closure.captures.push_back(bind(capture));
+    }
+    layout->freeNames = std::move(resolver.freeNames);
+    return layout;
+}
+
+std::vector<std::string> FrameLayout::parameterNames(const std::vector<Token>& tokens, size_t pos) {
+    return functionParameters(tokens, pos, functionBody(tokens, pos, tokens.size()));
+}
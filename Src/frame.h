@@ -0,0 +1,107 @@
+#pragma once
+
+#include "value.h"
+#include "lexer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class NexusFunction;
+
+// Heap cell for a local that a nested function captures; the frame and every
+// closure that captured the variable share it
+struct UpvalueCell {
+    Value value;
+    bool tenured = false;  // Survived a collection (GarbageCollector)
+    bool touched = false;  // Accessed while a major pass was marking
+};
+
+// Where a name lives relative to the running call frame
+enum class BindingKind : uint8_t {
+    UNRESOLVED,
+    SLOT,        // Plain local in the frame's slot array on the value stack
+    CELL,        // Captured local, boxed in an UpvalueCell
+    UPVALUE,     // Local of an enclosing function, reached through the closure
+    ENVIRONMENT  // Global or otherwise dynamic; looked up by name
+};
+
+struct Binding {
+    BindingKind kind = BindingKind::UNRESOLVED;
+    uint32_t index = 0;
+};
+
+// Slot assignment for one function body, computed once from its tokens.
+// Parameters and every declaration in the body get storage: 'var' (and
+// 'var [a, b]'), typed declarations ('int n', 'string s', 'tensor t', ...),
+// 'model' declarations, for-loop and catch variables, and function
+// declarations. Declarations are scoped to their block (a loop header to its
+// loop) and hoisted to the top of it; redeclaring a name in the same block
+// reuses its storage, the same name in another block gets its own. Locals a
+// nested function captures live in cells. Names used but not declared are
+// free; a closure resolves each to an upvalue when its creator's frame has
+// it. Bindings are per identifier token: declarations bind through
+// defineVariable with the declaring token.
+class FrameLayout {
+public:
+    // A function defined in this body: its own layout, and for each of its
+    // free names the binding in this frame that the closure captures
+    struct Closure {
+        std::shared_ptr<const FrameLayout> layout;
+        std::vector<Binding> captures;
+    };
+
+private:
+    size_t slotCount = 0;
+    size_t cellCount = 0;
+    std::vector<std::string> freeNames;
+    std::vector<Binding> parameterBindings;
+    std::unordered_map<uint64_t, Binding> sites;      // Identifier token site
+    std::unordered_set<uint64_t> freshCells;          // Declaring sites of captured variables
+    std::unordered_map<uint64_t, Closure> closures;   // Nested body '{' site
+
+public:
+    static std::shared_ptr<const FrameLayout> analyze(const std::vector<std::string>& parameters,
+                                                      const std::vector<Token>& tokens,
+                                                      size_t bodyStart);
+
+    // Parameter names of the function whose keyword is at pos, read the way
+    // analyze reads them, so the executor and the layout agree on them
+    static std::vector<std::string> parameterNames(const std::vector<Token>& tokens, size_t pos);
+
+    // SLOT, CELL, UPVALUE, or ENVIRONMENT for tokens outside this body
+    Binding resolve(const Token& name) const {
+        auto it = sites.find(name.site);
+        return it == sites.end() ? Binding{BindingKind::ENVIRONMENT, 0} : it->second;
+    }
+
+    // Whether running the declaration at this token creates a new cell, so
+    // closures made in earlier loop iterations keep the value they saw.
+    // Function declarations are not fresh: the function captured the cell
+    // before it was stored there.
+    bool isFreshCell(const Token& name) const { return freshCells.count(name.site) != 0; }
+
+    // Layout and captures of the function whose body opens at bodyOpen, or
+    // nullptr if it is not defined in this body
+    const Closure* closure(const Token& bodyOpen) const {
+        auto it = closures.find(bodyOpen.site);
+        return it == closures.end() ? nullptr : &it->second;
+    }
+
+    Binding parameter(size_t index) const { return parameterBindings[index]; }
+    size_t getSlotCount() const { return slotCount; }
+    size_t getCellCount() const { return cellCount; }
+    const std::vector<std::string>& getFreeNames() const { return freeNames; }
+};
+
+// Activation record of a running user function. Its slots are the window
+// [slotBase, slotBase + slot count) of the value stack and its cells the
+// same kind of window on the interpreter's cell stack.
+struct CallFrame {
+    const FrameLayout* layout;
+    NexusFunction* function;
+    size_t slotBase;
+    size_t cellBase;
+};
@@ -0,0 +1,357 @@
+#include "function.h"
+#include "interpreter.h"
+#include <optional>
+
+namespace {
+
+// Loops and try blocks are counted per function body: a call starts outside
+// both, and the caller's counts are back when it returns or throws
+class BodyNesting {
+private:
+    int& loops;
+    int& tries;
+    int outerLoops;
+    int outerTries;
+
+public:
+    BodyNesting(int& loopDepth, int& tryDepth)
+        : loops(loopDepth), tries(tryDepth), outerLoops(loopDepth), outerTries(tryDepth) {
+        loops = 0;
+        tries = 0;
+    }
+    ~BodyNesting() {
+        loops = outerLoops;
+        tries = outerTries;
+    }
+    BodyNesting(const BodyNesting&) = delete;
+    BodyNesting& operator=(const BodyNesting&) = delete;
+};
+
+} // namespace
+
+Value NexusFunction::call(NexusInterpreter& interpreter, ArgSpan arguments) {
+    return interpreter.invokeFunction(*this, arguments);
+}
+
+// Called with pos just past '('. Arguments are evaluated straight onto the
+// value stack and the callee receives a span over that window, so a call
+// performs no heap allocation of its own.
+Value NexusInterpreter::evaluateCall(const std::vector<Token>& tokens, size_t& pos, Value callee) {
+    size_t base = pushArguments(tokens, pos);
+    return callValue(callee, base);
+}
+
+// Evaluates the argument list after a '(' onto the value stack and returns
+// the window's base; nothing is left pushed if an argument throws
+size_t NexusInterpreter::pushArguments(const std::vector<Token>& tokens, size_t& pos) {
+    size_t base = valueStack.size();
+    try {
+        if (!check(tokens, pos, TokenType::RIGHT_PAREN)) {
+            do {
+                valueStack.push(evaluateExpression(tokens, pos));
+            } while (match(tokens, pos, TokenType::COMMA));
+        }
+        consume(tokens, pos, TokenType::RIGHT_PAREN, "Expected ')' after arguments");
+    } catch (...) {
+        valueStack.truncate(base);
+        throw;
+    }
+    return base;
+}
+
+// Calls callee with the stack window [argBase, top) and pops it afterwards
+Value NexusInterpreter::callValue(const Value& callee, size_t argBase) {
+    if (!callee.isCallable()) {
+        valueStack.truncate(argBase);
+        runtimeError("Can only call functions");
+    }
+    std::shared_ptr<Callable> function = callee.asCallable();
+    try {
+        Value result = function->call(*this, valueStack.window(argBase));
+        valueStack.truncate(argBase);
+        return result;
+    } catch (...) {
+        valueStack.truncate(argBase);
+        throw;
+    }
+}
+
+// Runs a user function as a trampoline: a call in tail position does not
+// recurse into C++, it replaces the current function and arguments and loops.
+// Locals live in a slot window pushed on the value stack (captured ones in
+// cells), so a call to a function without closures allocates nothing. A call
+// from the host installs this interpreter's context, so what the function
+// allocates is charged to it.
+Value NexusInterpreter::invokeFunction(NexusFunction& function, ArgSpan arguments) {
+    std::optional<RuntimeContext::Scope> scope;
+    if (RuntimeContext::installed() != &context) scope.emplace(context);
+    NexusFunction* current = &function;
+    std::shared_ptr<Callable> activeCallee;  // Keeps a tail callee alive while it runs
+    std::vector<Value> tailArguments;        // Owns the arguments once a tail call took over
+    std::shared_ptr<Environment> previous = environment;
+    size_t slotBase = valueStack.size();
+    size_t cellBase = cellStack.size();
+    BodyNesting nesting(loopDepth, tryDepth);
+
+    callDepth++;
+    while (true) {
+        const std::vector<std::string>& parameters = current->getParameters();
+        if (arguments.size() != parameters.size()) {
+            callDepth--;
+            runtimeError("Expected " + std::to_string(parameters.size()) + " arguments but got " +
+                         std::to_string(arguments.size()) + " in call to " + current->getName());
+        }
+
+        const FrameLayout& layout = current->getLayout();
+        try {
+            for (size_t i = 0; i < layout.getSlotCount(); ++i) valueStack.push(Value());
+            for (size_t i = 0; i < layout.getCellCount(); ++i) {
+                cellStack.push_back(std::make_shared<UpvalueCell>());
+            }
+            for (size_t i = 0; i < parameters.size(); ++i) {
+                Binding binding = layout.parameter(i);
+                Value& target = binding.kind == BindingKind::SLOT
+                                    ? valueStack[slotBase + binding.index]
+                                    : cellStack[cellBase + binding.index]->value;
+                target = arguments[i];
+            }
+            frames.push_back({&layout, current, slotBase, cellBase});
+        } catch (...) {
+            popFrame(slotBase, cellBase);
+            callDepth--;
+            throw;
+        }
+
+        environment = current->getClosure();
+        returning = false;
+        try {
+            executeBlock(current->getTokens(), current->getBodyStart());
+        } catch (...) {
+            frames.pop_back();
+            popFrame(slotBase, cellBase);
+            environment = previous;
+            pendingTailCall.clear();
+            returning = false;
+            callDepth--;
+            throw;
+        }
+        frames.pop_back();
+        popFrame(slotBase, cellBase);
+        environment = previous;
+        returning = false;
+
+        if (!pendingTailCall.pending) {
+            callDepth--;
+            Value result = std::move(returnValue);
+            returnValue = Value();
+            return result;
+        }
+
+        // Take over the tail call; the old argument vector becomes the spare
+        pendingTailCall.pending = false;
+        activeCallee = std::move(pendingTailCall.callee);
+        tailArguments.swap(pendingTailCall.arguments);
+        arguments = ArgSpan(tailArguments);
+
+        current = dynamic_cast<NexusFunction*>(activeCallee.get());
+        if (!current) {
+            callDepth--;
+            return activeCallee->call(*this, arguments);
+        }
+    }
+}
+
+// Drops a frame's slots and cells; cells captured by closures live on
+void NexusInterpreter::popFrame(size_t slotBase, size_t cellBase) {
+    valueStack.truncate(slotBase);
+    cellStack.resize(cellBase);
+}
+
+// Creates a closure for a function declaration or expression; this is the
+// collector's safe point, since nothing is mid-construction here. A function
+// defined inside a running one takes the layout its enclosing layout
+// analyzed, and captures the cells of the enclosing frame that its free
+// names were resolved to at the definition (or passes through the enclosing
+// closure's own upvalues), Lua style; other free names resolve through the
+// environment. Top-level definitions share layouts through the body's '{'.
+std::shared_ptr<NexusFunction> NexusInterpreter::makeFunction(const std::string& name,
+                                                              const std::vector<std::string>& parameters,
+                                                              std::shared_ptr<const std::vector<Token>> tokens,
+                                                              size_t bodyStart) {
+    if (collector.shouldCollect()) collector.collect();
+
+    const FrameLayout::Closure* nested = nullptr;
+    if (!frames.empty()) nested = frames.back().layout->closure((*tokens)[bodyStart]);
+    std::shared_ptr<const FrameLayout> layout;
+    if (nested) {
+        layout = nested->layout;
+    } else {
+        std::shared_ptr<const FrameLayout>& shared = frameLayouts[(*tokens)[bodyStart].site];
+        if (!shared) shared = FrameLayout::analyze(parameters, *tokens, bodyStart);
+        layout = shared;
+    }
+    auto function = std::make_shared<NexusFunction>(name, parameters, std::move(tokens), bodyStart, environment);
+    function->setLayout(std::move(layout));
+    collector.track(function);
+
+    if (nested) {
+        const CallFrame& frame = frames.back();
+        for (size_t i = 0; i < nested->captures.size(); ++i) {
+            Binding binding = nested->captures[i];
+            if (binding.kind == BindingKind::CELL) {
+                function->setUpvalue(i, cellStack[frame.cellBase + binding.index]);
+            } else if (binding.kind == BindingKind::UPVALUE) {
+                function->setUpvalue(i, frame.function->shareUpvalue(binding.index));
+            }
+        }
+    }
+    return function;
+}
+
+// Storage of a local of the running function, or nullptr for names that
+// live in the environment. A token in a function body only ever runs in
+// frames of that function, so its layout binds it by site.
+Value* NexusInterpreter::resolveLocal(const Token& name) {
+    if (frames.empty()) return nullptr;
+    const CallFrame& frame = frames.back();
+    Binding binding = frame.layout->resolve(name);
+    switch (binding.kind) {
+        case BindingKind::SLOT:
+            return &valueStack[frame.slotBase + binding.index];
+        case BindingKind::CELL: {
+            UpvalueCell* cell = cellStack[frame.cellBase + binding.index].get();
+            collector.touch(cell);
+            return &cell->value;
+        }
+        case BindingKind::UPVALUE: {
+            UpvalueCell* cell = frame.function->getUpvalue(binding.index);
+            collector.touch(cell);
+            return cell ? &cell->value : nullptr;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+// Cell of a global when nothing can shadow it: the innermost scope is the
+// global one, or a scope directly inside it (a top-level for-each) that does
+// not define the name. Each site caches its answer and revalidates it with
+// compares against the scopes' versions, which are never reused, so a cell
+// is not trusted after the environment it lived in was replaced. Constants
+// are not handed out for writing so assignment reports the error.
+Value* NexusInterpreter::globalCell(const Token& name, bool forWrite) {
+    Environment* scope = environment.get();
+    GlobalCache& cache = globalCaches[name.site];
+    if (cache.scope != scope || cache.scopeVersion != scope->getVersion() ||
+        cache.globalsVersion != globals->getVersion()) {
+        cache.scope = scope;
+        cache.scopeVersion = scope->getVersion();
+        cache.globalsVersion = globals->getVersion();
+        cache.cell = nullptr;
+        bool visible = scope == globals.get() ||
+                       (scope->getParent() == globals && !scope->findCell(name.value));
+        if (visible) cache.cell = globals->findCell(name.value);
+        cache.constant = cache.cell && globals->isConstant(name.value);
+    }
+    if (forWrite && cache.constant) return nullptr;
+    if (cache.cell) collector.touch(globals.get());
+    return cache.cell;
+}
+
+// The walk to the owning scope is only paid while a major pass is marking
+void NexusInterpreter::touchOwner(const std::string& name) {
+    if (collector.isMarking()) collector.touch(environment->findEnvironmentWithVariable(name));
+}
+
+Value NexusInterpreter::lookupVariable(const Token& name) {
+    if (Value* local = resolveLocal(name)) return *local;
+    if (Value* cell = globalCell(name)) return *cell;
+    touchOwner(name.value);
+    return environment->get(name.value);
+}
+
+void NexusInterpreter::assignVariable(const Token& name, Value value) {
+    if (Value* local = resolveLocal(name)) {
+        *local = std::move(value);
+        return;
+    }
+    if (Value* cell = globalCell(name, true)) {
+        *cell = std::move(value);
+        return;
+    }
+    touchOwner(name.value);
+    environment->assign(name.value, value);
+}
+
+// A captured variable gets a new cell each time its declaration runs, so a
+// closure made in an earlier iteration of a loop keeps its own value
+void NexusInterpreter::defineVariable(const Token& name, Value value) {
+    if (!frames.empty() && frames.back().layout->isFreshCell(name)) {
+        const CallFrame& frame = frames.back();
+        auto cell = std::make_shared<UpvalueCell>();
+        cell->value = std::move(value);
+        cellStack[frame.cellBase + frame.layout->resolve(name).index] = std::move(cell);
+        return;
+    }
+    if (Value* local = resolveLocal(name)) {
+        *local = std::move(value);
+        return;
+    }
+    collector.touch(environment.get());
+    environment->define(name.value, value);
+}
+
+// A return expression is a tail call when it is exactly 'name(args)' and the
+// statement ends right after the closing parenthesis. Only meaningful inside
+// a function body, and not inside a try block (or a catch block with a
+// finally): the call has to run while the handler is still in effect, so it
+// cannot be left to the trampoline after the function has returned.
+bool NexusInterpreter::isTailCall(const std::vector<Token>& tokens, size_t start) const {
+    if (callDepth == 0 || tryDepth > 0 || !check(tokens, start, TokenType::IDENTIFIER) ||
+        !check(tokens, start + 1, TokenType::LEFT_PAREN)) {
+        return false;
+    }
+
+    int depth = 0;
+    for (size_t pos = start + 1; pos < tokens.size(); ++pos) {
+        TokenType type = tokens[pos].type;
+        if (type == TokenType::LEFT_PAREN) {
+            depth++;
+        } else if (type == TokenType::RIGHT_PAREN && --depth == 0) {
+            return isAtEnd(tokens, pos + 1) ||
+                   check(tokens, pos + 1, TokenType::SEMICOLON) ||
+                   check(tokens, pos + 1, TokenType::RIGHT_BRACE);
+        } else if (type == TokenType::SEMICOLON) {
+            return false;
+        }
+    }
+    return false;
+}
+
+size_t NexusInterpreter::executeTailCall(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start;
+    Token name = advance(tokens, pos);
+    Value callee = lookupVariable(name);
+    if (!callee.isCallable()) {
+        runtimeError(name, "Can only call functions");
+    }
+    consume(tokens, pos, TokenType::LEFT_PAREN, "Expected '(' after function name");
+
+    // Borrow the spare vector: argument evaluation may run nested calls that
+    // use pendingTailCall themselves
+    std::vector<Value> arguments = std::move(pendingTailCall.arguments);
+    arguments.clear();
+    if (!check(tokens, pos, TokenType::RIGHT_PAREN)) {
+        do {
+            arguments.push_back(evaluateExpression(tokens, pos));
+        } while (match(tokens, pos, TokenType::COMMA));
+    }
+    consume(tokens, pos, TokenType::RIGHT_PAREN, "Expected ')' after arguments");
+    match(tokens, pos, TokenType::SEMICOLON);
+
+    pendingTailCall.callee = callee.asCallable();
+    pendingTailCall.arguments = std::move(arguments);
+    pendingTailCall.pending = true;
+    returning = true;
+    return pos;
+}
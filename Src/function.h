@@ -0,0 +1,91 @@
+#pragma once
+
+#include "value.h"
+#include "lexer.h"
+#include "frame.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// User-defined function backed by the token stream it was declared in
+class NexusFunction : public Callable {
+private:
+    std::string name;
+    std::vector<std::string> parameters;
+    std::shared_ptr<const std::vector<Token>> tokens;
+    size_t bodyStart;  // Index of the opening '{' of the body
+    std::shared_ptr<Environment> closure;
+    mutable std::shared_ptr<const FrameLayout> layout;     // Analyzed on first call
+    std::vector<std::shared_ptr<UpvalueCell>> upvalues;    // By free-name index; null = not captured
+    bool tenured = false;                                  // Survived a collection (GarbageCollector)
+    bool touched = false;                                  // Changed while a major pass was marking
+
+public:
+    NexusFunction(const std::string& n, const std::vector<std::string>& params,
+                  std::shared_ptr<const std::vector<Token>> source, size_t body,
+                  std::shared_ptr<Environment> enclosing)
+        : name(n), parameters(params), tokens(std::move(source)),
+          bodyStart(body), closure(std::move(enclosing)) {}
+
+    Value call(NexusInterpreter& interpreter, ArgSpan arguments) override;
+    std::string toString() const override { return "<fn " + name + ">"; }
+    size_t arity() const override { return parameters.size(); }
+
+    // Accessors used by the interpreter when it runs the body
+    const std::string& getName() const { return name; }
+    const std::vector<std::string>& getParameters() const { return parameters; }
+    const std::vector<Token>& getTokens() const { return *tokens; }
+    const std::shared_ptr<const std::vector<Token>>& shareTokens() const { return tokens; }
+    size_t getBodyStart() const { return bodyStart; }
+    const std::shared_ptr<Environment>& getClosure() const { return closure; }
+    
+    // Frame layout, shared by every closure created from the same definition
+    const FrameLayout& getLayout() const {
+        if (!layout) layout = FrameLayout::analyze(parameters, *tokens, bodyStart);
+        return *layout;
+    }
+    const std::shared_ptr<const FrameLayout>& shareLayout() const {
+        getLayout();
+        return layout;
+    }
+    void setLayout(std::shared_ptr<const FrameLayout> shared) { layout = std::move(shared); }
+    
+    // Captured variables of enclosing functions
+    UpvalueCell* getUpvalue(size_t index) const {
+        return index < upvalues.size() ? upvalues[index].get() : nullptr;
+    }
+    size_t getUpvalueCount() const { return upvalues.size(); }
+    std::shared_ptr<UpvalueCell> shareUpvalue(size_t index) const {
+        return index < upvalues.size() ? upvalues[index] : nullptr;
+    }
+    void setUpvalue(size_t index, std::shared_ptr<UpvalueCell> cell) {
+        if (upvalues.size() <= index) upvalues.resize(index + 1);
+        upvalues[index] = std::move(cell);
+    }
+    
+    bool isTenured() const { return tenured; }
+    void setTenured() { tenured = true; }
+    bool isTouched() const { return touched; }
+    void setTouched(bool value) { touched = value; }
+    
+    // Drops the references that can close a cycle; the collector calls this
+    // on functions that nothing outside their cycle can reach
+    void releaseCaptures() {
+        closure.reset();
+        upvalues.clear();
+    }
+};
+
+// Call in tail position ('return f(args);'), left for the caller's trampoline.
+// The argument vector is swapped rather than reallocated on every iteration.
+struct TailCall {
+    std::shared_ptr<Callable> callee;
+    std::vector<Value> arguments;
+    bool pending = false;
+
+    void clear() {
+        callee.reset();
+        arguments.clear();
+        pending = false;
+    }
+};
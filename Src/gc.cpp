@@ -0,0 +1,468 @@
+#include "gc.h"
+#include "enviorment.h"
+#include <algorithm>
+#include <iomanip>
+#include <unordered_map>
+
+namespace {
+
+enum class NodeKind : uint8_t { FUNCTION, ENVIRONMENT, CELL };
+
+struct Node {
+    NodeKind kind;
+    const void* address;
+    std::weak_ptr<void> ref;
+    std::shared_ptr<void> held;  // The one reference the scan holds, while it counts
+    size_t internal = 0;         // References from other scanned nodes
+    size_t ownedBytes = 0;       // Unshared tensor storage held directly
+    bool pinned = false;         // Also reached through a payload shared with outside values
+    bool dead = false;           // Freed by reference counting since it was added
+    bool reachable = false;
+    bool candidate = false;      // Already returned to its generation
+    std::vector<size_t> edges;
+};
+
+constexpr size_t NONE = static_cast<size_t>(-1);
+
+bool isTenured(NodeKind kind, void* object) {
+    switch (kind) {
+        case NodeKind::FUNCTION: return static_cast<NexusFunction*>(object)->isTenured();
+        case NodeKind::ENVIRONMENT: return static_cast<Environment*>(object)->isTenured();
+        case NodeKind::CELL: return static_cast<UpvalueCell*>(object)->tenured;
+    }
+    return false;
+}
+
+void setTenured(NodeKind kind, void* object) {
+    switch (kind) {
+        case NodeKind::FUNCTION: static_cast<NexusFunction*>(object)->setTenured(); break;
+        case NodeKind::ENVIRONMENT: static_cast<Environment*>(object)->setTenured(); break;
+        case NodeKind::CELL: static_cast<UpvalueCell*>(object)->tenured = true; break;
+    }
+}
+
+// Reads and clears the barrier's mark
+bool takeTouched(NodeKind kind, void* object) {
+    bool touched = false;
+    switch (kind) {
+        case NodeKind::FUNCTION: {
+            auto function = static_cast<NexusFunction*>(object);
+            touched = function->isTouched();
+            function->setTouched(false);
+            break;
+        }
+        case NodeKind::ENVIRONMENT: {
+            auto environment = static_cast<Environment*>(object);
+            touched = environment->isTouched();
+            environment->setTouched(false);
+            break;
+        }
+        case NodeKind::CELL:
+            touched = static_cast<UpvalueCell*>(object)->touched;
+            static_cast<UpvalueCell*>(object)->touched = false;
+            break;
+    }
+    return touched;
+}
+
+// Builds the closure graph reachable from the candidate functions. A heap
+// payload that other Values share may be referenced from outside the graph,
+// so nodes behind one are pinned instead of being counted as internal. Once
+// the work budget is spent no further nodes are added and expansion stops
+// early; missing edges only make nodes look more referenced, never less.
+//
+// A major scan outlives its slices, so it keeps weak references: a node
+// freed in between is retired (its edges withdrawn), and one the barrier
+// touched is expanded again before the counts are compared.
+class Scan {
+private:
+    bool minor;
+    std::unordered_map<const void*, size_t> index;
+    std::vector<size_t> pending;
+    size_t budget = 0;
+
+public:
+    std::vector<Node> nodes;
+    std::vector<size_t> candidates;  // Functions of the generation being collected
+    size_t work = 0;                 // Nodes added plus values visited, this slice
+
+    explicit Scan(bool isMinor) : minor(isMinor) {}
+
+    void startSlice(size_t limit) {
+        budget = limit;
+        work = 0;
+    }
+    bool exhausted() const { return work >= budget; }
+    bool expanded() const { return pending.empty(); }
+
+    void reserve(size_t count) {
+        nodes.reserve(count);
+        index.reserve(count);
+    }
+
+    size_t add(NodeKind kind, std::shared_ptr<void> ref) {
+        if (!ref || (minor && isTenured(kind, ref.get()))) return NONE;
+        auto found = index.find(ref.get());
+        if (found != index.end()) {
+            Node& node = nodes[found->second];
+            if (!node.ref.owner_before(ref) && !ref.owner_before(node.ref)) return found->second;
+            retire(found->second);  // Its address was reused after it was freed
+        }
+        if (exhausted()) return NONE;
+        size_t id = nodes.size();
+        index.emplace(ref.get(), id);
+        Node node;
+        node.kind = kind;
+        node.address = ref.get();
+        node.ref = ref;
+        if (minor) node.held = std::move(ref);  // Counted within this slice
+        nodes.push_back(std::move(node));
+        pending.push_back(id);
+        work++;
+        return id;
+    }
+
+    void run() {
+        while (!pending.empty() && !exhausted()) {
+            size_t id = pending.back();
+            pending.pop_back();
+            expand(id);
+        }
+    }
+
+    // Takes the counted references for the trial deletion; a major scan
+    // first withdraws what changed since its nodes were expanded
+    void settle() {
+        hold();
+        if (minor) return;
+        budget = NONE;                // The rescan has to finish the graph
+        size_t count = nodes.size();  // Nodes added by a rescan are new, so not touched
+        for (size_t id = 0; id < count; ++id) {
+            Node& node = nodes[id];
+            if (node.dead || !takeTouched(node.kind, node.held.get())) continue;
+            for (size_t to : node.edges) nodes[to].internal--;
+            node.edges.clear();
+            node.ownedBytes = 0;
+            expand(id);
+        }
+        run();
+        hold();
+    }
+
+    // Drops nodes, last first, until the budget runs out; the garbage goes
+    // with the last reference to it. True once nothing is left.
+    bool release() {
+        for (; !index.empty() && !exhausted(); ++work) index.erase(index.begin());
+        for (; !nodes.empty() && !exhausted(); ++work) nodes.pop_back();
+        return nodes.empty();
+    }
+
+private:
+    void hold() {
+        for (size_t id = 0; id < nodes.size(); ++id) {
+            Node& node = nodes[id];
+            if (node.dead || node.held) continue;
+            node.held = node.ref.lock();
+            if (!node.held) retire(id);
+        }
+    }
+
+    void retire(size_t id) {
+        Node& node = nodes[id];
+        for (size_t to : node.edges) nodes[to].internal--;
+        node.edges.clear();
+        node.dead = true;
+        node.held.reset();
+        index.erase(node.address);
+    }
+
+    void link(size_t from, size_t to, bool shared) {
+        if (to == NONE) return;
+        if (shared) {
+            nodes[to].pinned = true;
+        } else {
+            nodes[to].internal++;
+            nodes[from].edges.push_back(to);
+        }
+    }
+
+    void expand(size_t id) {
+        if (nodes[id].dead) return;
+        std::shared_ptr<void> object = nodes[id].held ? nodes[id].held : nodes[id].ref.lock();
+        if (!object) {
+            retire(id);
+            return;
+        }
+        if (!minor) takeTouched(nodes[id].kind, object.get());  // Read from here on
+        switch (nodes[id].kind) {
+            case NodeKind::FUNCTION: {
+                auto function = static_cast<NexusFunction*>(object.get());
+                link(id, add(NodeKind::ENVIRONMENT, function->getClosure()), false);
+                for (size_t i = 0; i < function->getUpvalueCount(); ++i) {
+                    link(id, add(NodeKind::CELL, function->shareUpvalue(i)), false);
+                }
+                break;
+            }
+            case NodeKind::ENVIRONMENT: {
+                auto environment = static_cast<Environment*>(object.get());
+                link(id, add(NodeKind::ENVIRONMENT, environment->getParent()), false);
+                for (const auto& [name, value] : environment->getVariables()) {
+                    if (exhausted()) break;
+                    visit(id, value, false);
+                }
+                break;
+            }
+            case NodeKind::CELL:
+                visit(id, static_cast<UpvalueCell*>(object.get())->value, false);
+                break;
+        }
+    }
+
+    void visit(size_t from, const Value& value, bool shared) {
+        work++;
+        shared = shared || value.sharesPayload();
+        if (value.isCallable()) {
+            std::shared_ptr<Callable> callable = value.asCallable();
+            if (auto function = std::dynamic_pointer_cast<NexusFunction>(callable)) {
+                callable.reset();
+                link(from, add(NodeKind::FUNCTION, std::move(function)), shared);
+            }
+        } else if (value.isTensor()) {
+            if (!shared) nodes[from].ownedBytes += value.externalBytes();
+        } else if ((value.isArray() && value.getArrayKind() == ArrayKind::GENERIC) || value.isObject()) {
+            for (auto it = value.begin(); it != value.end() && !exhausted(); ++it) visit(from, *it, shared);
+        }
+    }
+};
+
+// Trial deletion over a settled scan: what is left after subtracting
+// internal references (and the scan's own) is held from outside. Every edge
+// out of the garbage is cut; it is freed when the scan lets go. A cut node
+// may also be part of a major pass in progress, so it is touched for it.
+void sweep(Scan& scan, GcStats& stats, bool marking) {
+    std::vector<size_t> stack;
+    for (size_t id = 0; id < scan.nodes.size(); ++id) {
+        Node& node = scan.nodes[id];
+        if (node.dead) continue;
+        if (node.pinned || static_cast<size_t>(node.held.use_count()) > node.internal + 1) {
+            node.reachable = true;
+            stack.push_back(id);
+        }
+    }
+    while (!stack.empty()) {
+        size_t id = stack.back();
+        stack.pop_back();
+        for (size_t to : scan.nodes[id].edges) {
+            if (!scan.nodes[to].reachable) {
+                scan.nodes[to].reachable = true;
+                stack.push_back(to);
+            }
+        }
+    }
+
+    for (Node& node : scan.nodes) {
+        if (node.dead) continue;
+        if (node.reachable) {
+            setTenured(node.kind, node.held.get());
+            continue;
+        }
+        stats.objectsFreed++;
+        stats.externalBytesFreed += node.ownedBytes;
+        switch (node.kind) {
+            case NodeKind::FUNCTION: {
+                auto function = static_cast<NexusFunction*>(node.held.get());
+                function->releaseCaptures();
+                if (marking) function->setTouched(true);
+                break;
+            }
+            case NodeKind::ENVIRONMENT: {
+                auto environment = static_cast<Environment*>(node.held.get());
+                environment->clear();
+                if (marking) environment->setTouched(true);
+                break;
+            }
+            case NodeKind::CELL: {
+                auto cell = static_cast<UpvalueCell*>(node.held.get());
+                cell->value = Value();
+                if (marking) cell->touched = true;
+                break;
+            }
+        }
+    }
+    stats.objectsScanned += scan.nodes.size();
+}
+
+} // namespace
+
+struct GarbageCollector::MajorPass {
+    Scan scan{false};
+    size_t cursor = 0;  // tenured[cursor..end) are still to be added
+    size_t end;
+
+    MajorPass(size_t candidates, size_t expectedNodes) : end(candidates) { scan.reserve(expectedNodes); }
+};
+
+GarbageCollector::GarbageCollector() : majorThreshold(NURSERY_LIMIT), started(std::chrono::steady_clock::now()) {}
+GarbageCollector::~GarbageCollector() = default;
+
+void GarbageCollector::collect() {
+    sinceSlice = 0;
+    bool majorDue = marking || tenured.size() >= majorThreshold;
+    if (nursery.size() >= NURSERY_LIMIT || (!majorDue && !retiring)) {
+        minorSlice(sliceBudget());
+        return;
+    }
+    if (retiring) {
+        releaseSlice(sliceBudget());
+        return;
+    }
+    if (!marking) {
+        major = startMajor();
+        marking = true;
+    }
+    majorSlice(sliceBudget());
+}
+
+void GarbageCollector::collectMajor() {
+    // Restart any pass in progress so everything is rescanned at once
+    tenured.insert(tenured.end(), nursery.begin(), nursery.end());
+    nursery.clear();
+    major = startMajor();
+    marking = true;
+    sinceSlice = 0;
+    while (marking) majorSlice(UNBOUNDED);
+    retiring.reset();
+}
+
+// Reserves room for the graph up front, estimated from the last pass, so
+// that no slice has to grow it all at once
+std::unique_ptr<GarbageCollector::MajorPass> GarbageCollector::startMajor() {
+    size_t candidates = tenured.size();
+    return std::make_unique<MajorPass>(candidates, static_cast<size_t>(candidates * nodesPerCandidate * 1.25));
+}
+
+size_t GarbageCollector::sliceBudget() const {
+    if (maxPauseMs <= 0) return UNBOUNDED;
+    if (workPerMs <= 0) return MIN_SLICE_WORK * 16;  // Until a slice has measured the rate
+    return std::max(MIN_SLICE_WORK, static_cast<size_t>(maxPauseMs * workPerMs * 0.75));
+}
+
+void GarbageCollector::minorSlice(size_t budget) {
+    auto begin = std::chrono::steady_clock::now();
+
+    Scan scan(true);
+    scan.startSlice(budget);
+    size_t next = 0;
+    while (next < nursery.size() && !scan.exhausted()) {
+        scan.work++;
+        std::weak_ptr<NexusFunction> weak = nursery[next++];
+        std::shared_ptr<NexusFunction> function = weak.lock();
+        if (!function) continue;
+        size_t id = scan.add(NodeKind::FUNCTION, std::move(function));
+        if (id == NONE) {
+            tenured.push_back(weak);  // Already tenured through another path
+            continue;
+        }
+        scan.candidates.push_back(id);
+        scan.run();
+    }
+    nursery.erase(nursery.begin(), nursery.begin() + next);
+
+    scan.settle();
+    sweep(scan, stats, marking);
+    for (size_t id : scan.candidates) {
+        Node& node = scan.nodes[id];
+        if (!node.reachable || node.candidate) continue;
+        node.candidate = true;
+        tenured.push_back(std::static_pointer_cast<NexusFunction>(node.held));
+    }
+    stats.minorCollections++;
+    size_t work = scan.work;
+    scan.nodes.clear();
+    recordPause(begin, work);
+}
+
+// Adds candidates and expands the graph until the budget runs out; once the
+// graph is complete, the next slice settles and sweeps it
+void GarbageCollector::majorSlice(size_t budget) {
+    auto begin = std::chrono::steady_clock::now();
+    Scan& scan = major->scan;
+    scan.startSlice(budget);
+
+    bool complete = scan.expanded() && major->cursor >= major->end;
+    scan.run();
+    while (major->cursor < major->end && !scan.exhausted()) {
+        scan.work++;
+        std::shared_ptr<NexusFunction> function = tenured[major->cursor].lock();
+        if (function) {
+            size_t id = scan.add(NodeKind::FUNCTION, std::move(function));
+            if (id == NONE) break;  // Out of budget; retried next slice
+            scan.candidates.push_back(id);
+            scan.run();
+        }
+        major->cursor++;
+    }
+    stats.majorSlices++;
+    recordPause(begin, complete ? finishMajor() : scan.work);
+}
+
+// Returns the slice's work: the rescan plus one step per node swept
+size_t GarbageCollector::finishMajor() {
+    Scan& scan = major->scan;
+    scan.settle();
+    sweep(scan, stats, false);  // Nothing else is marking
+
+    // Functions tenured while the pass ran were not among its candidates
+    std::vector<std::weak_ptr<NexusFunction>> survivors(tenured.begin() + major->end, tenured.end());
+    for (size_t id : scan.candidates) {
+        Node& node = scan.nodes[id];
+        if (node.dead || !node.reachable || node.candidate) continue;
+        node.candidate = true;
+        survivors.push_back(std::static_pointer_cast<NexusFunction>(node.held));
+    }
+    tenured.swap(survivors);
+    size_t work = scan.work + scan.nodes.size();
+    if (major->end > 0) nodesPerCandidate = static_cast<double>(scan.nodes.size()) / major->end;
+    retiring = std::move(major);  // Lets go of the garbage over the next slices
+    marking = false;
+    stats.majorCollections++;
+    majorThreshold = std::max(NURSERY_LIMIT, tenured.size() * 2);
+    return work;
+}
+
+void GarbageCollector::releaseSlice(size_t budget) {
+    auto begin = std::chrono::steady_clock::now();
+    Scan& scan = retiring->scan;
+    scan.startSlice(budget);
+    bool done = scan.release();
+    size_t work = scan.work;
+    if (done) retiring.reset();
+    stats.majorSlices++;
+    recordPause(begin, work);
+}
+
+void GarbageCollector::recordPause(std::chrono::steady_clock::time_point begin, size_t work) {
+    double pause = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    stats.totalPauseMs += pause;
+    stats.maxPauseMs = std::max(stats.maxPauseMs, pause);
+    if (pause > 0.01) {
+        double rate = work / pause;
+        workPerMs = workPerMs > 0 ? 0.8 * workPerMs + 0.2 * rate : rate;
+    }
+}
+
+void GarbageCollector::printStats(std::ostream& out) const {
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    size_t collections = stats.minorCollections + stats.majorSlices;
+    out << std::fixed << std::setprecision(3);
+    out << "GC: " << stats.minorCollections << " minor, " << stats.majorCollections << " major collections ("
+        << stats.majorSlices << " major slices)" << std::endl;
+    out << "  scanned " << stats.objectsScanned << " objects, freed " << stats.objectsFreed
+        << " (" << stats.externalBytesFreed << " bytes of tensor storage)" << std::endl;
+    out << "  pause total " << stats.totalPauseMs << " ms, max " << stats.maxPauseMs << " ms, mean "
+        << (collections ? stats.totalPauseMs / collections : 0.0) << " ms";
+    if (maxPauseMs > 0) out << ", target " << maxPauseMs << " ms";
+    out << std::endl;
+    out << "  throughput " << (elapsed > 0 ? 100.0 * (1.0 - stats.totalPauseMs / elapsed) : 100.0)
+        << "% of " << elapsed << " ms outside the collector" << std::endl;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "enviorment.h"
+#include "function.h"
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// Counters reported by --gc-stats
+struct GcStats {
+    size_t minorCollections = 0;
+    size_t majorCollections = 0;    // Completed passes over the tenured set
+    size_t majorSlices = 0;
+    size_t objectsScanned = 0;      // Functions, environments and cells visited
+    size_t objectsFreed = 0;        // Members of unreachable cycles
+    size_t externalBytesFreed = 0;  // Tensor storage owned by those members
+    double totalPauseMs = 0;
+    double maxPauseMs = 0;
+};
+
+// Cycle collector for closures. Values, functions, environments and upvalue
+// cells are reference counted, which frees everything promptly except
+// cycles: a function stored in the environment it closes over, or in one of
+// its own upvalue cells. Those are found by trial deletion: over the scanned
+// graph, references coming from inside it are subtracted from every node's
+// count, nodes with references left over are roots, and whatever the roots
+// cannot reach is garbage. Cutting its edges lets reference counting free it.
+//
+// It does not trace from roots or move objects: C++ code holds raw Value*
+// and Environment pointers (frame slots, cached global cells, operands on
+// the native stack) that no root set enumerates, and a NaN-boxed payload is
+// addressed by its pointer bits, so nothing may be freed or relocated behind
+// a refcount. Refcounting stays the owner; the collector only breaks cycles.
+//
+// Collections are generational. New functions enter the nursery; a minor
+// collection scans what is reachable from them but stops at tenured nodes
+// (flagged in the objects themselves), whose references then count as
+// outside ones. Survivors are tenured, and a major pass rescans the tenured
+// set once it has doubled.
+//
+// With a pause target, work is time-sliced. A minor collection is one
+// slice: a complete trial deletion over a bounded part of the nursery's
+// graph, where nodes beyond the budget are left out (so they count as
+// outside references). A major pass spreads over as many slices as its
+// graph needs. Each slice expands part of it, holding only weak references,
+// and the mutator runs in between. A barrier marks every environment and
+// cell whose variables are read or written meanwhile (touch), since a write
+// changes its edges and a read may copy a value out. The final slice drops
+// the nodes refcounting has freed, rescans the touched ones, and runs the
+// trial deletion over the whole graph. The counts have to be compared at one
+// instant, so that slice is linear in the graph's node count and ignores
+// the budget (though it visits no values outside touched nodes). Dropping
+// the graph, which frees the garbage, is left to the slices after it.
+// Budgets are paced from the measured scan rate. There is no background
+// marker: Value refcounts are not atomic, so no other thread may read the
+// graph while the mutator runs.
+class GarbageCollector {
+private:
+    struct MajorPass;
+
+    std::vector<std::weak_ptr<NexusFunction>> nursery;
+    std::vector<std::weak_ptr<NexusFunction>> tenured;
+    size_t majorThreshold;
+
+    // Major pass in progress; tenured[0..its end) are its candidates. A
+    // finished pass is retired: its graph is dropped over the next slices.
+    std::unique_ptr<MajorPass> major;
+    std::unique_ptr<MajorPass> retiring;
+    bool marking = false;
+    double nodesPerCandidate = 2;  // Graph size of the last pass, per candidate
+
+    double maxPauseMs = 0;  // 0 = unbounded
+    double workPerMs = 0;   // Scan rate, averaged over recent slices
+    size_t sinceSlice = 0;  // Functions tracked since the last slice
+
+    GcStats stats;
+    std::chrono::steady_clock::time_point started;
+
+public:
+    static constexpr size_t NURSERY_LIMIT = 1024;
+    static constexpr size_t MAJOR_SLICE_INTERVAL = 64;  // Functions tracked between major slices
+    static constexpr size_t MIN_SLICE_WORK = 256;
+    static constexpr size_t UNBOUNDED = static_cast<size_t>(-1);
+
+    GarbageCollector();
+    ~GarbageCollector();
+
+    void setMaxPause(double ms) { maxPauseMs = ms; }
+    double getMaxPause() const { return maxPauseMs; }
+
+    void track(const std::shared_ptr<NexusFunction>& function) {
+        nursery.push_back(function);
+        sinceSlice++;
+    }
+    bool shouldCollect() const {
+        if (nursery.size() >= NURSERY_LIMIT) return true;
+        if (marking || retiring) return sinceSlice >= MAJOR_SLICE_INTERVAL;
+        return tenured.size() >= majorThreshold;
+    }
+
+    // Barrier: call on the environment or cell behind every variable access
+    // outside the frame's own slots
+    bool isMarking() const { return marking; }
+    void touch(Environment* environment) const {
+        if (marking && environment) environment->setTouched(true);
+    }
+    void touch(UpvalueCell* cell) const {
+        if (marking && cell) cell->touched = true;
+    }
+
+    // One slice of pending work: a minor collection while the nursery is
+    // full or no major pass is due, otherwise the next step of a major pass.
+    // Only call between operations: every live object must be held by a
+    // counted reference (raw pointers are invisible to the collector).
+    void collect();
+
+    // Full collection of everything tracked, ignoring the pause target
+    void collectMajor();
+
+    const GcStats& getStats() const { return stats; }
+    void printStats(std::ostream& out) const;
+
+private:
+    size_t sliceBudget() const;
+    std::unique_ptr<MajorPass> startMajor();
+    void minorSlice(size_t budget);
+    void majorSlice(size_t budget);
+    size_t finishMajor();
+    void releaseSlice(size_t budget);
+    void recordPause(std::chrono::steady_clock::time_point begin, size_t work);
+};
@@ -0,0 +1,174 @@
+#include "hash_table.h"
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Bit i is set when byte i of the group equals tag
+uint32_t matchTag(const int8_t* group, int8_t tag) {
+#ifdef __SSE2__
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < ValueHashTable::GROUP_WIDTH; ++i) {
+        if (group[i] == tag) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+// Bit i is set when slot i is EMPTY or DELETED (both have the sign bit set)
+uint32_t matchFree(const int8_t* group) {
+#ifdef __SSE2__
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < ValueHashTable::GROUP_WIDTH; ++i) {
+        if (group[i] < 0) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+unsigned lowestBit(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+    unsigned bit = 0;
+    while (!(mask & 1u)) {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// Keys match when == holds, except that NaN matches NaN
+bool sameKey(const Value& lhs, const Value& rhs) {
+    if (ValueEqual()(lhs, rhs)) return true;
+    return lhs.isNumber() && rhs.isNumber() && std::isnan(lhs.asNumber()) && std::isnan(rhs.asNumber());
+}
+
+} // namespace
+
+// Value::hash is often the identity for integers; the tag and group index
+// come from different bits, so spread them with a 64-bit finalizer
+size_t ValueHashTable::hashOf(const Value& key) {
+    uint64_t h = static_cast<uint64_t>(key.hash());
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
+// Triangular probing over groups visits every group once because the group
+// count is a power of two; the first group with an EMPTY byte ends the chain
+size_t ValueHashTable::findIndex(const Value& key, size_t hash) const {
+    if (count == 0) return NOT_FOUND;
+    size_t groupMask = control.size() / GROUP_WIDTH - 1;
+    size_t group = firstGroup(hash);
+    int8_t tag = tagOf(hash);
+    for (size_t step = 1; step <= groupMask + 1; ++step) {
+        const int8_t* bytes = &control[group * GROUP_WIDTH];
+        for (uint32_t mask = matchTag(bytes, tag); mask; mask &= mask - 1) {
+            size_t index = group * GROUP_WIDTH + lowestBit(mask);
+            if (slots[index].hash == hash && sameKey(slots[index].key, key)) return index;
+        }
+        if (matchTag(bytes, EMPTY)) return NOT_FOUND;
+        group = (group + step) & groupMask;
+    }
+    return NOT_FOUND;
+}
+
+size_t ValueHashTable::findFreeIndex(size_t hash) const {
+    size_t groupMask = control.size() / GROUP_WIDTH - 1;
+    size_t group = firstGroup(hash);
+    for (size_t step = 1;; ++step) {
+        uint32_t mask = matchFree(&control[group * GROUP_WIDTH]);
+        if (mask) return group * GROUP_WIDTH + lowestBit(mask);
+        group = (group + step) & groupMask;
+    }
+}
+
+Value* ValueHashTable::find(const Value& key) {
+    size_t index = findIndex(key, hashOf(key));
+    return index == NOT_FOUND ? nullptr : &slots[index].value;
+}
+
+const Value* ValueHashTable::find(const Value& key) const {
+    size_t index = findIndex(key, hashOf(key));
+    return index == NOT_FOUND ? nullptr : &slots[index].value;
+}
+
+bool ValueHashTable::insert(const Value& key, Value value) {
+    size_t hash = hashOf(key);
+    size_t index = findIndex(key, hash);
+    if (index != NOT_FOUND) {
+        slots[index].value = std::move(value);
+        return false;
+    }
+
+    // Keep at least one slot in eight EMPTY so probe chains terminate
+    if ((count + tombstones + 1) * 8 > control.size() * 7) {
+        rehash(count + 1);
+    }
+    index = findFreeIndex(hash);
+    if (control[index] == DELETED) tombstones--;
+    control[index] = tagOf(hash);
+    slots[index].key = key;
+    slots[index].value = std::move(value);
+    slots[index].hash = hash;
+    count++;
+    return true;
+}
+
+bool ValueHashTable::erase(const Value& key) {
+    size_t index = findIndex(key, hashOf(key));
+    if (index == NOT_FOUND) return false;
+    control[index] = DELETED;
+    slots[index] = Entry();
+    count--;
+    tombstones++;
+    return true;
+}
+
+void ValueHashTable::clear() {
+    control.clear();
+    slots.clear();
+    count = 0;
+    tombstones = 0;
+}
+
+void ValueHashTable::reserve(size_t entries) {
+    if (entries * 8 > control.size() * 7) rehash(entries);
+}
+
+// Rebuilds into the smallest power-of-two capacity that holds minimumEntries
+// (doubled while the table is growing), dropping tombstones. Entries move
+// with their cached hash.
+void ValueHashTable::rehash(size_t minimumEntries) {
+    size_t target = minimumEntries > count * 2 ? minimumEntries : count * 2;
+    size_t newCapacity = GROUP_WIDTH;
+    while (newCapacity * 7 < target * 8) newCapacity *= 2;
+
+    std::vector<int8_t> oldControl = std::move(control);
+    std::vector<Entry> oldSlots = std::move(slots);
+    control.assign(newCapacity, EMPTY);
+    slots.clear();
+    slots.resize(newCapacity);
+    tombstones = 0;
+
+    for (size_t i = 0; i < oldControl.size(); ++i) {
+        if (oldControl[i] < 0) continue;
+        size_t index = findFreeIndex(oldSlots[i].hash);
+        control[index] = oldControl[i];
+        slots[index] = std::move(oldSlots[i]);
+    }
+}
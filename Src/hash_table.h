@@ -0,0 +1,68 @@
+#pragma once
+
+#include "value.h"
+#include <cstdint>
+#include <vector>
+
+// Open-addressing table keyed by any Value, laid out as a Swiss table: each
+// slot has a control byte holding 7 bits of its hash, and a probe compares a
+// group of 16 control bytes at once (SSE2 where available) before touching
+// any key. Slots keep the full hash, so lookups skip most key comparisons and
+// growing never rehashes a key. Backs the Map and Set builtins.
+//
+// Keys are matched with == and Value::hash, so 2 and 2.0 are one key and
+// arrays and objects are matched by contents. NaN is the exception: every
+// NaN is one key, so a NaN key can be found and erased again even though
+// NaN != NaN.
+class ValueHashTable {
+public:
+    struct Entry {
+        Value key;
+        Value value;
+        size_t hash = 0;
+    };
+
+    static constexpr size_t GROUP_WIDTH = 16;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return control.size(); }
+    // Bytes of control bytes and slots; the keys' and values' payloads are their own
+    size_t footprint() const { return control.capacity() + slots.capacity() * sizeof(Entry); }
+
+    // Lookup; nullptr when the key is absent
+    Value* find(const Value& key);
+    const Value* find(const Value& key) const;
+
+    // Returns false when the key was already present (its value is replaced)
+    bool insert(const Value& key, Value value);
+    bool erase(const Value& key);
+    void clear();
+    void reserve(size_t entries);
+
+    // Visits live entries in slot order
+    template<typename Visitor>
+    void forEach(Visitor&& visit) const {
+        for (size_t i = 0; i < control.size(); ++i) {
+            if (control[i] >= 0) visit(slots[i].key, slots[i].value);
+        }
+    }
+
+private:
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    std::vector<int8_t> control;  // One byte per slot: EMPTY, DELETED or the hash's low 7 bits
+    std::vector<Entry> slots;
+    size_t count = 0;
+    size_t tombstones = 0;
+
+    static size_t hashOf(const Value& key);
+    static int8_t tagOf(size_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+    size_t firstGroup(size_t hash) const { return (hash >> 7) & (control.size() / GROUP_WIDTH - 1); }
+
+    size_t findIndex(const Value& key, size_t hash) const;
+    size_t findFreeIndex(size_t hash) const;
+    void rehash(size_t minimumEntries);
+};
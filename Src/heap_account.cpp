@@ -0,0 +1,87 @@
+#include "heap_account.h"
+#include "runtime_context.h"
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+thread_local size_t exemptDepth = 0;
+
+std::string formatBytes(size_t bytes) {
+    static const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024;
+        unit++;
+    }
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << value << ' ' << units[unit];
+    return text.str();
+}
+
+} // namespace
+
+const char* memoryCategoryName(MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory::STRINGS: return "strings";
+        case MemoryCategory::ARRAYS: return "arrays";
+        case MemoryCategory::OBJECTS: return "objects";
+        case MemoryCategory::TENSORS: return "tensors";
+        case MemoryCategory::MODELS: return "models";
+        case MemoryCategory::OTHER: return "other";
+    }
+    return "other";
+}
+
+HeapAccount* HeapAccount::active() {
+    if (exemptDepth > 0) return nullptr;
+    RuntimeContext* context = RuntimeContext::installed();
+    return context ? &context->getHeapAccount() : nullptr;
+}
+
+HeapAccount::Exempt::Exempt() { exemptDepth++; }
+HeapAccount::Exempt::~Exempt() { exemptDepth--; }
+
+void HeapAccount::adjust(MemoryCategory category, size_t previous, size_t current) {
+    size_t& held = bytes[static_cast<size_t>(category)];
+    held = held - previous + current;
+    total = total - previous + current;
+    if (total > peak) peak = total;
+    if (limit > 0 && current > previous && total > limit) {
+        limitErrors++;
+        throw HeapLimitError("Heap limit of " + formatBytes(limit) + " exceeded: " + formatBytes(total) +
+                             " in use after allocating " + formatBytes(current - previous) + " of " +
+                             memoryCategoryName(category));
+    }
+}
+
+void HeapAccount::credit(MemoryCategory category, size_t amount) noexcept {
+    bytes[static_cast<size_t>(category)] -= amount;
+    total -= amount;
+}
+
+void HeapAccount::holdTensor(const Tensor* tensor, size_t amount) {
+    auto [entry, inserted] = tensors.try_emplace(tensor, SharedTensor{0, amount});
+    entry->second.handles++;
+    if (inserted) charge(MemoryCategory::TENSORS, amount);
+}
+
+void HeapAccount::releaseTensor(const Tensor* tensor) noexcept {
+    auto entry = tensors.find(tensor);
+    if (entry == tensors.end()) return;
+    if (--entry->second.handles == 0) {
+        credit(MemoryCategory::TENSORS, entry->second.bytes);
+        tensors.erase(entry);
+    }
+}
+
+void HeapAccount::printReport(std::ostream& out) const {
+    out << "Heap: " << formatBytes(total) << " in use, peak " << formatBytes(peak);
+    if (limit > 0) out << ", limit " << formatBytes(limit) << " (" << limitErrors << " times exceeded)";
+    out << std::endl;
+    for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; ++i) {
+        out << "  " << std::left << std::setw(8) << memoryCategoryName(static_cast<MemoryCategory>(i))
+            << std::right << std::setw(12) << formatBytes(bytes[i]) << std::endl;
+    }
+}
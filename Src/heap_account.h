@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+class Tensor;
+
+enum class MemoryCategory : uint8_t {
+    STRINGS,
+    ARRAYS,
+    OBJECTS,
+    TENSORS,
+    MODELS,
+    OTHER  // Function handles and boxed integers
+};
+
+constexpr size_t MEMORY_CATEGORY_COUNT = 6;
+
+const char* memoryCategoryName(MemoryCategory category);
+
+class HeapLimitError : public std::exception {
+private:
+    std::string message;
+
+public:
+    explicit HeapLimitError(const std::string& msg) : message(msg) {}
+    const char* what() const noexcept override { return message.c_str(); }
+};
+
+// Bytes held by one interpreter's values, by type. Every heap payload is
+// charged to the account of the interpreter whose context is installed on
+// the thread (RuntimeContext::Scope) when it was created, and to none if no
+// context is. The payload keeps a pointer to the account and is re-charged
+// when it grows, so the totals follow strings and arrays as they are
+// appended to. Tensor storage is charged once per tensor however many values
+// refer to it; models are charged for their parameters as the model table
+// changes.
+//
+// With a limit set, a charge that takes the total over it is still recorded
+// (the memory exists) and then raises HeapLimitError, which reaches the
+// script as a runtime error. The payloads involved are released as the
+// error unwinds.
+class HeapAccount {
+private:
+    struct SharedTensor {
+        size_t handles;
+        size_t bytes;
+    };
+
+    std::array<size_t, MEMORY_CATEGORY_COUNT> bytes{};
+    size_t total = 0;
+    size_t peak = 0;
+    size_t limit = 0;  // 0 = unlimited
+    size_t limitErrors = 0;
+    std::unordered_map<const Tensor*, SharedTensor> tensors;
+
+public:
+    // Account of the interpreter installed on this thread; null outside any
+    // interpreter and inside an Exempt scope
+    static HeapAccount* active();
+
+    // Payloads created in this scope are not charged to anyone (per-thread
+    // caches that outlive interpreters)
+    class Exempt {
+    public:
+        Exempt();
+        ~Exempt();
+        Exempt(const Exempt&) = delete;
+        Exempt& operator=(const Exempt&) = delete;
+    };
+
+    // Moves a charge from previous to current bytes
+    void adjust(MemoryCategory category, size_t previous, size_t current);
+    void charge(MemoryCategory category, size_t amount) { adjust(category, 0, amount); }
+    void credit(MemoryCategory category, size_t amount) noexcept;
+
+    // Reference from one value to a tensor's storage
+    void holdTensor(const Tensor* tensor, size_t amount);
+    void releaseTensor(const Tensor* tensor) noexcept;
+
+    void setLimit(size_t bytesLimit) { limit = bytesLimit; }
+    size_t getLimit() const { return limit; }
+    size_t getBytes(MemoryCategory category) const { return bytes[static_cast<size_t>(category)]; }
+    size_t getTotal() const { return total; }
+    size_t getPeak() const { return peak; }
+    size_t getLimitErrors() const { return limitErrors; }
+
+    void printReport(std::ostream& out) const;
+};
+
+// Charge for a native buffer that is not a Value payload (a StringBuilder's
+// text, a Map's table), taken against the account active when it is made.
+// The owner calls update() after the buffer changes size; whatever is
+// charged then is credited when the HeapCharge dies.
+class HeapCharge {
+private:
+    HeapAccount* account;
+    MemoryCategory category;
+    size_t charged = 0;
+
+public:
+    explicit HeapCharge(MemoryCategory bufferCategory)
+        : account(HeapAccount::active()), category(bufferCategory) {}
+    ~HeapCharge() {
+        if (account) account->credit(category, charged);
+    }
+    HeapCharge(const HeapCharge&) = delete;
+    HeapCharge& operator=(const HeapCharge&) = delete;
+
+    // Throws HeapLimitError past the limit, with the new size recorded
+    void update(size_t bytes) {
+        if (!account || bytes == charged) return;
+        size_t previous = charged;
+        charged = bytes;
+        account->adjust(category, previous, bytes);
+    }
+};
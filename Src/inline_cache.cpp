@@ -0,0 +1,107 @@
+#include "interpreter.h"
+#include <iomanip>
+#include <iostream>
+
+// Property tokens get a cache the first time they are executed
+PropertyCache& NexusInterpreter::cacheFor(const Token& site) {
+    return propertyCaches[site.site];
+}
+
+// obj.name: a shape check and a slot load when the site has seen this shape
+Value NexusInterpreter::loadProperty(const Value& object, const Token& name) {
+    if (!object.isObject()) {
+        runtimeError(name, "Only objects have properties");
+    }
+
+    if (Shape* shape = object.getShape()) {
+        PropertyCache& cache = cacheFor(name);
+        if (const PropertyCache::Entry* entry = cache.lookup(shape)) {
+            return object.slotAt(entry->slot);
+        }
+        int32_t slot = shape->lookup(name.value);
+        if (slot >= 0) {
+            cache.insert(shape, static_cast<uint32_t>(slot));
+            return object.slotAt(static_cast<uint32_t>(slot));
+        }
+    } else if (const Value* property = object.findProperty(name.value)) {
+        return *property;
+    }
+
+    runtimeError(name, "Undefined property '" + name.value + "'");
+    return Value();
+}
+
+// obj.name = value: caches both plain stores and stores that add the
+// property, so building same-shaped records skips the transition lookup
+void NexusInterpreter::storeProperty(Value& object, const Token& name, Value value) {
+    if (!object.isObject()) {
+        runtimeError(name, "Only objects have properties");
+    }
+
+    Shape* shape = object.getShape();
+    if (!shape) {
+        object.setProperty(name.value, std::move(value));
+        return;
+    }
+
+    PropertyCache& cache = cacheFor(name);
+    if (const PropertyCache::Entry* entry = cache.lookup(shape)) {
+        if (entry->transition) {
+            object.appendSlot(entry->transition, std::move(value));
+        } else {
+            object.slotAt(entry->slot) = std::move(value);
+        }
+        return;
+    }
+
+    object.setProperty(name.value, std::move(value));
+    Shape* after = object.getShape();
+    if (after == shape) {
+        cache.insert(shape, static_cast<uint32_t>(shape->lookup(name.value)));
+    } else if (after && after->getParent() == shape) {
+        cache.insert(shape, after->getSlotCount() - 1, after);
+    }
+}
+
+// receiver.name(args) with arguments already on the value stack
+Value NexusInterpreter::invokeMethod(const Value& receiver, const Token& name, size_t argBase) {
+    Value method;
+    try {
+        method = loadProperty(receiver, name);
+    } catch (...) {
+        valueStack.truncate(argBase);
+        throw;
+    }
+    return callValue(method, argBase);
+}
+
+InlineCacheStats NexusInterpreter::getInlineCacheStats() const {
+    InlineCacheStats stats;
+    stats.sites = propertyCaches.size();
+    for (const auto& [site, cache] : propertyCaches) {
+        stats.hits += cache.hits;
+        stats.misses += cache.misses;
+        if (cache.megamorphic) {
+            stats.megamorphic++;
+        } else if (cache.count > 1) {
+            stats.polymorphic++;
+        } else if (cache.count == 1) {
+            stats.monomorphic++;
+        }
+    }
+    return stats;
+}
+
+void NexusInterpreter::printProfile() const {
+    InlineCacheStats stats = getInlineCacheStats();
+    uint64_t lookups = stats.hits + stats.misses;
+    double hitRate = lookups ? 100.0 * static_cast<double>(stats.hits) / static_cast<double>(lookups) : 0.0;
+
+    std::cout << "=== Profile ===" << std::endl;
+    std::cout << "Inline caches: " << stats.sites << " sites ("
+              << stats.monomorphic << " monomorphic, "
+              << stats.polymorphic << " polymorphic, "
+              << stats.megamorphic << " megamorphic)" << std::endl;
+    std::cout << "  hits: " << stats.hits << ", misses: " << stats.misses
+              << ", hit rate: " << std::fixed << std::setprecision(1) << hitRate << "%" << std::endl;
+}
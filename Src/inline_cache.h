@@ -0,0 +1,54 @@
+#pragma once
+
+#include "shape.h"
+#include <cstddef>
+#include <cstdint>
+
+// Inline cache for one property-get, property-set or method-call site.
+// Remembers up to four shapes and the slot each keeps the property in; a
+// site that sees more shapes than that goes megamorphic and stops caching.
+struct PropertyCache {
+    static constexpr size_t MAX_ENTRIES = 4;
+
+    struct Entry {
+        Shape* shape = nullptr;
+        Shape* transition = nullptr;  // Set for stores that add the property
+        uint32_t slot = 0;
+    };
+
+    Entry entries[MAX_ENTRIES];
+    uint8_t count = 0;
+    bool megamorphic = false;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    const Entry* lookup(const Shape* shape) {
+        for (uint8_t i = 0; i < count; ++i) {
+            if (entries[i].shape == shape) {
+                hits++;
+                return &entries[i];
+            }
+        }
+        misses++;
+        return nullptr;
+    }
+
+    void insert(Shape* shape, uint32_t slot, Shape* transition = nullptr) {
+        if (megamorphic) return;
+        if (count == MAX_ENTRIES) {
+            megamorphic = true;
+            return;
+        }
+        entries[count++] = Entry{shape, transition, slot};
+    }
+};
+
+// Aggregate counters reported by the profiler
+struct InlineCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t sites = 0;
+    size_t monomorphic = 0;
+    size_t polymorphic = 0;
+    size_t megamorphic = 0;
+};
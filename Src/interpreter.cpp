@@ -0,0 +1,1276 @@
+#include "interpreter.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+bool opens(TokenType type) {
+    return type == TokenType::LEFT_PAREN || type == TokenType::LEFT_BRACKET || type == TokenType::LEFT_BRACE;
+}
+
+bool closes(TokenType type) {
+    return type == TokenType::RIGHT_PAREN || type == TokenType::RIGHT_BRACKET || type == TokenType::RIGHT_BRACE;
+}
+
+// Index of the token closing the bracket opened at open, or the last token
+size_t closing(const std::vector<Token>& tokens, size_t open) {
+    int depth = 0;
+    for (size_t pos = open; pos < tokens.size(); ++pos) {
+        if (opens(tokens[pos].type)) {
+            depth++;
+        } else if (closes(tokens[pos].type) && --depth == 0) {
+            return pos;
+        }
+    }
+    return tokens.empty() ? 0 : tokens.size() - 1;
+}
+
+// Keywords that start a typed declaration ('int n = 0', 'tensor t = ...')
+bool isTypeKeyword(TokenType type) {
+    switch (type) {
+        case TokenType::INT:
+        case TokenType::LONG:
+        case TokenType::FLOAT:
+        case TokenType::DOUBLE:
+        case TokenType::STRING_TYPE:
+        case TokenType::BOOLEAN_TYPE:
+        case TokenType::CHAR:
+        case TokenType::BYTE:
+        case TokenType::SHORT:
+        case TokenType::TENSOR:
+        case TokenType::MATRIX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isAssignmentOperator(TokenType type) {
+    switch (type) {
+        case TokenType::ASSIGN:
+        case TokenType::PLUS_ASSIGN:
+        case TokenType::MINUS_ASSIGN:
+        case TokenType::MULTIPLY_ASSIGN:
+        case TokenType::DIVIDE_ASSIGN:
+        case TokenType::MODULO_ASSIGN:
+        case TokenType::POWER_ASSIGN:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// PLUS for PLUS_ASSIGN and so on
+TokenType binaryOperator(TokenType type) {
+    switch (type) {
+        case TokenType::PLUS_ASSIGN: return TokenType::PLUS;
+        case TokenType::MINUS_ASSIGN: return TokenType::MINUS;
+        case TokenType::MULTIPLY_ASSIGN: return TokenType::MULTIPLY;
+        case TokenType::DIVIDE_ASSIGN: return TokenType::DIVIDE;
+        case TokenType::POWER_ASSIGN: return TokenType::POWER;
+        default: return TokenType::MODULO;
+    }
+}
+
+// Index of the assignment operator when the statement at pos is 'name',
+// any '.name' and '[index]' accessors, then an assignment; 0 otherwise
+size_t assignmentOperator(const std::vector<Token>& tokens, size_t pos) {
+    if (pos >= tokens.size() || tokens[pos].type != TokenType::IDENTIFIER) return 0;
+    for (++pos; pos < tokens.size(); ++pos) {
+        TokenType type = tokens[pos].type;
+        if (isAssignmentOperator(type)) return pos;
+        if (type == TokenType::DOT && pos + 1 < tokens.size() && tokens[pos + 1].type == TokenType::IDENTIFIER) {
+            pos++;
+        } else if (type == TokenType::LEFT_BRACKET) {
+            pos = closing(tokens, pos);
+        } else {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// Index of the token ending the operand that starts at pos: one of stops,
+// a ',' or ';', or a bracket closing an enclosing one. Used to skip the
+// operands that short-circuiting and '?:' do not evaluate.
+size_t skipOperand(const std::vector<Token>& tokens, size_t pos, std::initializer_list<TokenType> stops) {
+    int depth = 0;
+    int conditionals = 0;  // '?' inside the operand whose ':' is still ahead
+    for (; pos < tokens.size(); ++pos) {
+        TokenType type = tokens[pos].type;
+        if (opens(type)) {
+            depth++;
+        } else if (closes(type)) {
+            if (depth == 0) return pos;
+            depth--;
+        } else if (depth > 0) {
+            continue;
+        } else if (type == TokenType::COLON && conditionals > 0) {
+            conditionals--;
+        } else if (std::find(stops.begin(), stops.end(), type) != stops.end() ||
+                   type == TokenType::COMMA || type == TokenType::SEMICOLON ||
+                   type == TokenType::EOF_TOKEN || isAssignmentOperator(type)) {
+            return pos;
+        } else if (type == TokenType::QUESTION) {
+            conditionals++;
+        }
+    }
+    return pos;
+}
+
+// Index just past the statement at pos, without running it
+size_t skipStatement(const std::vector<Token>& tokens, size_t pos) {
+    if (pos >= tokens.size()) return pos;
+    switch (tokens[pos].type) {
+        case TokenType::LEFT_BRACE:
+            return closing(tokens, pos) + 1;
+        case TokenType::IF:
+            pos = skipStatement(tokens, closing(tokens, pos + 1) + 1);
+            if (pos < tokens.size() && tokens[pos].type == TokenType::ELSE) pos = skipStatement(tokens, pos + 1);
+            return pos;
+        case TokenType::WHILE:
+        case TokenType::FOR:
+            return skipStatement(tokens, closing(tokens, pos + 1) + 1);
+        case TokenType::TRY:
+            pos = closing(tokens, pos + 1) + 1;
+            if (pos < tokens.size() && tokens[pos].type == TokenType::CATCH) {
+                pos = closing(tokens, closing(tokens, pos + 1) + 1) + 1;
+            }
+            if (pos < tokens.size() && tokens[pos].type == TokenType::FINALLY) pos = closing(tokens, pos + 1) + 1;
+            return pos;
+        case TokenType::FUNCTION:
+            if (pos + 1 < tokens.size() && tokens[pos + 1].type == TokenType::IDENTIFIER) {
+                while (pos < tokens.size() && tokens[pos].type != TokenType::LEFT_BRACE) pos++;
+                return closing(tokens, pos) + 1;
+            }
+            break;
+        default:
+            break;
+    }
+
+    // Simple statement: through its ';', or up to the '}' of its block
+    int depth = 0;
+    for (; pos < tokens.size(); ++pos) {
+        TokenType type = tokens[pos].type;
+        if (opens(type)) {
+            depth++;
+        } else if (closes(type)) {
+            if (depth == 0) return pos;
+            depth--;
+        } else if (depth == 0 && type == TokenType::SEMICOLON) {
+            return pos + 1;
+        } else if (type == TokenType::EOF_TOKEN) {
+            return pos;
+        }
+    }
+    return pos;
+}
+
+// Index of the loop variable when the for header opening at pos is a
+// for-each ('x in e', 'var x in e', 'var x : e', 'int x : e'); 0 otherwise
+size_t forEachVariable(const std::vector<Token>& tokens, size_t pos) {
+    if (pos < tokens.size() && (tokens[pos].type == TokenType::VAR || isTypeKeyword(tokens[pos].type))) {
+        pos++;
+        while (pos + 1 < tokens.size() && tokens[pos].type == TokenType::LEFT_BRACKET &&
+               tokens[pos + 1].type == TokenType::RIGHT_BRACKET) {
+            pos += 2;
+        }
+    }
+    if (pos + 1 >= tokens.size() || tokens[pos].type != TokenType::IDENTIFIER) return 0;
+    const Token& next = tokens[pos + 1];
+    if (next.type == TokenType::COLON || (next.type == TokenType::IDENTIFIER && next.value == "in")) return pos;
+    return 0;
+}
+
+// Value of a typed declaration or conversion ('int n = 2.7', 'float(n)')
+Value convertTo(TokenType type, const Value& value) {
+    switch (type) {
+        case TokenType::LONG: return value.convertToInteger(64);
+        case TokenType::INT: return value.convertToInteger(32);
+        case TokenType::SHORT: return value.convertToInteger(16);
+        case TokenType::BYTE: return value.convertToInteger(8);
+        case TokenType::FLOAT:
+        case TokenType::DOUBLE: return Value(value.toNumber());
+        case TokenType::STRING_TYPE:
+        case TokenType::CHAR: return value.isString() ? value : Value(value.toString());
+        case TokenType::BOOLEAN_TYPE: return Value(value.isTruthy());
+        case TokenType::TENSOR:
+        case TokenType::MATRIX: return value.isArray() ? Value(value.toTensor()) : value;
+        default: return value;
+    }
+}
+
+// Initial value of a typed declaration without an initializer
+Value defaultOf(TokenType type) {
+    switch (type) {
+        case TokenType::LONG:
+        case TokenType::INT:
+        case TokenType::SHORT:
+        case TokenType::BYTE: return Value(int64_t(0));
+        case TokenType::FLOAT:
+        case TokenType::DOUBLE: return Value(0.0);
+        case TokenType::STRING_TYPE:
+        case TokenType::CHAR: return Value("");
+        case TokenType::BOOLEAN_TYPE: return Value(false);
+        default: return Value();
+    }
+}
+
+// container[key] for reading
+Value elementOf(const Value& container, const Value& key) {
+    if (container.isArray()) return container.elementAt(key.asInteger());
+    if (container.isObject()) {
+        const Value* found = container.findProperty(key.isString() ? key.asString() : key.toString());
+        return found ? *found : Value();
+    }
+    return container.get(key);
+}
+
+// container[key] = value. A vector's element is written through
+// mutableTensor, so storage shared with another value is copied first.
+void storeElement(Value& container, const Value& key, Value value) {
+    if (container.isArray()) {
+        container.setElement(key.asInteger(), std::move(value));
+    } else if (container.isObject()) {
+        container.setProperty(key.isString() ? key.asString() : key.toString(), std::move(value));
+    } else if (container.isTensor() && container.asTensor()->getDimensions() == 1) {
+        int64_t index = key.asInteger();
+        if (index < 0 || static_cast<size_t>(index) >= container.asTensor()->getSize()) {
+            throw std::out_of_range("Tensor index out of bounds");
+        }
+        container.mutableTensor()[static_cast<size_t>(index)] = value.asNumber();
+    } else {
+        container.set(key, value);
+    }
+}
+
+// Counts a loop or try block for as long as it runs
+class Nesting {
+private:
+    int& depth;
+
+public:
+    explicit Nesting(int& counter) : depth(counter) { depth++; }
+    ~Nesting() { depth--; }
+    Nesting(const Nesting&) = delete;
+    Nesting& operator=(const Nesting&) = delete;
+};
+
+} // namespace
+
+NexusInterpreter::NexusInterpreter()
+    : globals(context.getGlobal()), environment(globals), debugMode(false), profilingMode(false) {
+    RuntimeContext::Scope scope(context);
+    setupBuiltins();
+}
+
+// Globals and closures refer to each other, so the scope is emptied and the
+// remaining cycles collected while the context their payloads credit is
+// still alive
+NexusInterpreter::~NexusInterpreter() {
+    RuntimeContext::Scope scope(context);
+    environment = globals;
+    globals->clear();
+    models.clear();
+    collector.collectMajor();
+}
+
+// ---- Entry points ----
+
+void NexusInterpreter::execute(const std::string& source) {
+    RuntimeContext::Scope scope(context);
+    std::shared_ptr<const std::vector<Token>> tokens = tokenize(source);
+    std::shared_ptr<const std::vector<Token>> previous = std::exchange(program, tokens);
+    bool topLevel = !previous;  // Not an import
+    try {
+        executeStatements(*tokens);
+    } catch (...) {
+        program = std::move(previous);
+        throw;
+    }
+    program = std::move(previous);
+    if (!topLevel) return;
+    if (profilingMode) printProfile();
+    printRunReport(std::cout);
+}
+
+void NexusInterpreter::executeFile(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        runtimeError("Cannot open file '" + filename + "'");
+    }
+    std::stringstream source;
+    source << file.rdbuf();
+    execute(source.str());
+}
+
+Value NexusInterpreter::evaluateExpression(const std::string& expression) {
+    RuntimeContext::Scope scope(context);
+    std::shared_ptr<const std::vector<Token>> tokens = tokenize(expression);
+    std::shared_ptr<const std::vector<Token>> previous = std::exchange(program, tokens);
+    try {
+        size_t pos = 0;
+        Value result = evaluateExpression(*tokens, pos);
+        if (!isAtEnd(*tokens, pos)) runtimeError((*tokens)[pos], "Unexpected '" + (*tokens)[pos].value + "' after expression");
+        program = std::move(previous);
+        return result;
+    } catch (...) {
+        program = std::move(previous);
+        throw;
+    }
+}
+
+// Tokens the executor reads: newlines and comments are dropped once here
+std::shared_ptr<const std::vector<Token>> NexusInterpreter::tokenize(const std::string& source) const {
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.tokenize();
+    tokens.erase(std::remove_if(tokens.begin(), tokens.end(),
+                                [](const Token& token) {
+                                    return token.type == TokenType::NEWLINE || token.type == TokenType::COMMENT ||
+                                           token.type == TokenType::MULTILINE_COMMENT;
+                                }),
+                 tokens.end());
+    if (tokens.empty() || tokens.back().type != TokenType::EOF_TOKEN) tokens.emplace_back(TokenType::EOF_TOKEN, "");
+    return std::make_shared<const std::vector<Token>>(std::move(tokens));
+}
+
+// Handle on the stream tokens refers to, for closures created from it: the
+// running function's, or the top-level program's
+std::shared_ptr<const std::vector<Token>> NexusInterpreter::shareTokens(const std::vector<Token>& tokens) const {
+    if (!frames.empty() && &frames.back().function->getTokens() == &tokens) {
+        return frames.back().function->shareTokens();
+    }
+    return program;
+}
+
+// ---- Statements ----
+
+void NexusInterpreter::executeStatements(const std::vector<Token>& tokens) {
+    size_t pos = 0;
+    while (!isAtEnd(tokens, pos)) {
+        pos = executeStatement(tokens, pos);
+    }
+}
+
+// Runs the statement at start and returns the index past it. Once a return,
+// break or continue is under way (interrupted()) the index is meaningless:
+// every enclosing statement stops and the loop or call that handles it
+// knows where it ends. The temporaries it allocates are rewound with its
+// scratch arena statement.
+size_t NexusInterpreter::executeStatement(const std::vector<Token>& tokens, size_t start) {
+    ScratchArena::Statement statement;
+    const Token& token = tokens[start];
+    switch (token.type) {
+        case TokenType::LEFT_BRACE:
+            return executeBlock(tokens, start);
+        case TokenType::SEMICOLON:
+            return start + 1;
+        case TokenType::VAR:
+            return executeVariableDeclaration(tokens, start);
+        case TokenType::FUNCTION:
+            if (check(tokens, start + 1, TokenType::IDENTIFIER)) return executeFunctionDeclaration(tokens, start);
+            return executeExpressionStatement(tokens, start);
+        case TokenType::MODEL:
+            return executeModelDeclaration(tokens, start);
+        case TokenType::TRAIN:
+            return executeTrainStatement(tokens, start);
+        case TokenType::IF:
+            return executeIfStatement(tokens, start);
+        case TokenType::WHILE:
+            return executeWhileStatement(tokens, start);
+        case TokenType::FOR:
+            return executeForStatement(tokens, start);
+        case TokenType::RETURN:
+            return executeReturnStatement(tokens, start);
+        case TokenType::IMPORT:
+            return executeImportStatement(tokens, start);
+        case TokenType::TRY:
+            return executeTryStatement(tokens, start);
+        case TokenType::BREAK:
+        case TokenType::CONTINUE: {
+            if (loopDepth == 0) runtimeError(token, "'" + token.value + "' outside a loop");
+            (token.type == TokenType::BREAK ? breaking : continuing) = true;
+            size_t pos = start + 1;
+            match(tokens, pos, TokenType::SEMICOLON);
+            return pos;
+        }
+        case TokenType::THROW: {
+            size_t pos = start + 1;
+            Value thrown = evaluateExpression(tokens, pos);
+            throw RuntimeError(thrown.toString(), thrown);
+        }
+        default:
+            break;
+    }
+    if (isTypeKeyword(token.type) && !check(tokens, start + 1, TokenType::LEFT_PAREN)) {
+        return executeVariableDeclaration(tokens, start);
+    }
+    if (assignmentOperator(tokens, start)) return executeAssignment(tokens, start);
+    return executeExpressionStatement(tokens, start);
+}
+
+// start is the '{'. Top-level blocks share the enclosing scope; in a
+// function body their declarations are scoped by the frame layout.
+size_t NexusInterpreter::executeBlock(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start + 1;
+    while (!check(tokens, pos, TokenType::RIGHT_BRACE) && !isAtEnd(tokens, pos)) {
+        pos = executeStatement(tokens, pos);
+        if (interrupted()) return pos;
+    }
+    consume(tokens, pos, TokenType::RIGHT_BRACE, "Expected '}' after block");
+    return pos;
+}
+
+// Index past the '}' matching the '{' at start
+size_t NexusInterpreter::findBlockEnd(const std::vector<Token>& tokens, size_t start) {
+    return closing(tokens, start) + 1;
+}
+
+// 'var x = e;', 'var [a, b] = e;' and typed declarations ('int n = e;',
+// 'int[] xs;', 'tensor<float> t = e;'), bound through the declaring token
+size_t NexusInterpreter::executeVariableDeclaration(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start;
+    TokenType type = tokens[pos++].type;
+
+    if (type == TokenType::VAR && match(tokens, pos, TokenType::LEFT_BRACKET)) {
+        size_t first = pos;
+        while (!check(tokens, pos, TokenType::RIGHT_BRACKET) && !isAtEnd(tokens, pos)) pos++;
+        size_t last = pos++;
+        consume(tokens, pos, TokenType::ASSIGN, "Expected '=' after destructuring pattern");
+        Value source = evaluateExpression(tokens, pos);
+        int64_t index = 0;
+        for (size_t name = first; name < last; ++name) {
+            if (tokens[name].type != TokenType::IDENTIFIER) continue;
+            defineVariable(tokens[name], source.elementAt(index++));
+        }
+        match(tokens, pos, TokenType::SEMICOLON);
+        return pos;
+    }
+
+    while (check(tokens, pos, TokenType::LEFT_BRACKET) && check(tokens, pos + 1, TokenType::RIGHT_BRACKET)) pos += 2;
+    if (match(tokens, pos, TokenType::GENERIC_START)) {
+        while (!check(tokens, pos, TokenType::GENERIC_END) && !isAtEnd(tokens, pos)) pos++;
+        pos++;
+    }
+    if (!check(tokens, pos, TokenType::IDENTIFIER)) {
+        runtimeError(tokens[pos], "Expected variable name");
+    }
+    const Token& name = tokens[pos++];
+    Value value = defaultOf(type);
+    if (match(tokens, pos, TokenType::ASSIGN)) {
+        value = type == TokenType::VAR ? evaluateExpression(tokens, pos) : convertTo(type, evaluateExpression(tokens, pos));
+    }
+    defineVariable(name, std::move(value));
+    match(tokens, pos, TokenType::SEMICOLON);
+    return pos;
+}
+
+// 'function name(params) { body }'
+size_t NexusInterpreter::executeFunctionDeclaration(const std::vector<Token>& tokens, size_t start) {
+    const Token& name = tokens[start + 1];
+    size_t bodyStart = start + 2;
+    while (!check(tokens, bodyStart, TokenType::LEFT_BRACE) && !isAtEnd(tokens, bodyStart)) bodyStart++;
+    if (!check(tokens, bodyStart, TokenType::LEFT_BRACE)) {
+        runtimeError(name, "Expected function body");
+    }
+    std::shared_ptr<NexusFunction> function =
+        makeFunction(name.value, FrameLayout::parameterNames(tokens, start), shareTokens(tokens), bodyStart);
+    defineVariable(name, Value(std::static_pointer_cast<Callable>(function)));
+    return findBlockEnd(tokens, bodyStart);
+}
+
+// 'name = e;', 'name op= e;' and the same through '.name' and '[index]'
+// accessors. Index keys are evaluated left to right before the right-hand
+// side and parked on the value stack.
+size_t NexusInterpreter::executeAssignment(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start;
+    const Token& name = tokens[pos++];
+    size_t path = pos;
+    size_t base = valueStack.size();
+    try {
+        while (!isAtEnd(tokens, pos) && !isAssignmentOperator(tokens[pos].type)) {
+            if (match(tokens, pos, TokenType::DOT)) {
+                consume(tokens, pos, TokenType::IDENTIFIER, "Expected property name after '.'");
+            } else {
+                consume(tokens, pos, TokenType::LEFT_BRACKET, "Expected assignment");
+                valueStack.push(evaluateExpression(tokens, pos));
+                consume(tokens, pos, TokenType::RIGHT_BRACKET, "Expected ']' after index");
+            }
+        }
+        size_t end = pos;
+        if (isAtEnd(tokens, pos)) runtimeError(name, "Expected assignment");
+        TokenType op = tokens[pos++].type;
+
+        if (end == path && op == TokenType::ASSIGN) {
+            assignVariable(name, evaluateUpdate(tokens, pos, name.value));
+        } else if (end == path) {
+            Value operand = evaluateExpression(tokens, pos);
+            assignVariable(name, updateVariable(name, binaryOperator(op), operand));
+        } else {
+            Value value = evaluateExpression(tokens, pos);
+            if (op != TokenType::ASSIGN) {
+                value = applyOperator(loadThrough(lookupVariable(name), tokens, path, end, base),
+                                      binaryOperator(op), value);
+            }
+            storeThrough(*variableStorage(name), tokens, path, end, base, std::move(value));
+        }
+    } catch (...) {
+        valueStack.truncate(base);
+        throw;
+    }
+    valueStack.truncate(base);
+    match(tokens, pos, TokenType::SEMICOLON);
+    return pos;
+}
+
+// Storage of a variable that is written through (element and property
+// stores); the variable has to exist and not be a constant
+Value* NexusInterpreter::variableStorage(const Token& name) {
+    if (Value* local = resolveLocal(name)) return local;
+    if (Value* cell = globalCell(name, true)) return cell;
+    Environment* owner = environment->findEnvironmentWithVariable(name.value);
+    if (!owner) runtimeError(name, "Undefined variable '" + name.value + "'");
+    if (owner->isConstant(name.value)) runtimeError(name, "Cannot assign to constant '" + name.value + "'");
+    collector.touch(owner);
+    return owner->findCell(name.value);
+}
+
+// Reads container through the accessors in [pos, end)
+Value NexusInterpreter::loadThrough(Value container, const std::vector<Token>& tokens, size_t pos, size_t end,
+                                    size_t keyIndex) {
+    while (pos < end) {
+        if (tokens[pos].type == TokenType::DOT) {
+            container = loadProperty(container, tokens[pos + 1]);
+            pos += 2;
+        } else {
+            container = elementOf(container, valueStack[keyIndex++]);
+            pos = closing(tokens, pos) + 1;
+        }
+    }
+    return container;
+}
+
+// Stores value at the end of the accessors in [pos, end). Each container on
+// the way is taken out of its parent while it is written, so one that
+// nothing else shares is updated in place instead of copied.
+void NexusInterpreter::storeThrough(Value& container, const std::vector<Token>& tokens, size_t pos, size_t end,
+                                    size_t keyIndex, Value value) {
+    bool property = tokens[pos].type == TokenType::DOT;
+    const Token& name = tokens[pos + 1];
+    size_t next = property ? pos + 2 : closing(tokens, pos) + 1;
+    auto put = [&](Value element) {
+        if (property) {
+            storeProperty(container, name, std::move(element));
+        } else {
+            storeElement(container, valueStack[keyIndex], std::move(element));
+        }
+    };
+
+    if (next == end) {
+        put(std::move(value));
+        return;
+    }
+
+    Value child = property ? loadProperty(container, name) : elementOf(container, valueStack[keyIndex]);
+    bool detached = child.isArray() || child.isObject();
+    if (detached) put(Value());
+    try {
+        storeThrough(child, tokens, next, end, property ? keyIndex : keyIndex + 1, std::move(value));
+    } catch (...) {
+        if (detached) put(std::move(child));
+        throw;
+    }
+    put(std::move(child));
+}
+
+size_t NexusInterpreter::executeIfStatement(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start + 1;
+    consume(tokens, pos, TokenType::LEFT_PAREN, "Expected '(' after 'if'");
+    Value condition = evaluateExpression(tokens, pos);
+    consume(tokens, pos, TokenType::RIGHT_PAREN, "Expected ')' after condition");
+
+    if (condition.isTruthy()) {
+        pos = executeStatement(tokens, pos);
+        if (interrupted()) return pos;
+        if (match(tokens, pos, TokenType::ELSE)) pos = skipStatement(tokens, pos);
+    } else {
+        pos = skipStatement(tokens, pos);
+        if (match(tokens, pos, TokenType::ELSE)) pos = executeStatement(tokens, pos);
+    }
+    return pos;
+}
+
+// Each iteration is a scratch arena statement, as in the loops below, so
+// the condition's temporaries do not pile up until the loop ends
+size_t NexusInterpreter::executeWhileStatement(const std::vector<Token>& tokens, size_t start) {
+    Nesting loop(loopDepth);
+    size_t body = 0;
+    while (true) {
+        ScratchArena::Statement iteration;
+        size_t pos = start + 1;
+        consume(tokens, pos, TokenType::LEFT_PAREN, "Expected '(' after 'while'");
+        Value condition = evaluateExpression(tokens, pos);
+        consume(tokens, pos, TokenType::RIGHT_PAREN, "Expected ')' after condition");
+        body = pos;
+        if (!condition.isTruthy()) break;
+
+        executeStatement(tokens, body);
+        continuing = false;
+        if (breaking) {
+            breaking = false;
+            break;
+        }
+        if (returning) return body;
+    }
+    return skipStatement(tokens, body);
+}
+
+// 'for (init; condition; update) body'. A variable declared by init is
+// scoped to the loop: a frame slot in a function, otherwise a scope of its
+// own around the loop. For-each headers go to executeForEach.
+size_t NexusInterpreter::executeForStatement(const std::vector<Token>& tokens, size_t start) {
+    size_t header = start + 1;
+    size_t pos = header;
+    consume(tokens, pos, TokenType::LEFT_PAREN, "Expected '(' after 'for'");
+    size_t body = closing(tokens, header) + 1;
+
+    if (size_t variable = forEachVariable(tokens, pos)) {
+        pos = variable + 2;
+        Value iterable = evaluateExpression(tokens, pos);
+        consume(tokens, pos, TokenType::RIGHT_PAREN, "Expected ')' after for-each header");
+        if (!check(tokens, pos, TokenType::LEFT_BRACE)) runtimeError(tokens[start], "Expected '{' after for-each header");
+        Nesting loop(loopDepth);
+        return executeForEach(tokens, pos, tokens[variable], iterable);
+    }
+
+    std::shared_ptr<Environment> previous = environment;
+    bool declares = check(tokens, pos, TokenType::VAR) || isTypeKeyword(tokens[pos].type);
+    if (declares && check(tokens, pos + 1, TokenType::IDENTIFIER) && !resolveLocal(tokens[pos + 1])) {
+        environment = std::make_shared<Environment>(environment, "for");
+    }
+
+    Nesting loop(loopDepth);
+    try {
+        if (declares) {
+            pos = executeVariableDeclaration(tokens, pos);
+        } else if (!match(tokens, pos, TokenType::SEMICOLON)) {
+            pos = executeStatement(tokens, pos);
+        }
+        size_t condition = pos;
+        size_t update = skipOperand(tokens, condition, {}) + 1;
+
+        while (true) {
+            ScratchArena::Statement iteration;
+            pos = condition;
+            if (!check(tokens, pos, TokenType::SEMICOLON) && !evaluateExpression(tokens, pos).isTruthy()) break;
+
+            executeStatement(tokens, body);
+            continuing = false;
+            if (breaking) {
+                breaking = false;
+                break;
+            }
+            if (returning) break;
+
+            pos = update;
+            if (assignmentOperator(tokens, pos)) {
+                executeAssignment(tokens, pos);
+            } else if (!check(tokens, pos, TokenType::RIGHT_PAREN)) {
+                evaluateExpression(tokens, pos);
+            }
+        }
+    } catch (...) {
+        environment = previous;
+        throw;
+    }
+    environment = previous;
+    return returning ? body : skipStatement(tokens, body);
+}
+
+size_t NexusInterpreter::executeExpressionStatement(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start;
+    evaluateExpression(tokens, pos);
+    if (!match(tokens, pos, TokenType::SEMICOLON) && !check(tokens, pos, TokenType::RIGHT_BRACE) &&
+        !isAtEnd(tokens, pos)) {
+        runtimeError(tokens[pos], "Expected ';' after expression");
+    }
+    return pos;
+}
+
+// 'return;', 'return e;', and 'return f(args);' which leaves the call to the
+// caller's trampoline (invokeFunction) instead of recursing
+size_t NexusInterpreter::executeReturnStatement(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start + 1;
+    if (callDepth == 0) {
+        runtimeError(tokens[start], "'return' outside a function");
+    }
+    if (isTailCall(tokens, pos)) return executeTailCall(tokens, pos);
+
+    if (check(tokens, pos, TokenType::SEMICOLON) || check(tokens, pos, TokenType::RIGHT_BRACE)) {
+        returnValue = Value();
+    } else {
+        returnValue = evaluateExpression(tokens, pos);
+    }
+    match(tokens, pos, TokenType::SEMICOLON);
+    returning = true;
+    return pos;
+}
+
+// 'import "file";' runs the file's top-level code in the global scope once
+// per interpreter
+size_t NexusInterpreter::executeImportStatement(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start + 1;
+    if (!check(tokens, pos, TokenType::STRING) && !check(tokens, pos, TokenType::IDENTIFIER)) {
+        runtimeError(tokens[start], "Expected file name after 'import'");
+    }
+    std::string path = tokens[pos++].value;
+    if (path.find('.') == std::string::npos) path += ".nx";
+    match(tokens, pos, TokenType::SEMICOLON);
+    if (!imports.insert(path).second) return pos;
+
+    std::shared_ptr<Environment> previous = std::exchange(environment, globals);
+    try {
+        executeFile(path);
+    } catch (...) {
+        environment = previous;
+        throw;
+    }
+    environment = previous;
+    return pos;
+}
+
+// 'try { } catch (e) { } finally { }'. The body is a protected region, and
+// so is the handler when a finally follows; isTailCall refuses tail calls
+// there. A return, break or continue in finally replaces one in progress.
+size_t NexusInterpreter::executeTryStatement(const std::vector<Token>& tokens, size_t start) {
+    size_t body = start + 1;
+    if (!check(tokens, body, TokenType::LEFT_BRACE)) {
+        runtimeError(tokens[start], "Expected '{' after 'try'");
+    }
+    size_t pos = findBlockEnd(tokens, body);
+    size_t variable = 0;
+    size_t handler = 0;
+    size_t cleanup = 0;
+    if (check(tokens, pos, TokenType::CATCH)) {
+        size_t header = pos + 1;
+        consume(tokens, header, TokenType::LEFT_PAREN, "Expected '(' after 'catch'");
+        if (!check(tokens, header, TokenType::IDENTIFIER)) runtimeError(tokens[header], "Expected variable name in catch");
+        variable = header++;
+        consume(tokens, header, TokenType::RIGHT_PAREN, "Expected ')' after catch variable");
+        handler = header;
+        pos = findBlockEnd(tokens, handler);
+    }
+    if (check(tokens, pos, TokenType::FINALLY)) {
+        cleanup = pos + 1;
+        pos = findBlockEnd(tokens, cleanup);
+    }
+    if (!handler && !cleanup) {
+        runtimeError(tokens[start], "Expected 'catch' or 'finally' after try block");
+    }
+
+    std::exception_ptr failure;
+    Value caught;
+    {
+        Nesting guarded(tryDepth);
+        try {
+            executeBlock(tokens, body);
+        } catch (const RuntimeError& error) {
+            failure = std::current_exception();
+            caught = error.getValue().isNil() ? Value(error.what()) : error.getValue();
+        } catch (const std::exception& error) {
+            failure = std::current_exception();
+            caught = Value(error.what());
+        }
+    }
+
+    if (failure && handler) {
+        failure = nullptr;
+        std::shared_ptr<Environment> previous = environment;
+        try {
+            std::optional<Nesting> guarded;
+            if (cleanup) guarded.emplace(tryDepth);
+            if (!resolveLocal(tokens[variable])) {
+                environment = std::make_shared<Environment>(environment, "catch");
+                environment->define(tokens[variable].value, Value());
+            }
+            defineVariable(tokens[variable], std::move(caught));
+            executeBlock(tokens, handler);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        environment = previous;
+    }
+
+    if (cleanup) {
+        bool wasReturning = std::exchange(returning, false);
+        bool wasBreaking = std::exchange(breaking, false);
+        bool wasContinuing = std::exchange(continuing, false);
+        Value pendingValue = std::move(returnValue);
+        executeBlock(tokens, cleanup);
+        if (interrupted()) return pos;
+        returning = wasReturning;
+        breaking = wasBreaking;
+        continuing = wasContinuing;
+        returnValue = std::move(pendingValue);
+    }
+
+    if (failure) std::rethrow_exception(failure);
+    return pos;
+}
+
+// 'model name = [784, 256, 10];' builds a network with those layer sizes;
+// the name is also bound to the architecture
+size_t NexusInterpreter::executeModelDeclaration(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start + 1;
+    if (!check(tokens, pos, TokenType::IDENTIFIER)) runtimeError(tokens[start], "Expected model name");
+    const Token& name = tokens[pos++];
+    consume(tokens, pos, TokenType::ASSIGN, "Expected '=' after model name");
+    Value layers = evaluateExpression(tokens, pos);
+    if (!layers.isArray()) runtimeError(name, "Model architecture must be an array of layer sizes");
+
+    std::vector<int> architecture;
+    architecture.reserve(layers.arraySize());
+    for (size_t i = 0; i < layers.arraySize(); ++i) {
+        architecture.push_back(static_cast<int>(layers.elementAt(static_cast<int64_t>(i)).asInteger()));
+    }
+    createModel(name.value, architecture);
+    defineVariable(name, std::move(layers));
+    match(tokens, pos, TokenType::SEMICOLON);
+    return pos;
+}
+
+// 'train name;' or 'train name({inputs: x, targets: y, epochs: 10});'
+size_t NexusInterpreter::executeTrainStatement(const std::vector<Token>& tokens, size_t start) {
+    size_t pos = start + 1;
+    if (!check(tokens, pos, TokenType::IDENTIFIER)) runtimeError(tokens[start], "Expected model name after 'train'");
+    const Token& name = tokens[pos++];
+    std::map<std::string, Value> params;
+    if (match(tokens, pos, TokenType::LEFT_PAREN)) {
+        Value options = evaluateExpression(tokens, pos);
+        consume(tokens, pos, TokenType::RIGHT_PAREN, "Expected ')' after training options");
+        if (!options.isObject()) runtimeError(name, "Training options must be an object");
+        for (auto it = options.begin(); it != options.end(); ++it) params.emplace(it.key(), *it);
+    }
+    trainModel(name.value, params);
+    match(tokens, pos, TokenType::SEMICOLON);
+    return pos;
+}
+
+// ---- Expressions ----
+
+// condition ? a : b, evaluating only the branch taken
+Value NexusInterpreter::evaluateExpression(const std::vector<Token>& tokens, size_t& pos) {
+    Value condition = evaluateLogicalOr(tokens, pos);
+    if (!match(tokens, pos, TokenType::QUESTION)) return condition;
+
+    if (condition.isTruthy()) {
+        Value result = evaluateExpression(tokens, pos);
+        consume(tokens, pos, TokenType::COLON, "Expected ':' in conditional expression");
+        pos = skipOperand(tokens, pos, {TokenType::COLON});
+        return result;
+    }
+    pos = skipOperand(tokens, pos, {TokenType::COLON});
+    consume(tokens, pos, TokenType::COLON, "Expected ':' in conditional expression");
+    return evaluateExpression(tokens, pos);
+}
+
+// '||' and '&&' short-circuit and yield booleans
+Value NexusInterpreter::evaluateLogicalOr(const std::vector<Token>& tokens, size_t& pos) {
+    Value left = evaluateLogicalAnd(tokens, pos);
+    while (match(tokens, pos, TokenType::OR)) {
+        if (left.isTruthy()) {
+            pos = skipOperand(tokens, pos, {TokenType::OR, TokenType::QUESTION, TokenType::COLON});
+            left = Value(true);
+        } else {
+            left = Value(evaluateLogicalAnd(tokens, pos).isTruthy());
+        }
+    }
+    return left;
+}
+
+Value NexusInterpreter::evaluateLogicalAnd(const std::vector<Token>& tokens, size_t& pos) {
+    Value left = evaluateBitwise(tokens, pos);
+    while (match(tokens, pos, TokenType::AND)) {
+        if (!left.isTruthy()) {
+            pos = skipOperand(tokens, pos, {TokenType::AND, TokenType::OR, TokenType::QUESTION, TokenType::COLON});
+            left = Value(false);
+        } else {
+            left = Value(evaluateBitwise(tokens, pos).isTruthy());
+        }
+    }
+    return left;
+}
+
+// '|', '^' and '&', loosest first as in C (level 0, 1, 2)
+Value NexusInterpreter::evaluateBitwise(const std::vector<Token>& tokens, size_t& pos, int level) {
+    static const TokenType operators[] = {TokenType::BITWISE_OR, TokenType::BITWISE_XOR, TokenType::BITWISE_AND};
+    if (level == 3) return evaluateEquality(tokens, pos);
+    Value left = evaluateBitwise(tokens, pos, level + 1);
+    while (match(tokens, pos, operators[level])) {
+        Value right = evaluateBitwise(tokens, pos, level + 1);
+        switch (level) {
+            case 0: left = left | right; break;
+            case 1: left = left ^ right; break;
+            default: left = left & right; break;
+        }
+    }
+    return left;
+}
+
+Value NexusInterpreter::evaluateEquality(const std::vector<Token>& tokens, size_t& pos) {
+    Value left = evaluateComparison(tokens, pos);
+    while (check(tokens, pos, TokenType::EQUALS) || check(tokens, pos, TokenType::NOT_EQUALS)) {
+        bool equals = tokens[pos++].type == TokenType::EQUALS;
+        Value right = evaluateComparison(tokens, pos);
+        left = Value(equals ? left == right : left != right);
+    }
+    return left;
+}
+
+Value NexusInterpreter::evaluateComparison(const std::vector<Token>& tokens, size_t& pos) {
+    Value left = evaluateShift(tokens, pos);
+    while (pos < tokens.size()) {
+        TokenType op = tokens[pos].type;
+        if (op != TokenType::LESS && op != TokenType::LESS_EQUAL && op != TokenType::GREATER &&
+            op != TokenType::GREATER_EQUAL) {
+            break;
+        }
+        pos++;
+        Value right = evaluateShift(tokens, pos);
+        switch (op) {
+            case TokenType::LESS: left = Value(left < right); break;
+            case TokenType::LESS_EQUAL: left = Value(left <= right); break;
+            case TokenType::GREATER: left = Value(left > right); break;
+            default: left = Value(left >= right); break;
+        }
+    }
+    return left;
+}
+
+Value NexusInterpreter::evaluateShift(const std::vector<Token>& tokens, size_t& pos) {
+    Value left = evaluateTerm(tokens, pos);
+    while (check(tokens, pos, TokenType::LEFT_SHIFT) || check(tokens, pos, TokenType::RIGHT_SHIFT)) {
+        bool leftShift = tokens[pos++].type == TokenType::LEFT_SHIFT;
+        Value right = evaluateTerm(tokens, pos);
+        left = leftShift ? left << right : left >> right;
+    }
+    return left;
+}
+
+Value NexusInterpreter::evaluateUnary(const std::vector<Token>& tokens, size_t& pos) {
+    if (pos >= tokens.size()) return evaluatePrimary(tokens, pos);
+    switch (tokens[pos].type) {
+        case TokenType::MINUS:
+            pos++;
+            return -evaluateUnary(tokens, pos);
+        case TokenType::NOT:
+            pos++;
+            return Value(!evaluateUnary(tokens, pos).isTruthy());
+        case TokenType::BITWISE_NOT:
+            pos++;
+            return ~evaluateUnary(tokens, pos);
+        case TokenType::INCREMENT:
+        case TokenType::DECREMENT: {
+            TokenType op = tokens[pos++].type == TokenType::INCREMENT ? TokenType::PLUS : TokenType::MINUS;
+            if (!check(tokens, pos, TokenType::IDENTIFIER)) runtimeError(tokens[pos - 1], "Expected variable after prefix operator");
+            const Token& name = tokens[pos++];
+            Value updated = updateVariable(name, op, Value(int64_t(1)));
+            assignVariable(name, updated);
+            return updated;
+        }
+        default:
+            return evaluatePrimary(tokens, pos);
+    }
+}
+
+// Literals, variables, '( )', array and object literals, function
+// expressions, conversions and 'predict', followed by any calls, '[index]'
+// and '.name' accessors
+Value NexusInterpreter::evaluatePrimary(const std::vector<Token>& tokens, size_t& pos) {
+    if (isAtEnd(tokens, pos)) {
+        runtimeError("Unexpected end of input");
+    }
+    const Token& token = tokens[pos++];
+    Value value;
+    switch (token.type) {
+        case TokenType::NUMBER:
+            value = Value::fromNumberLiteral(token.value);
+            break;
+        case TokenType::STRING:
+            value = Value(token.value);
+            break;
+        case TokenType::TRUE:
+        case TokenType::FALSE:
+            value = Value(token.type == TokenType::TRUE);
+            break;
+        case TokenType::BOOLEAN:
+            value = Value(token.value == "true");
+            break;
+        case TokenType::NULL_TOKEN:
+            break;
+        case TokenType::IDENTIFIER:
+            if (check(tokens, pos, TokenType::INCREMENT) || check(tokens, pos, TokenType::DECREMENT)) {
+                TokenType op = tokens[pos++].type == TokenType::INCREMENT ? TokenType::PLUS : TokenType::MINUS;
+                value = lookupVariable(token);
+                assignVariable(token, updateVariable(token, op, Value(int64_t(1))));
+                return value;
+            }
+            value = lookupVariable(token);
+            break;
+        case TokenType::LEFT_PAREN:
+            value = evaluateExpression(tokens, pos);
+            consume(tokens, pos, TokenType::RIGHT_PAREN, "Expected ')' after expression");
+            break;
+        case TokenType::LEFT_BRACKET: {
+            std::vector<Value> elements;
+            if (!check(tokens, pos, TokenType::RIGHT_BRACKET)) {
+                do {
+                    elements.push_back(evaluateExpression(tokens, pos));
+                } while (match(tokens, pos, TokenType::COMMA));
+            }
+            consume(tokens, pos, TokenType::RIGHT_BRACKET, "Expected ']' after array elements");
+            value = Value(std::move(elements));
+            break;
+        }
+        case TokenType::LEFT_BRACE:
+            value = Value::emptyObject();
+            if (!check(tokens, pos, TokenType::RIGHT_BRACE)) {
+                do {
+                    if (!check(tokens, pos, TokenType::IDENTIFIER) && !check(tokens, pos, TokenType::STRING)) {
+                        runtimeError(tokens[pos], "Expected property name");
+                    }
+                    const Token& key = tokens[pos++];
+                    consume(tokens, pos, TokenType::COLON, "Expected ':' after property name");
+                    storeProperty(value, key, evaluateExpression(tokens, pos));
+                } while (match(tokens, pos, TokenType::COMMA));
+            }
+            consume(tokens, pos, TokenType::RIGHT_BRACE, "Expected '}' after object properties");
+            break;
+        case TokenType::FUNCTION: {
+            size_t bodyStart = pos;
+            while (!check(tokens, bodyStart, TokenType::LEFT_BRACE) && !isAtEnd(tokens, bodyStart)) bodyStart++;
+            if (!check(tokens, bodyStart, TokenType::LEFT_BRACE)) runtimeError(token, "Expected function body");
+            std::string name = check(tokens, pos, TokenType::IDENTIFIER) ? tokens[pos].value : "<anonymous>";
+            value = Value(std::static_pointer_cast<Callable>(
+                makeFunction(name, FrameLayout::parameterNames(tokens, pos - 1), shareTokens(tokens), bodyStart)));
+            pos = findBlockEnd(tokens, bodyStart);
+            break;
+        }
+        case TokenType::PREDICT: {
+            if (!check(tokens, pos, TokenType::IDENTIFIER)) runtimeError(token, "Expected model name after 'predict'");
+            const std::string& name = tokens[pos++].value;
+            Value input;
+            if (match(tokens, pos, TokenType::LEFT_PAREN)) {
+                input = evaluateExpression(tokens, pos);
+                consume(tokens, pos, TokenType::RIGHT_PAREN, "Expected ')' after prediction input");
+            }
+            value = predictModel(name, input);
+            break;
+        }
+        default:
+            if (isTypeKeyword(token.type) && match(tokens, pos, TokenType::LEFT_PAREN)) {
+                value = convertTo(token.type, evaluateExpression(tokens, pos));
+                consume(tokens, pos, TokenType::RIGHT_PAREN, "Expected ')' after conversion");
+                break;
+            }
+            runtimeError(token, "Unexpected '" + token.value + "'");
+    }
+
+    while (pos < tokens.size()) {
+        if (match(tokens, pos, TokenType::LEFT_PAREN)) {
+            value = evaluateCall(tokens, pos, std::move(value));
+        } else if (match(tokens, pos, TokenType::LEFT_BRACKET)) {
+            Value key = evaluateExpression(tokens, pos);
+            consume(tokens, pos, TokenType::RIGHT_BRACKET, "Expected ']' after index");
+            value = elementOf(value, key);
+        } else if (match(tokens, pos, TokenType::DOT)) {
+            if (!check(tokens, pos, TokenType::IDENTIFIER)) runtimeError(tokens[pos], "Expected property name after '.'");
+            const Token& name = tokens[pos++];
+            if (match(tokens, pos, TokenType::LEFT_PAREN)) {
+                size_t base = pushArguments(tokens, pos);
+                value = invokeMethod(value, name, base);
+            } else {
+                value = loadProperty(value, name);
+            }
+        } else {
+            break;
+        }
+    }
+    return value;
+}
+
+// ---- Utilities ----
+
+bool NexusInterpreter::isAtEnd(const std::vector<Token>& tokens, size_t pos) const {
+    return pos >= tokens.size() || tokens[pos].type == TokenType::EOF_TOKEN;
+}
+
+bool NexusInterpreter::check(const std::vector<Token>& tokens, size_t pos, TokenType type) const {
+    return pos < tokens.size() && tokens[pos].type == type;
+}
+
+bool NexusInterpreter::match(const std::vector<Token>& tokens, size_t& pos, TokenType type) {
+    if (!check(tokens, pos, type)) return false;
+    pos++;
+    return true;
+}
+
+bool NexusInterpreter::match(const std::vector<Token>& tokens, size_t& pos, const std::vector<TokenType>& types) {
+    for (TokenType type : types) {
+        if (match(tokens, pos, type)) return true;
+    }
+    return false;
+}
+
+Token NexusInterpreter::advance(const std::vector<Token>& tokens, size_t& pos) {
+    if (pos < tokens.size()) return tokens[pos++];
+    return tokens.empty() ? Token(TokenType::EOF_TOKEN, "") : tokens.back();
+}
+
+Token NexusInterpreter::peek(const std::vector<Token>& tokens, size_t pos) const {
+    if (pos < tokens.size()) return tokens[pos];
+    return tokens.empty() ? Token(TokenType::EOF_TOKEN, "") : tokens.back();
+}
+
+Token NexusInterpreter::previous(const std::vector<Token>& tokens, size_t pos) const {
+    return peek(tokens, pos == 0 ? 0 : pos - 1);
+}
+
+void NexusInterpreter::consume(const std::vector<Token>& tokens, size_t& pos, TokenType type,
+                               const std::string& message) {
+    if (match(tokens, pos, type)) return;
+    runtimeError(peek(tokens, pos), message);
+}
+
+void NexusInterpreter::runtimeError(const std::string& message) {
+    throw RuntimeError(message);
+}
+
+void NexusInterpreter::runtimeError(const Token& token, const std::string& message) {
+    throw RuntimeError("[line " + std::to_string(token.line) + "] " + message);
+}
+
+// ---- Environment and built-ins ----
+
+void NexusInterpreter::clearEnvironment() {
+    RuntimeContext::Scope scope(context);
+    environment = globals;
+    globals->clear();
+    models.clear();
+    accountModels();
+    imports.clear();
+    setupBuiltins();
+}
+
+void NexusInterpreter::printVariables() const {
+    globals->printVariables();
+}
+
+void NexusInterpreter::printModels() const {
+    std::cout << "Models (" << models.size() << "):" << std::endl;
+    for (const auto& [name, model] : models) {
+        std::cout << "  " << name << ": " << model->getArchitecture() << std::endl;
+    }
+}
+
+Value NexusInterpreter::callBuiltinFunction(const std::string& name, ArgSpan args) {
+    RuntimeContext::Scope scope(context);
+    Value builtin = globals->get(name);
+    if (!builtin.isCallable()) runtimeError("'" + name + "' is not a function");
+    return builtin.asCallable()->call(*this, args);
+}
+
+// ---- Models ----
+
+void NexusInterpreter::createModel(const std::string& name, const std::vector<int>& architecture) {
+    models[name] = std::make_shared<NeuralNetwork>(architecture);
+    accountModels();
+}
+
+// Compiles the model on first use and fits it when the options carry
+// 'inputs' and 'targets'; 'epochs', 'batchSize' and 'learningRate' override
+// the model's training configuration
+void NexusInterpreter::trainModel(const std::string& name, const std::map<std::string, Value>& params) {
+    auto found = models.find(name);
+    if (found == models.end()) runtimeError("Undefined model '" + name + "'");
+    NeuralNetwork& model = *found->second;
+    if (!model.isCompiled()) model.compile();
+
+    auto option = [&params](const char* key) -> const Value* {
+        auto it = params.find(key);
+        return it == params.end() ? nullptr : &it->second;
+    };
+    TrainingConfig config = model.getTrainingConfig();
+    if (const Value* epochs = option("epochs")) config.epochs = static_cast<int>(epochs->asInteger());
+    if (const Value* batchSize = option("batchSize")) config.batchSize = static_cast<int>(batchSize->asInteger());
+    if (const Value* rate = option("learningRate")) config.learningRate = rate->asNumber();
+
+    const Value* inputs = option("inputs");
+    const Value* targets = option("targets");
+    if (!inputs || !targets) return;
+    auto tensorOf = [](const Value& value) {
+        return value.isTensor() ? value.asTensor() : value.toTensor();
+    };
+    model.train(*tensorOf(*inputs), *tensorOf(*targets), config);
+    accountModels();
+}
+
+// Runs the model on input, or on a zero vector of its input width
+Value NexusInterpreter::predictModel(const std::string& name, const Value& input) {
+    auto found = models.find(name);
+    if (found == models.end()) runtimeError("Undefined model '" + name + "'");
+    NeuralNetwork& model = *found->second;
+
+    if (input.isNil()) {
+        std::vector<size_t> sizes = model.getLayerSizes();
+        Tensor zeros(std::vector<size_t>{1, sizes.empty() ? size_t(0) : sizes.front()});
+        return Value(model.predict(zeros));
+    }
+    std::shared_ptr<Tensor> tensor = input.isTensor() ? input.asTensor() : input.toTensor();
+    return Value(model.predict(*tensor));
+}
+
+void NexusInterpreter::saveModel(const std::string& name, const std::string& filepath) {
+    auto found = models.find(name);
+    if (found == models.end()) runtimeError("Undefined model '" + name + "'");
+    found->second->save(filepath);
+}
+
+void NexusInterpreter::loadModel(const std::string& name, const std::string& filepath) {
+    auto model = std::make_shared<NeuralNetwork>();
+    model->load(filepath);
+    models[name] = std::move(model);
+    accountModels();
+}
+
+// ---- Profiling and debugging ----
+
+void NexusInterpreter::startTimer(const std::string& name) {
+    profileTimers[name] = std::chrono::high_resolution_clock::now();
+}
+
+// Milliseconds since startTimer(name), or 0 if it was never started
+double NexusInterpreter::endTimer(const std::string& name) {
+    auto found = profileTimers.find(name);
+    if (found == profileTimers.end()) return 0.0;
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - found->second;
+    profileTimers.erase(found);
+    return elapsed.count();
+}
+
+void NexusInterpreter::debugPrint(const std::string& message) const {
+    if (debugMode) std::cout << "[debug] " << message << std::endl;
+}
+
+void NexusInterpreter::debugPrintTokens(const std::vector<Token>& tokens) const {
+    if (!debugMode) return;
+    for (const Token& token : tokens) std::cout << "[debug] " << token << std::endl;
+}
+
+void NexusInterpreter::debugPrintEnvironment() const {
+    if (debugMode) environment->printAllScopes();
+}
@@ -3,19 +3,91 @@
 #include "lexer.h"
 #include "parser.h"
 #include "enviorment.h"
+#include "function.h"
+#include "gc.h"
+#include "inline_cache.h"
+#include "runtime_context.h"
+#include "snapshot.h"
+#include "value_stack.h"
 #include "ml/neural_network.h"
 #include <memory>
 #include <map>
+#include <unordered_map>
 #include <chrono>
+#include <unordered_set>
 
+// Error raised by a running script: a failed operation, or 'throw value'.
+// A script's catch clause receives the thrown value; for other errors,
+// including the host's (HeapLimitError, NativeArgumentError, ...), it
+// receives the message.
+class RuntimeError : public std::exception {
+private:
+    std::string message;
+    Value thrown;
+
+public:
+    explicit RuntimeError(const std::string& msg, Value value = Value())
+        : message(msg), thrown(std::move(value)) {}
+    const char* what() const noexcept override { return message.c_str(); }
+    const Value& getValue() const { return thrown; }
+};
+
+// Interpreters are independent: each owns its RuntimeContext and installs it
+// (RuntimeContext::Scope) for the duration of every public entry point, so
+// separate instances can run on separate threads concurrently.
+//
+// Values handed out (evaluateExpression, RuntimeError::getValue) belong to
+// the interpreter that made them: their payloads hold raw pointers to its
+// HeapAccount and shapes, which they credit and read until they die. Drop
+// every such Value before the interpreter is destroyed; one that outlives
+// it is a use-after-free.
 class NexusInterpreter {
 private:
+    RuntimeContext context;  // Declared first: globals and shapes live in it
     std::shared_ptr<Environment> globals;
     std::shared_ptr<Environment> environment;
+    std::shared_ptr<const std::vector<Token>> program;  // Top-level code being run
+    std::unordered_set<std::string> imports;            // Files imported so far
     std::map<std::string, std::shared_ptr<NeuralNetwork>> models;
     std::map<std::string, std::chrono::time_point<std::chrono::high_resolution_clock>> profileTimers;
     bool debugMode;
     bool profilingMode;
+    bool gcStatsMode = false;
+    bool memoryStatsMode = false;
+    
+    // Collects closure/environment cycles; functions are tracked in makeFunction
+    GarbageCollector collector;
+    
+    // Function call state. Locals of running functions live in slot windows
+    // on valueStack; captured ones in cellStack.
+    ValueStack valueStack;
+    std::vector<CallFrame> frames;
+    std::vector<std::shared_ptr<UpvalueCell>> cellStack;
+    TailCall pendingTailCall;
+    Value returnValue;
+    bool returning = false;
+    bool breaking = false;
+    bool continuing = false;
+    int callDepth = 0;
+    int loopDepth = 0;  // Loops and try blocks open in the running function
+    int tryDepth = 0;
+    
+    // Per-site state, keyed by Token::site: copies of a token share their
+    // entry, and interpreters sharing a token stream each keep their own.
+    // Node-based maps, so references stay valid as sites are added.
+    std::unordered_map<uint64_t, std::shared_ptr<const FrameLayout>> frameLayouts;  // Top-level body '{'
+    std::unordered_map<uint64_t, PropertyCache> propertyCaches;
+    
+    // Global variable sites. An entry is valid for the innermost scope it
+    // was resolved from, at that scope's and the globals' versions.
+    struct GlobalCache {
+        const Environment* scope = nullptr;
+        uint64_t scopeVersion = 0;
+        uint64_t globalsVersion = 0;
+        Value* cell = nullptr;  // Null when the name is shadowed or not global
+        bool constant = false;
+    };
+    std::unordered_map<uint64_t, GlobalCache> globalCaches;
     
 public:
     NexusInterpreter();
@@ -24,22 +96,73 @@ public:
     // Core execution methods
     void execute(const std::string& source);
     void executeFile(const std::string& filename);
-    Value evaluateExpression(const std::string& expression);
+    Value evaluateExpression(const std::string& expression);  // Must not outlive *this
     
     // Environment management
+    RuntimeContext& getContext() { return context; }
     void clearEnvironment();
     void printVariables() const;
     void printModels() const;
     
+    // Checkpoints of the global state (REPL :undo, what-if branches)
+    std::shared_ptr<const InterpreterSnapshot> snapshot() const;
+    void restore(const InterpreterSnapshot& image);
+    std::unique_ptr<NexusInterpreter> fork(const InterpreterSnapshot& image) const;
+    
     // Configuration
     void enableDebug() { debugMode = true; }
     void disableDebug() { debugMode = false; }
     void enableProfiling() { profilingMode = true; }
     void disableProfiling() { profilingMode = false; }
+    void enableGcStats() { gcStatsMode = true; }
+    void enableMemoryStats() { memoryStatsMode = true; }
+    void setGcMaxPause(double ms) { collector.setMaxPause(ms); }  // 0 = unbounded
+    
+    // Garbage collection
+    void collectGarbage() { collector.collectMajor(); }
+    const GcStats& getGcStats() const { return collector.getStats(); }
+    void printGcStats(std::ostream& out) const {
+        collector.printStats(out);
+        TensorMemory::printStats(out);
+        ScratchArena::printStats(out);
+    }
+    
+    // Statistics asked for on the command line (--gc-stats, --memory-stats),
+    // printed by execute once a top-level run has finished
+    void printRunReport(std::ostream& out) const {
+        if (gcStatsMode) printGcStats(out);
+        if (memoryStatsMode) printMemoryStats(out);
+    }
+    
+    // Memory accounting. Past the limit, allocations raise HeapLimitError
+    // as a script error. Payloads, and the buffers of builtin objects, are
+    // charged while this interpreter's context is installed on the thread,
+    // which every public entry point does.
+    void setMaxHeap(size_t bytes) { context.getHeapAccount().setLimit(bytes); }  // 0 = unlimited
+    const HeapAccount& getHeapAccount() const { return context.getHeapAccount(); }
+    void printMemoryStats(std::ostream& out) const { context.getHeapAccount().printReport(out); }
     
     // Built-in functions
     void setupBuiltins();
-    Value callBuiltinFunction(const std::string& name, const std::vector<Value>& args);
+    Value callBuiltinFunction(const std::string& name, ArgSpan args);
+    
+    // Function calls
+    Value invokeFunction(NexusFunction& function, ArgSpan arguments);
+    Value callValue(const Value& callee, size_t argBase);
+    std::shared_ptr<NexusFunction> makeFunction(const std::string& name,
+                                                const std::vector<std::string>& parameters,
+                                                std::shared_ptr<const std::vector<Token>> tokens,
+                                                size_t bodyStart);
+    
+    // Variable access: frame slots and upvalues first, then the environment
+    Value lookupVariable(const Token& name);
+    void assignVariable(const Token& name, Value value);
+    void defineVariable(const Token& name, Value value);
+    
+    // Property access through the site's inline cache
+    Value loadProperty(const Value& object, const Token& name);
+    void storeProperty(Value& object, const Token& name, Value value);
+    Value invokeMethod(const Value& receiver, const Token& name, size_t argBase);
     
     // ML operations
     void createModel(const std::string& name, const std::vector<int>& architecture);
@@ -51,33 +174,63 @@ public:
     // Profiling
     void startTimer(const std::string& name);
     double endTimer(const std::string& name);
+    InlineCacheStats getInlineCacheStats() const;
+    void printProfile() const;  // Printed after a top-level run in profilingMode
     
 private:
-    // Statement execution
+    // Statement execution. Every statement, and every loop iteration, runs
+    // inside a ScratchArena::Statement, so its expression temporaries are
+    // rewound together when it ends.
     void executeStatements(const std::vector<Token>& tokens);
     size_t executeStatement(const std::vector<Token>& tokens, size_t start);
     size_t executeVariableDeclaration(const std::vector<Token>& tokens, size_t start);
+    size_t executeFunctionDeclaration(const std::vector<Token>& tokens, size_t start);
     size_t executeAssignment(const std::vector<Token>& tokens, size_t start);
     size_t executeIfStatement(const std::vector<Token>& tokens, size_t start);
     size_t executeWhileStatement(const std::vector<Token>& tokens, size_t start);
     size_t executeForStatement(const std::vector<Token>& tokens, size_t start);
+    size_t executeForEach(const std::vector<Token>& tokens, size_t bodyStart,
+                          const Token& variable, const Value& iterable);
     size_t executeModelDeclaration(const std::vector<Token>& tokens, size_t start);
     size_t executeTrainStatement(const std::vector<Token>& tokens, size_t start);
     size_t executeExpressionStatement(const std::vector<Token>& tokens, size_t start);
     size_t executeReturnStatement(const std::vector<Token>& tokens, size_t start);
     size_t executeImportStatement(const std::vector<Token>& tokens, size_t start);
+    size_t executeTryStatement(const std::vector<Token>& tokens, size_t start);
+    bool interrupted() const { return returning || breaking || continuing; }
+    
+    // Tail calls (function.cpp), taken by executeReturnStatement
+    size_t executeTailCall(const std::vector<Token>& tokens, size_t start);
+    bool isTailCall(const std::vector<Token>& tokens, size_t start) const;
     
     // Expression evaluation
     Value evaluateExpression(const std::vector<Token>& tokens, size_t& pos);
     Value evaluateLogicalOr(const std::vector<Token>& tokens, size_t& pos);
     Value evaluateLogicalAnd(const std::vector<Token>& tokens, size_t& pos);
+    Value evaluateBitwise(const std::vector<Token>& tokens, size_t& pos, int level = 0);
     Value evaluateEquality(const std::vector<Token>& tokens, size_t& pos);
     Value evaluateComparison(const std::vector<Token>& tokens, size_t& pos);
+    Value evaluateShift(const std::vector<Token>& tokens, size_t& pos);
     Value evaluateTerm(const std::vector<Token>& tokens, size_t& pos);
     Value evaluateFactor(const std::vector<Token>& tokens, size_t& pos);
     Value evaluateUnary(const std::vector<Token>& tokens, size_t& pos);
     Value evaluatePrimary(const std::vector<Token>& tokens, size_t& pos);
     Value evaluateCall(const std::vector<Token>& tokens, size_t& pos, Value callee);
+    size_t pushArguments(const std::vector<Token>& tokens, size_t& pos);
+    Value evaluateUpdate(const std::vector<Token>& tokens, size_t& pos, const std::string& target);
+    Value updateVariable(const Token& name, TokenType op, const Value& operand);
+    static Value applyOperator(Value&& left, TokenType op, const Value& right);
+    
+    // Assignment through '.name' and '[index]' accessors
+    Value* variableStorage(const Token& name);
+    void storeThrough(Value& container, const std::vector<Token>& tokens, size_t pos, size_t end,
+                      size_t keyIndex, Value value);
+    Value loadThrough(Value container, const std::vector<Token>& tokens, size_t pos, size_t end,
+                      size_t keyIndex);
+    
+    // Token streams
+    std::shared_ptr<const std::vector<Token>> tokenize(const std::string& source) const;
+    std::shared_ptr<const std::vector<Token>> shareTokens(const std::vector<Token>& tokens) const;
     
     // Utility methods
     bool isAtEnd(const std::vector<Token>& tokens, size_t pos) const;
@@ -89,6 +242,19 @@ private:
     Token previous(const std::vector<Token>& tokens, size_t pos) const;
     void consume(const std::vector<Token>& tokens, size_t& pos, TokenType type, const std::string& message);
     
+    // Inline cache sites
+    PropertyCache& cacheFor(const Token& site);
+    
+    // Charges the model table's parameters; called whenever it changes
+    void accountModels();
+    
+    // Frames. Both touch the cell or scope they hand out (the collector's
+    // barrier), as touchOwner does for names found through the scope chain.
+    Value* resolveLocal(const Token& name);
+    Value* globalCell(const Token& name, bool forWrite = false);
+    void touchOwner(const std::string& name);
+    void popFrame(size_t slotBase, size_t cellBase);
+    
     // Block execution
     size_t executeBlock(const std::vector<Token>& tokens, size_t start);
     size_t findBlockEnd(const std::vector<Token>& tokens, size_t start);
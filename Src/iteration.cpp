@@ -0,0 +1,43 @@
+#include "interpreter.h"
+
+// Runs 'for (variable in iterable) { ... }' once executeForStatement has
+// parsed the header. Elements are borrowed from the iterable, which stays
+// pinned for the whole loop: a body that mutates the container detaches its
+// own copy (copy-on-write) rather than invalidating the iteration. Inside a
+// function the loop variable is a frame slot, or a fresh cell per step when a
+// closure captures it; at top level it gets one scope for the whole loop. It
+// is cleared after each step (a captured cell is replaced instead), so a row
+// view nothing else kept can be re-pointed instead of reallocated, while one
+// the body stored away is copied out of the tensor by the iterator. Each pass
+// over the body is a statement of its own for the scratch arena.
+size_t NexusInterpreter::executeForEach(const std::vector<Token>& tokens, size_t bodyStart,
+                                        const Token& variable, const Value& iterable) {
+    Value pinned = iterable;
+    size_t end = findBlockEnd(tokens, bodyStart);
+
+    std::shared_ptr<Environment> previous = environment;
+    if (!resolveLocal(variable)) {
+        environment = std::make_shared<Environment>(environment, "for");
+        environment->define(variable.value, Value());
+    }
+    try {
+        Value::Iterator last = pinned.end();
+        for (Value::Iterator it = pinned.begin(); it != last; ++it) {
+            ScratchArena::Statement statement;
+            defineVariable(variable, *it);
+            executeBlock(tokens, bodyStart);
+            defineVariable(variable, Value());
+            continuing = false;
+            if (breaking) {
+                breaking = false;
+                break;
+            }
+            if (returning) break;
+        }
+    } catch (...) {
+        environment = previous;
+        throw;
+    }
+    environment = previous;
+    return end;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
@@ -73,14 +75,21 @@ struct Token {
     int line;
     int column;
     size_t position;
+    uint64_t site;  // Unique per lexed token and kept by copies; interpreters key their caches on it
     
     Token(TokenType t, const std::string& v, int l = 0, int c = 0, size_t p = 0) 
-        : type(t), value(v), line(l), column(c), position(p) {}
+        : type(t), value(v), line(l), column(c), position(p), site(nextSite()) {}
         
     std::string toString() const;
     bool isKeyword() const;
     bool isOperator() const;
     bool isLiteral() const;
+    
+private:
+    static uint64_t nextSite() {
+        static std::atomic<uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
 };
 
 class LexerError : public std::exception {
@@ -110,14 +119,24 @@ private:
     int line;
     int column;
     
-    // Keywords map for fast lookup
-    static std::map<std::string, TokenType> keywords;
-    
     // Character classification sets
-    static std::unordered_set<char> whitespace;
-    static std::unordered_set<char> digits;
-    static std::unordered_set<char> alphaChars;
-    static std::unordered_set<char> alphaNumeric;
+    struct CharacterSets {
+        std::unordered_set<char> whitespace;
+        std::unordered_set<char> digits;
+        std::unordered_set<char> alphaChars;
+        std::unordered_set<char> alphaNumeric;
+    };
+    
+    // Read-only tables, built once on first use. Function-local statics
+    // are initialized exactly once even when lexers run on several threads.
+    static const std::map<std::string, TokenType>& keywords() {
+        static const std::map<std::string, TokenType> table = buildKeywords();
+        return table;
+    }
+    static const CharacterSets& characterSets() {
+        static const CharacterSets sets = buildCharacterSets();
+        return sets;
+    }
     
 public:
     explicit Lexer(const std::string& src);
@@ -196,9 +215,9 @@ private:
     void markTokenStart();
     std::string getCurrentLexeme() const;
     
-    // Static initialization
-    static void initializeKeywords();
-    static void initializeCharacterSets();
+    // Table construction
+    static std::map<std::string, TokenType> buildKeywords();
+    static CharacterSets buildCharacterSets();
     
 public:
     // Static utility methods
@@ -0,0 +1,276 @@
+#include "gemm.h"
+#include "../tensor_allocator.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NEXUS_GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// C[MR×NR] = (C +) a·b, where a is a packed k×MR panel (MR values per step
+// of k) and b a packed k×NR panel
+using MicroKernel = void (*)(size_t k, const double* a, const double* b, double* c, size_t ldc, bool accumulate);
+
+struct Blocking {
+    size_t mr, nr;  // Micro-tile
+    size_t mc;      // Rows of A packed at a time (L2)
+    size_t kc;      // Depth of each packed slice (panels stay in L1)
+    size_t nc;      // Columns of B packed at a time (L3)
+    MicroKernel kernel;
+};
+
+// Below this many multiply-adds packing costs more than it saves
+constexpr size_t SMALL_PRODUCT = 32 * 32 * 32;
+
+void scalarKernel(size_t k, const double* a, const double* b, double* c, size_t ldc, bool accumulate) {
+    double sum[4][4] = {};
+    for (size_t p = 0; p < k; ++p, a += 4, b += 4) {
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t j = 0; j < 4; ++j) sum[i][j] += a[i] * b[j];
+        }
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        for (size_t j = 0; j < 4; ++j) c[i * ldc + j] = accumulate ? c[i * ldc + j] + sum[i][j] : sum[i][j];
+    }
+}
+
+#ifdef NEXUS_GEMM_X86
+
+// 6 rows × 2 vectors of 4: 12 accumulators, 2 for B, 1 broadcast of 16
+__attribute__((target("avx2,fma")))
+void avx2Kernel(size_t k, const double* a, const double* b, double* c, size_t ldc, bool accumulate) {
+    __m256d sum[6][2];
+#pragma GCC unroll 6
+    for (size_t i = 0; i < 6; ++i) sum[i][0] = sum[i][1] = _mm256_setzero_pd();
+    for (size_t p = 0; p < k; ++p, a += 6, b += 8) {
+        __m256d b0 = _mm256_loadu_pd(b);
+        __m256d b1 = _mm256_loadu_pd(b + 4);
+#pragma GCC unroll 6
+        for (size_t i = 0; i < 6; ++i) {
+            __m256d ai = _mm256_broadcast_sd(a + i);
+            sum[i][0] = _mm256_fmadd_pd(ai, b0, sum[i][0]);
+            sum[i][1] = _mm256_fmadd_pd(ai, b1, sum[i][1]);
+        }
+    }
+#pragma GCC unroll 6
+    for (size_t i = 0; i < 6; ++i) {
+        double* row = c + i * ldc;
+        if (accumulate) {
+            sum[i][0] = _mm256_add_pd(sum[i][0], _mm256_loadu_pd(row));
+            sum[i][1] = _mm256_add_pd(sum[i][1], _mm256_loadu_pd(row + 4));
+        }
+        _mm256_storeu_pd(row, sum[i][0]);
+        _mm256_storeu_pd(row + 4, sum[i][1]);
+    }
+}
+
+// 12 rows × 2 vectors of 8: 24 accumulators, 2 for B, 1 broadcast of 32
+__attribute__((target("avx512f")))
+void avx512Kernel(size_t k, const double* a, const double* b, double* c, size_t ldc, bool accumulate) {
+    __m512d sum[12][2];
+#pragma GCC unroll 12
+    for (size_t i = 0; i < 12; ++i) sum[i][0] = sum[i][1] = _mm512_setzero_pd();
+    for (size_t p = 0; p < k; ++p, a += 12, b += 16) {
+        __m512d b0 = _mm512_loadu_pd(b);
+        __m512d b1 = _mm512_loadu_pd(b + 8);
+#pragma GCC unroll 12
+        for (size_t i = 0; i < 12; ++i) {
+            __m512d ai = _mm512_set1_pd(a[i]);
+            sum[i][0] = _mm512_fmadd_pd(ai, b0, sum[i][0]);
+            sum[i][1] = _mm512_fmadd_pd(ai, b1, sum[i][1]);
+        }
+    }
+#pragma GCC unroll 12
+    for (size_t i = 0; i < 12; ++i) {
+        double* row = c + i * ldc;
+        if (accumulate) {
+            sum[i][0] = _mm512_add_pd(sum[i][0], _mm512_loadu_pd(row));
+            sum[i][1] = _mm512_add_pd(sum[i][1], _mm512_loadu_pd(row + 8));
+        }
+        _mm512_storeu_pd(row, sum[i][0]);
+        _mm512_storeu_pd(row + 8, sum[i][1]);
+    }
+}
+
+#endif
+
+const Blocking& blocking(Gemm::Kernel kernel) {
+    static const Blocking scalar{4, 4, 64, 256, 2048, scalarKernel};
+#ifdef NEXUS_GEMM_X86
+    static const Blocking avx2{6, 8, 72, 256, 2048, avx2Kernel};
+    static const Blocking avx512{12, 16, 144, 192, 2048, avx512Kernel};
+    if (kernel == Gemm::Kernel::AVX512) return avx512;
+    if (kernel == Gemm::Kernel::AVX2) return avx2;
+#else
+    (void)kernel;
+#endif
+    return scalar;
+}
+
+// Rows [0, rows) of a rows×depth block of A, as MR-tall panels: for each
+// step of depth, MR consecutive values down the panel (zero past the edge)
+void packA(size_t rows, size_t depth, const double* a, size_t lda, size_t mr, double* packed) {
+    for (size_t panel = 0; panel < rows; panel += mr) {
+        size_t height = std::min(mr, rows - panel);
+        const double* source = a + panel * lda;
+        for (size_t p = 0; p < depth; ++p) {
+            for (size_t i = 0; i < height; ++i) packed[i] = source[i * lda + p];
+            for (size_t i = height; i < mr; ++i) packed[i] = 0.0;
+            packed += mr;
+        }
+    }
+}
+
+// Columns [0, columns) of a depth×columns block of B, as NR-wide panels
+void packB(size_t depth, size_t columns, const double* b, size_t ldb, size_t nr, double* packed) {
+    for (size_t panel = 0; panel < columns; panel += nr) {
+        size_t width = std::min(nr, columns - panel);
+        const double* source = b + panel;
+        for (size_t p = 0; p < depth; ++p) {
+            std::memcpy(packed, source + p * ldb, width * sizeof(double));
+            for (size_t j = width; j < nr; ++j) packed[j] = 0.0;
+            packed += nr;
+        }
+    }
+}
+
+void blocked(const Blocking& block, size_t m, size_t n, size_t k, const double* a, size_t lda,
+             const double* b, size_t ldb, double* c, size_t ldc, bool accumulate) {
+    // Per thread, so forks multiply concurrently; the pooled allocator keeps
+    // them 64-byte aligned
+    thread_local TensorBuffer packedA;
+    thread_local TensorBuffer packedB;
+    size_t roundedMc = (std::min(block.mc, m) + block.mr - 1) / block.mr * block.mr;
+    size_t roundedNc = (std::min(block.nc, n) + block.nr - 1) / block.nr * block.nr;
+    size_t depth = std::min(block.kc, k);
+    if (packedA.size() < roundedMc * depth) packedA.resize(roundedMc * depth);
+    if (packedB.size() < roundedNc * depth) packedB.resize(roundedNc * depth);
+
+    alignas(64) double edge[16 * 16];  // Largest micro-tile
+    for (size_t jc = 0; jc < n; jc += block.nc) {
+        size_t columns = std::min(block.nc, n - jc);
+        for (size_t pc = 0; pc < k; pc += block.kc) {
+            size_t slice = std::min(block.kc, k - pc);
+            bool add = accumulate || pc > 0;
+            packB(slice, columns, b + pc * ldb + jc, ldb, block.nr, packedB.data());
+
+            for (size_t ic = 0; ic < m; ic += block.mc) {
+                size_t rows = std::min(block.mc, m - ic);
+                packA(rows, slice, a + ic * lda + pc, lda, block.mr, packedA.data());
+
+                for (size_t jr = 0; jr < columns; jr += block.nr) {
+                    size_t width = std::min(block.nr, columns - jr);
+                    const double* panelB = packedB.data() + jr * slice;
+                    for (size_t ir = 0; ir < rows; ir += block.mr) {
+                        size_t height = std::min(block.mr, rows - ir);
+                        const double* panelA = packedA.data() + ir * slice;
+                        double* tile = c + (ic + ir) * ldc + jc + jr;
+                        if (height == block.mr && width == block.nr) {
+                            block.kernel(slice, panelA, panelB, tile, ldc, add);
+                            continue;
+                        }
+                        // Partial tile: compute the padded tile aside and
+                        // keep only the part inside C
+                        block.kernel(slice, panelA, panelB, edge, block.nr, false);
+                        for (size_t i = 0; i < height; ++i) {
+                            for (size_t j = 0; j < width; ++j) {
+                                double value = edge[i * block.nr + j];
+                                tile[i * ldc + j] = add ? tile[i * ldc + j] + value : value;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// i-p-j order: the inner loop runs along rows of B and C
+void small(size_t m, size_t n, size_t k, const double* a, size_t lda, const double* b, size_t ldb,
+           double* c, size_t ldc, bool accumulate) {
+    for (size_t i = 0; i < m; ++i) {
+        double* row = c + i * ldc;
+        if (!accumulate) std::fill(row, row + n, 0.0);
+        for (size_t p = 0; p < k; ++p) {
+            double scale = a[i * lda + p];
+            const double* source = b + p * ldb;
+            for (size_t j = 0; j < n; ++j) row[j] += scale * source[j];
+        }
+    }
+}
+
+Gemm::Kernel detect() {
+    Gemm::Kernel best = Gemm::Kernel::SCALAR;
+    if (Gemm::supported(Gemm::Kernel::AVX512)) best = Gemm::Kernel::AVX512;
+    else if (Gemm::supported(Gemm::Kernel::AVX2)) best = Gemm::Kernel::AVX2;
+
+    if (const char* cap = std::getenv("NEXUS_GEMM")) {
+        std::string name = cap;
+        if (name == "scalar") best = Gemm::Kernel::SCALAR;
+        else if (name == "avx2" && best == Gemm::Kernel::AVX512) best = Gemm::Kernel::AVX2;
+    }
+    return best;
+}
+
+std::atomic<Gemm::Kernel>& current() {
+    static std::atomic<Gemm::Kernel> kernel{detect()};
+    return kernel;
+}
+
+} // namespace
+
+void Gemm::multiply(size_t m, size_t n, size_t k, const double* a, size_t lda, const double* b, size_t ldb,
+                    double* c, size_t ldc, bool accumulate) {
+    if (m == 0 || n == 0) return;
+    if (k == 0) {
+        if (!accumulate) {
+            for (size_t i = 0; i < m; ++i) std::fill(c + i * ldc, c + i * ldc + n, 0.0);
+        }
+        return;
+    }
+    if (m * n * k < SMALL_PRODUCT) {
+        small(m, n, k, a, lda, b, ldb, c, ldc, accumulate);
+        return;
+    }
+    blocked(blocking(selected()), m, n, k, a, lda, b, ldb, c, ldc, accumulate);
+}
+
+Gemm::Kernel Gemm::selected() {
+    return current().load(std::memory_order_relaxed);
+}
+
+bool Gemm::supported(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::SCALAR:
+            return true;
+#ifdef NEXUS_GEMM_X86
+        case Kernel::AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case Kernel::AVX512:
+            return __builtin_cpu_supports("avx512f");
+#else
+        default:
+            return false;
+#endif
+    }
+    return false;
+}
+
+void Gemm::select(Kernel kernel) {
+    if (supported(kernel)) current().store(kernel, std::memory_order_relaxed);
+}
+
+const char* Gemm::name(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::SCALAR: return "scalar";
+        case Kernel::AVX2: return "avx2";
+        case Kernel::AVX512: return "avx512";
+    }
+    return "scalar";
+}
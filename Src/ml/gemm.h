@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Dense double-precision matrix product C = A·B (or C += A·B), row-major
+// with explicit leading dimensions, the kernel behind Tensor::matmul and
+// the dense layers.
+//
+// Large products are blocked the usual way for the cache hierarchy: a
+// KC-deep slice of B is packed into NR-wide column panels that stay in L3,
+// an MC-row block of A is packed into MR-tall row panels that stay in L2,
+// and a register-resident MR×NR micro-kernel streams one panel of each
+// through L1. Edge tiles are padded with zeros while packing, so the
+// micro-kernel never branches on shape. Products too small to repay the
+// packing take a plain loop instead.
+//
+// The micro-kernel is chosen once per process from what the CPU supports:
+// AVX-512 (12×16), AVX2 with FMA (6×8), or portable scalar code (4×4).
+// NEXUS_GEMM=scalar|avx2|avx512 caps the choice.
+class Gemm {
+public:
+    enum class Kernel : uint8_t { SCALAR, AVX2, AVX512 };
+
+    static void multiply(size_t m, size_t n, size_t k,
+                         const double* a, size_t lda,
+                         const double* b, size_t ldb,
+                         double* c, size_t ldc,
+                         bool accumulate = false);
+
+    static Kernel selected();
+    static bool supported(Kernel kernel);
+    static void select(Kernel kernel);  // Ignored unless supported
+    static const char* name(Kernel kernel);
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "value.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+class NativeArgumentError : public std::exception {
+private:
+    std::string message;
+
+public:
+    explicit NativeArgumentError(const std::string& msg) : message(msg) {}
+    const char* what() const noexcept override { return message.c_str(); }
+};
+
+// Conversion from a script Value to a C++ parameter type
+template<typename T, typename Enable = void>
+struct NativeArg;
+
+template<>
+struct NativeArg<Value> {
+    static constexpr const char* typeName = "any";
+    static bool accepts(const Value&) { return true; }
+    static const Value& get(const Value& value) { return value; }
+};
+
+template<>
+struct NativeArg<bool> {
+    static constexpr const char* typeName = "boolean";
+    static bool accepts(const Value& value) { return value.isBoolean(); }
+    static bool get(const Value& value) { return value.asBool(); }
+};
+
+template<typename T>
+struct NativeArg<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+    static constexpr const char* typeName = "number";
+    static bool accepts(const Value& value) { return value.isNumber(); }
+    static T get(const Value& value) { return static_cast<T>(value.asNumber()); }
+};
+
+template<typename T>
+struct NativeArg<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+    static constexpr const char* typeName = "integer";
+    static bool accepts(const Value& value) { return value.isNumber(); }
+    static T get(const Value& value) { return static_cast<T>(value.asInteger()); }
+};
+
+template<>
+struct NativeArg<std::string> {
+    static constexpr const char* typeName = "string";
+    static bool accepts(const Value& value) { return value.isString(); }
+    static std::string get(const Value& value) { return value.asString(); }
+};
+
+template<>
+struct NativeArg<std::shared_ptr<Tensor>> {
+    static constexpr const char* typeName = "tensor";
+    static bool accepts(const Value& value) { return value.isTensor(); }
+    static std::shared_ptr<Tensor> get(const Value& value) { return value.asTensor(); }
+};
+
+// Conversion from a C++ return type back to a script Value
+template<typename T, typename Enable = void>
+struct NativeResult {
+    static Value make(T&& result) { return Value(std::forward<T>(result)); }
+};
+
+template<typename T>
+struct NativeResult<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+    static Value make(T result) { return Value(static_cast<double>(result)); }
+};
+
+template<typename T>
+struct NativeResult<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+    static Value make(T result) { return Value(static_cast<int64_t>(result)); }
+};
+
+// Signature of a bindable function. A leading NexusInterpreter& is supplied
+// by the binding; a single ArgSpan parameter makes the function variadic.
+template<typename F>
+struct NativeSignature;
+
+template<typename R, typename... Args>
+struct NativeSignature<R (*)(Args...)> {
+    using Result = R;
+    using Params = std::tuple<std::decay_t<Args>...>;
+    static constexpr bool takesInterpreter = false;
+    static constexpr bool variadic =
+        sizeof...(Args) == 1 && (std::is_same_v<std::decay_t<Args>, ArgSpan> && ...);
+    static constexpr size_t arity = variadic ? 0 : sizeof...(Args);
+};
+
+template<typename R, typename... Args>
+struct NativeSignature<R (*)(NexusInterpreter&, Args...)> : NativeSignature<R (*)(Args...)> {
+    static constexpr bool takesInterpreter = true;
+};
+
+// Callable generated for a C++ function known at compile time. The call is
+// direct (no std::function) and argument checks are unrolled per parameter.
+template<auto Fn>
+class BoundNative final : public Callable {
+private:
+    using Signature = NativeSignature<decltype(Fn)>;
+    using Result = typename Signature::Result;
+    using Params = typename Signature::Params;
+
+    std::string name;
+
+public:
+    explicit BoundNative(const std::string& n) : name(n) {}
+
+    Value call(NexusInterpreter& interpreter, ArgSpan arguments) override {
+        if constexpr (Signature::variadic) {
+            return invoke(interpreter, arguments);
+        } else {
+            if (arguments.size() != Signature::arity) {
+                throw NativeArgumentError(name + "() expects " + std::to_string(Signature::arity) +
+                                          " arguments but got " + std::to_string(arguments.size()));
+            }
+            return invokeTyped(interpreter, arguments, std::make_index_sequence<Signature::arity>());
+        }
+    }
+
+    std::string toString() const override { return "<native fn " + name + ">"; }
+    size_t arity() const override { return Signature::arity; }
+
+private:
+    template<typename... Args>
+    Value invoke(NexusInterpreter& interpreter, Args&&... args) {
+        if constexpr (Signature::takesInterpreter) {
+            return finish([&] { return Fn(interpreter, std::forward<Args>(args)...); });
+        } else {
+            (void)interpreter;
+            return finish([&] { return Fn(std::forward<Args>(args)...); });
+        }
+    }
+
+    template<size_t... I>
+    Value invokeTyped(NexusInterpreter& interpreter, [[maybe_unused]] ArgSpan arguments,
+                      std::index_sequence<I...>) {
+        (checkArgument<I>(arguments[I]), ...);
+        return invoke(interpreter, NativeArg<std::tuple_element_t<I, Params>>::get(arguments[I])...);
+    }
+
+    template<size_t I>
+    void checkArgument(const Value& argument) const {
+        using Converter = NativeArg<std::tuple_element_t<I, Params>>;
+        if (!Converter::accepts(argument)) {
+            throw NativeArgumentError(name + "() expects argument " + std::to_string(I + 1) +
+                                      " to be " + Converter::typeName + ", got " +
+                                      argument.getTypeString());
+        }
+    }
+
+    template<typename Thunk>
+    static Value finish(Thunk&& thunk) {
+        if constexpr (std::is_void_v<Result>) {
+            thunk();
+            return Value();
+        } else if constexpr (std::is_same_v<Result, Value>) {
+            return thunk();
+        } else {
+            return NativeResult<Result>::make(thunk());
+        }
+    }
+};
+
+// Registers a C++ function as a builtin, deriving arity and conversions from
+// its signature: globals->define("sqrt", bindNative<&nativeSqrt>("sqrt"));
+template<auto Fn>
+std::shared_ptr<Callable> bindNative(const std::string& name) {
+    return std::make_shared<BoundNative<Fn>>(name);
+}
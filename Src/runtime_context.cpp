@@ -0,0 +1,64 @@
+#include "runtime_context.h"
+#include <iostream>
+
+namespace {
+
+thread_local RuntimeContext* activeContext = nullptr;
+
+} // namespace
+
+RuntimeContext::RuntimeContext() : globalEnv(std::make_shared<Environment>()) {}
+
+RuntimeContext& RuntimeContext::current() {
+    if (activeContext) return *activeContext;
+    thread_local RuntimeContext threadDefault;
+    return threadDefault;
+}
+
+RuntimeContext* RuntimeContext::installed() { return activeContext; }
+
+RuntimeContext::Scope::Scope(RuntimeContext& context) : previous(activeContext) {
+    activeContext = &context;
+}
+
+RuntimeContext::Scope::~Scope() { activeContext = previous; }
+
+void RuntimeContext::resetGlobal() {
+    globalEnv = std::make_shared<Environment>();
+    environmentStack.clear();
+}
+
+std::shared_ptr<Environment> RuntimeContext::popEnvironment() {
+    if (environmentStack.empty()) return nullptr;
+    std::shared_ptr<Environment> top = std::move(environmentStack.back());
+    environmentStack.pop_back();
+    return top;
+}
+
+std::shared_ptr<Environment> RuntimeContext::getCurrentEnvironment() const {
+    return environmentStack.empty() ? globalEnv : environmentStack.back();
+}
+
+void RuntimeContext::clear() {
+    environmentStack.clear();
+    globalEnv->clear();
+}
+
+void RuntimeContext::printStack() const {
+    std::cout << "Environment stack (" << environmentStack.size() << "):" << std::endl;
+    for (size_t i = environmentStack.size(); i-- > 0;) {
+        std::cout << "  [" << i << "] " << environmentStack[i]->getScopeName() << std::endl;
+    }
+    std::cout << "  [global] " << globalEnv->getScopeName() << std::endl;
+}
+
+// GlobalEnvironmentManager forwards to the thread's current context
+std::shared_ptr<Environment> GlobalEnvironmentManager::getGlobal() { return RuntimeContext::current().getGlobal(); }
+void GlobalEnvironmentManager::setGlobal(std::shared_ptr<Environment> env) { RuntimeContext::current().setGlobal(std::move(env)); }
+void GlobalEnvironmentManager::resetGlobal() { RuntimeContext::current().resetGlobal(); }
+void GlobalEnvironmentManager::pushEnvironment(std::shared_ptr<Environment> env) { RuntimeContext::current().pushEnvironment(std::move(env)); }
+std::shared_ptr<Environment> GlobalEnvironmentManager::popEnvironment() { return RuntimeContext::current().popEnvironment(); }
+std::shared_ptr<Environment> GlobalEnvironmentManager::getCurrentEnvironment() { return RuntimeContext::current().getCurrentEnvironment(); }
+size_t GlobalEnvironmentManager::getStackDepth() { return RuntimeContext::current().getStackDepth(); }
+void GlobalEnvironmentManager::clearAll() { RuntimeContext::current().clear(); }
+void GlobalEnvironmentManager::printStack() { RuntimeContext::current().printStack(); }
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "enviorment.h"
+#include "heap_account.h"
+#include "shape.h"
+#include <memory>
+#include <vector>
+
+// Mutable runtime state that used to be process-wide: the global environment
+// and environment stack (formerly GlobalEnvironmentManager statics) and the
+// root of the shape tree. Each NexusInterpreter owns a context and installs
+// it on the executing thread with a Scope, so N interpreters on N threads
+// share nothing mutable. Values (and the shapes they point at) belong to the
+// context that created them and must not outlive it or cross threads.
+class RuntimeContext {
+private:
+    HeapAccount heapAccount;  // Declared first: payloads credit it as they die
+    std::shared_ptr<Environment> globalEnv;
+    std::vector<std::shared_ptr<Environment>> environmentStack;
+    Shape rootShape;
+
+public:
+    RuntimeContext();
+    RuntimeContext(const RuntimeContext&) = delete;
+    RuntimeContext& operator=(const RuntimeContext&) = delete;
+
+    // Context installed on this thread, or the thread's own default one
+    static RuntimeContext& current();
+    // Context installed on this thread, or null
+    static RuntimeContext* installed();
+
+    // Installs a context on the current thread for the enclosing block
+    class Scope {
+    private:
+        RuntimeContext* previous;
+
+    public:
+        explicit Scope(RuntimeContext& context);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // Global environment
+    std::shared_ptr<Environment> getGlobal() const { return globalEnv; }
+    void setGlobal(std::shared_ptr<Environment> env) { globalEnv = std::move(env); }
+    void resetGlobal();
+
+    // Environment stack
+    void pushEnvironment(std::shared_ptr<Environment> env) { environmentStack.push_back(std::move(env)); }
+    std::shared_ptr<Environment> popEnvironment();
+    std::shared_ptr<Environment> getCurrentEnvironment() const;
+    size_t getStackDepth() const { return environmentStack.size(); }
+    void clear();
+    void printStack() const;
+
+    // Shape tree of objects created under this context
+    Shape* getRootShape() { return &rootShape; }
+
+    // Memory held by values created under this context
+    HeapAccount& getHeapAccount() { return heapAccount; }
+    const HeapAccount& getHeapAccount() const { return heapAccount; }
+};
@@ -0,0 +1,225 @@
+#include "scratch_arena.h"
+#include <algorithm>
+#include <new>
+#include <vector>
+
+namespace {
+
+struct Chunk {
+    size_t live = 0;  // Objects allocated here and not yet released
+    char* cursor;
+    char* end;
+};
+
+// Every block is preceded by the chunk it came from (null for heap blocks);
+// 16 bytes keep the payload aligned like operator new's
+struct alignas(16) BlockHeader {
+    Chunk* chunk;
+};
+
+constexpr size_t HEADER_BYTES = sizeof(BlockHeader);
+
+char* chunkStart(Chunk* chunk) {
+    return reinterpret_cast<char*>(chunk) + ((sizeof(Chunk) + 15) & ~size_t(15));
+}
+
+void rewind(Chunk* chunk) {
+    chunk->cursor = chunkStart(chunk);
+}
+
+Chunk* newChunk() {
+    void* memory = ::operator new(ScratchArena::CHUNK_BYTES);
+    Chunk* chunk = new (memory) Chunk;
+    rewind(chunk);
+    chunk->end = static_cast<char*>(memory) + ScratchArena::CHUNK_BYTES;
+    return chunk;
+}
+
+void freeChunk(Chunk* chunk) {
+    chunk->~Chunk();
+    ::operator delete(static_cast<void*>(chunk));
+}
+
+// Start of an open statement's allocations in the current chunk, with the
+// number of them still alive (escaped children of closed statements
+// included)
+struct Mark {
+    char* cursor;
+    size_t live;
+};
+
+// Set once the thread's arena has been destroyed; chunks that still hold
+// objects then free themselves when their last object goes
+thread_local bool arenaGone = false;
+
+// Open ScratchArena::Bypass scopes on this thread
+thread_local unsigned bypassDepth = 0;
+
+struct Arena {
+    Chunk* current = nullptr;
+    std::vector<Chunk*> spare;  // Empty chunks ready for reuse
+    std::vector<Mark> marks;    // One per open statement, innermost last
+    size_t firstMark = 0;       // marks[firstMark..] point into the current chunk
+    ScratchArenaStats stats;
+
+    // Next chunk to bump into. The current one is abandoned to its live
+    // objects, and with it the marks of the open statements; null when that
+    // would pin more than MAX_PINNED_CHUNKS.
+    Chunk* advance() {
+        if (current && current->live == 0) {
+            firstMark = marks.size();
+            rewind(current);
+            return current;
+        }
+        if (current && stats.pinnedChunks >= ScratchArena::MAX_PINNED_CHUNKS) return nullptr;
+        firstMark = marks.size();
+        if (current) stats.pinnedChunks++;
+        current = nullptr;
+        if (!spare.empty()) {
+            current = spare.back();
+            spare.pop_back();
+        } else {
+            current = newChunk();
+            stats.chunks++;
+        }
+        return current;
+    }
+
+    // A pinned chunk whose last object died
+    void recycle(Chunk* chunk) {
+        stats.pinnedChunks--;
+        if (spare.size() + 1 < ScratchArena::MAX_CHUNKS) {
+            rewind(chunk);
+            spare.push_back(chunk);
+        } else {
+            freeChunk(chunk);
+            stats.chunks--;
+        }
+    }
+
+    // Innermost statement whose allocations in the current chunk include
+    // the block, if any
+    Mark* owner(const void* block) {
+        auto first = marks.begin() + firstMark;
+        auto found = std::upper_bound(first, marks.end(), static_cast<const char*>(block),
+                                      [](const char* address, const Mark& mark) { return address < mark.cursor; });
+        return found == first ? nullptr : &*(found - 1);
+    }
+
+    ~Arena() {
+        for (Chunk* chunk : spare) freeChunk(chunk);
+        if (current && current->live == 0) freeChunk(current);
+        arenaGone = true;
+    }
+};
+
+thread_local Arena arena;
+
+void* heapBlock(size_t bytes) {
+    auto header = static_cast<BlockHeader*>(::operator new(HEADER_BYTES + bytes));
+    header->chunk = nullptr;
+    if (!arenaGone) arena.stats.heapObjects++;
+    return header + 1;
+}
+
+} // namespace
+
+void* ScratchArena::allocate(size_t bytes) {
+    size_t size = HEADER_BYTES + ((bytes + 15) & ~size_t(15));
+    if (arenaGone || bypassDepth > 0 || arena.marks.empty() || size > HEADER_BYTES + MAX_OBJECT_BYTES) {
+        return heapBlock(bytes);
+    }
+
+    Chunk* chunk = arena.current;
+    if (!chunk || static_cast<size_t>(chunk->end - chunk->cursor) < size) {
+        try {
+            chunk = arena.advance();
+        } catch (const std::bad_alloc&) {
+            return heapBlock(bytes);
+        }
+        if (!chunk) return heapBlock(bytes);
+    }
+    auto header = reinterpret_cast<BlockHeader*>(chunk->cursor);
+    chunk->cursor += size;
+    chunk->live++;
+    if (arena.firstMark < arena.marks.size()) arena.marks.back().live++;
+    header->chunk = chunk;
+    arena.stats.arenaObjects++;
+    return header + 1;
+}
+
+void ScratchArena::release(void* block) noexcept {
+    if (!block) return;
+    BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+    Chunk* chunk = header->chunk;
+    if (!chunk) {
+        ::operator delete(static_cast<void*>(header));
+        return;
+    }
+    chunk->live--;
+    if (arenaGone) {
+        if (chunk->live == 0) freeChunk(chunk);
+    } else if (chunk == arena.current) {
+        if (Mark* mark = arena.owner(header)) mark->live--;
+    } else if (chunk->live == 0) {
+        try {
+            arena.recycle(chunk);
+        } catch (const std::bad_alloc&) {
+            freeChunk(chunk);  // No room in the spare list
+            arena.stats.chunks--;
+        }
+    }
+}
+
+ScratchArena::Bypass::Bypass() {
+    bypassDepth++;
+}
+
+ScratchArena::Bypass::~Bypass() {
+    bypassDepth--;
+}
+
+// Statements nest (blocks, function bodies), so the marks form a stack and
+// each statement's allocations sit above its parent's in the chunk
+ScratchArena::Statement::Statement() {
+    if (arenaGone) return;
+    Chunk* chunk = arena.current;
+    arena.marks.push_back({chunk ? chunk->cursor : nullptr, 0});
+    if (!chunk) arena.firstMark = arena.marks.size();
+}
+
+// Rewinds over the statement's allocations when all of them died; escaped
+// ones are handed to the parent statement, whose region now contains them
+ScratchArena::Statement::~Statement() {
+    if (arenaGone) return;
+    Mark mark = arena.marks.back();
+    arena.marks.pop_back();
+    Chunk* chunk = arena.current;
+    if (arena.firstMark > arena.marks.size()) {
+        // The chunk changed during the statement; only a fully dead one can
+        // be rewound
+        arena.firstMark = arena.marks.size();
+        if (chunk && chunk->live == 0 && chunk->cursor != chunkStart(chunk)) {
+            rewind(chunk);
+            arena.stats.resets++;
+        }
+    } else if (mark.live == 0) {
+        if (chunk->cursor != mark.cursor) {
+            chunk->cursor = mark.cursor;
+            arena.stats.resets++;
+        }
+    } else if (arena.firstMark < arena.marks.size()) {
+        arena.marks.back().live += mark.live;
+    }
+}
+
+ScratchArenaStats ScratchArena::getStats() {
+    return arenaGone ? ScratchArenaStats() : arena.stats;
+}
+
+void ScratchArena::printStats(std::ostream& out) {
+    ScratchArenaStats stats = getStats();
+    out << "Scratch arena: " << stats.arenaObjects << " payloads from the arena, " << stats.heapObjects
+        << " from the heap, " << stats.resets << " statement resets, " << stats.chunks << " chunks of "
+        << (CHUNK_BYTES >> 10) << " KB" << std::endl;
+}
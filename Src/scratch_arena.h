@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+
+// Counters reported with --gc-stats
+struct ScratchArenaStats {
+    size_t arenaObjects = 0;  // Payloads bump-allocated inside a statement
+    size_t heapObjects = 0;   // Payloads that went to the system allocator
+    size_t resets = 0;        // Statement ends that rewound the arena
+    size_t chunks = 0;        // Chunks currently allocated
+    size_t pinnedChunks = 0;  // Of those, abandoned to payloads that escaped
+};
+
+// Per-thread scratch arena for heap payloads (strings, arrays, boxed
+// integers, ...) created while a statement runs. Most of them are the
+// temporaries of an expression, such as 'a * b' in 'a * b + c * d', and die
+// before the statement ends; bump-allocating them and rewinding the arena at
+// the statement boundary replaces a malloc/free pair per temporary.
+//
+// Escape is decided by the reference counts rather than by analysing the
+// code: every chunk counts the objects still alive in it, and a statement
+// boundary only rewinds the current chunk once that count is zero, i.e. once
+// nothing allocated there was stored anywhere. A chunk holding an object that
+// escaped is set aside, owned by its live objects, and reused when the last
+// of them dies. Pinned chunks do not count against MAX_CHUNKS, which bounds
+// the empty chunks the arena keeps. They are capped by MAX_PINNED_CHUNKS
+// instead: a loop that keeps one small value per iteration would otherwise
+// pin a whole chunk for each few of them. At the cap, allocations that do
+// not fit the current chunk go to the heap until a pinned chunk is freed or
+// the current one empties. Outside any statement (builtin setup,
+// deserialization at load) payloads come from the heap.
+//
+// Statements are opened by the executor: executeStatement wraps every
+// statement in one, and the loops wrap each iteration, so temporaries are
+// rewound while a long loop runs rather than when it ends.
+//
+// Payloads are only ever freed on the thread that created them (their
+// refcounts are not atomic), so the arena needs no locking. Code that builds
+// payloads for another thread, as fork() does, holds a Bypass so they come
+// from the heap.
+class ScratchArena {
+public:
+    static constexpr size_t CHUNK_BYTES = size_t(64) << 10;
+    static constexpr size_t MAX_OBJECT_BYTES = 512;
+    static constexpr size_t MAX_CHUNKS = 64;
+    static constexpr size_t MAX_PINNED_CHUNKS = 16;
+
+    static void* allocate(size_t bytes);
+    static void release(void* block) noexcept;
+
+    // Marks the extent of one statement on the current thread; the arena is
+    // rewound when it ends if none of the statement's payloads escaped
+    class Statement {
+    public:
+        Statement();
+        ~Statement();
+        Statement(const Statement&) = delete;
+        Statement& operator=(const Statement&) = delete;
+    };
+
+    // Sends the current thread's allocations to the heap while it lives
+    class Bypass {
+    public:
+        Bypass();
+        ~Bypass();
+        Bypass(const Bypass&) = delete;
+        Bypass& operator=(const Bypass&) = delete;
+    };
+
+    static ScratchArenaStats getStats();  // Of the calling thread
+    static void printStats(std::ostream& out);
+};
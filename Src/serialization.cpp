@@ -0,0 +1,466 @@
+#include "serialization.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr bool LITTLE_ENDIAN_HOST =
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    false;
+#else
+    true;
+#endif
+
+uint64_t littleEndian(uint64_t value) {
+    if (LITTLE_ENDIAN_HOST) return value;
+    uint64_t swapped = 0;
+    for (int i = 0; i < 8; ++i) {
+        swapped = (swapped << 8) | (value & 0xFF);
+        value >>= 8;
+    }
+    return swapped;
+}
+
+uint64_t doubleBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bitsDouble(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+size_t paddingAt(uint64_t offset) {
+    return static_cast<size_t>((BinaryWriter::BLOCK_ALIGNMENT - offset % BinaryWriter::BLOCK_ALIGNMENT) %
+                               BinaryWriter::BLOCK_ALIGNMENT);
+}
+
+// Upper bound for reserve() from an untrusted count
+size_t reserveLimit(size_t count) { return std::min<size_t>(count, 1 << 16); }
+
+constexpr size_t STREAM_CHUNK = 1 << 20;
+constexpr int MAX_NESTING = 512;
+
+} // namespace
+
+// File mapping
+MappedFile::MappedFile(const std::string& path) : base(nullptr), length(0) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw SerializationError("Cannot open " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw SerializationError("Cannot stat " + path);
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) throw SerializationError("Cannot map " + path);
+        base = static_cast<const uint8_t*>(mapped);
+    } else {
+        ::close(fd);
+    }
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw SerializationError("Cannot open " + path);
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    base = buffer.data();
+    length = buffer.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (base && length > 0) munmap(const_cast<uint8_t*>(base), length);
+#endif
+}
+
+// Writer
+BinaryWriter::BinaryWriter(std::ostream& stream) : out(stream), offset(0) {
+    const char header[4] = {'N', 'X', 'B', static_cast<char>(VERSION)};
+    writeBytes(header, sizeof(header));
+}
+
+void BinaryWriter::write(const Value& value) {
+    switch (value.getType()) {
+        case ValueType::NIL:
+            writeTag(BinaryTag::NIL);
+            break;
+        case ValueType::BOOLEAN:
+            writeTag(value.asBool() ? BinaryTag::TRUE : BinaryTag::FALSE);
+            break;
+        case ValueType::INTEGER:
+            writeTag(BinaryTag::INTEGER);
+            writeI64(value.asInteger());
+            break;
+        case ValueType::NUMBER:
+            writeTag(BinaryTag::NUMBER);
+            writeF64(value.asNumber());
+            break;
+        case ValueType::STRING:
+            writeTag(BinaryTag::STRING);
+            writeString(value.asString());
+            break;
+        case ValueType::ARRAY: {
+            size_t count = value.arraySize();
+            switch (value.getArrayKind()) {
+                case ArrayKind::DOUBLES:
+                    writeTag(BinaryTag::DOUBLE_ARRAY);
+                    writeU64(count);
+                    writePadding();
+                    writeDoubles(value.doubleData(), count);
+                    break;
+                case ArrayKind::INTEGERS:
+                    writeTag(BinaryTag::INT_ARRAY);
+                    writeU64(count);
+                    for (size_t i = 0; i < count; ++i) {
+                        writeI64(value.elementAt(static_cast<int64_t>(i)).asInteger());
+                    }
+                    break;
+                case ArrayKind::GENERIC:
+                    writeTag(BinaryTag::ARRAY);
+                    writeU64(count);
+                    for (size_t i = 0; i < count; ++i) {
+                        write(value.elementAt(static_cast<int64_t>(i)));
+                    }
+                    break;
+            }
+            break;
+        }
+        case ValueType::OBJECT: {
+            writeTag(BinaryTag::OBJECT);
+            // Shaped objects are written from their slots, without
+            // converting them to dictionary mode
+            if (Shape* shape = value.getShape()) {
+                const std::vector<std::string>& keys = shape->getKeys();
+                writeU64(keys.size());
+                for (uint32_t i = 0; i < keys.size(); ++i) {
+                    writeString(keys[i]);
+                    write(value.slotAt(i));
+                }
+            } else {
+                const std::map<std::string, Value>& properties = value.asObject();
+                writeU64(properties.size());
+                for (const auto& [key, property] : properties) {
+                    writeString(key);
+                    write(property);
+                }
+            }
+            break;
+        }
+        case ValueType::TENSOR: {
+            std::shared_ptr<Tensor> tensor = value.asTensor();
+            writeTag(BinaryTag::TENSOR);
+            writeU64(tensor->getDimensions());
+            for (size_t dimension : tensor->getShape()) writeU64(dimension);
+            writePadding();
+            writeDoubles(tensor->rawData(), tensor->getSize());
+            break;
+        }
+        default:
+            throw SerializationError("Cannot serialize a value of type " + value.getTypeString());
+    }
+}
+
+void BinaryWriter::writeBytes(const void* data, size_t size) {
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if (!out) throw SerializationError("Write failed");
+    offset += size;
+}
+
+void BinaryWriter::writeTag(BinaryTag tag) {
+    uint8_t byte = static_cast<uint8_t>(tag);
+    writeBytes(&byte, 1);
+}
+
+void BinaryWriter::writeU64(uint64_t value) {
+    uint64_t encoded = littleEndian(value);
+    writeBytes(&encoded, sizeof(encoded));
+}
+
+void BinaryWriter::writeI64(int64_t value) { writeU64(static_cast<uint64_t>(value)); }
+void BinaryWriter::writeF64(double value) { writeU64(doubleBits(value)); }
+
+void BinaryWriter::writeString(const std::string& text) {
+    writeU64(text.size());
+    writeBytes(text.data(), text.size());
+}
+
+void BinaryWriter::writeDoubles(const double* values, size_t count) {
+    if (LITTLE_ENDIAN_HOST) {
+        writeBytes(values, count * sizeof(double));
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) writeF64(values[i]);
+}
+
+void BinaryWriter::writePadding() {
+    static const char zeros[BLOCK_ALIGNMENT] = {};
+    writeBytes(zeros, paddingAt(offset));
+}
+
+// Reader
+BinaryReader::BinaryReader(std::istream& stream)
+    : in(&stream), cursor(nullptr), end(nullptr) {
+    readHeader();
+}
+
+BinaryReader::BinaryReader(const uint8_t* data, size_t size)
+    : in(nullptr), cursor(data), end(data + size) {
+    readHeader();
+}
+
+BinaryReader::BinaryReader(std::shared_ptr<const MappedFile> file)
+    : in(nullptr), cursor(file->data()), end(file->data() + file->size()),
+      mapping(std::move(file)) {
+    readHeader();
+}
+
+BinaryReader BinaryReader::open(const std::string& path) {
+    return BinaryReader(std::make_shared<const MappedFile>(path));
+}
+
+bool BinaryReader::atEnd() {
+    if (in) return in->peek() == std::char_traits<char>::eof();
+    return cursor == end;
+}
+
+BinaryTag BinaryReader::peekTag() {
+    if (atEnd()) throw SerializationError("Unexpected end of binary data");
+    return static_cast<BinaryTag>(in ? in->peek() : *cursor);
+}
+
+Value BinaryReader::read() {
+    if (nesting >= MAX_NESTING) throw SerializationError("Binary data is nested too deeply");
+    nesting++;
+    try {
+        Value result = readValue();
+        nesting--;
+        return result;
+    } catch (...) {
+        nesting--;
+        throw;
+    }
+}
+
+Value BinaryReader::readValue() {
+    BinaryTag tag = readTag();
+    switch (tag) {
+        case BinaryTag::NIL:
+            return Value();
+        case BinaryTag::FALSE:
+            return Value(false);
+        case BinaryTag::TRUE:
+            return Value(true);
+        case BinaryTag::INTEGER:
+            return Value(readI64());
+        case BinaryTag::NUMBER:
+            return Value(readF64());
+        case BinaryTag::STRING:
+            return Value(readString());
+        case BinaryTag::ARRAY: {
+            size_t count = readCount();
+            std::vector<Value> elements;
+            elements.reserve(reserveLimit(count));
+            for (size_t i = 0; i < count; ++i) elements.push_back(read());
+            return Value(std::move(elements));
+        }
+        case BinaryTag::INT_ARRAY: {
+            size_t count = readCount();
+            std::vector<Value> elements;
+            elements.reserve(reserveLimit(count));
+            for (size_t i = 0; i < count; ++i) elements.push_back(Value(readI64()));
+            return Value(std::move(elements));
+        }
+        case BinaryTag::DOUBLE_ARRAY: {
+            size_t count = readCount();
+            skipPadding();
+            TensorBuffer elements;
+            readDoubles(elements, count);
+            return Value::numberArray(std::move(elements));
+        }
+        case BinaryTag::OBJECT: {
+            size_t count = readCount();
+            Value object = Value::emptyObject();
+            for (size_t i = 0; i < count; ++i) {
+                std::string key = readString();
+                object.setProperty(key, read());
+            }
+            return object;
+        }
+        case BinaryTag::TENSOR: {
+            size_t rank = readCount();
+            std::vector<size_t> shape;
+            shape.reserve(reserveLimit(rank));
+            size_t size = 1;
+            for (size_t i = 0; i < rank; ++i) {
+                size_t dimension = readCount();
+                if (dimension != 0 && size > std::numeric_limits<size_t>::max() / sizeof(double) / dimension) {
+                    throw SerializationError("Tensor shape is too large");
+                }
+                size *= dimension;
+                shape.push_back(dimension);
+            }
+            skipPadding();
+            TensorBuffer data;
+            readDoubles(data, size);
+            return Value(std::make_shared<Tensor>(shape, std::move(data)));
+        }
+    }
+    throw SerializationError("Unknown binary tag " + std::to_string(static_cast<int>(tag)));
+}
+
+std::string_view BinaryReader::readStringView() {
+    if (readTag() != BinaryTag::STRING) throw SerializationError("Expected a string");
+    size_t length = readCount();
+    return std::string_view(reinterpret_cast<const char*>(borrowBytes(length)), length);
+}
+
+TensorView BinaryReader::readTensorView() {
+    if (!LITTLE_ENDIAN_HOST) throw SerializationError("Tensor views need a little-endian host");
+    TensorView view;
+    BinaryTag tag = readTag();
+    if (tag == BinaryTag::DOUBLE_ARRAY) {
+        view.size = readCount();
+        view.shape = {view.size};
+    } else if (tag == BinaryTag::TENSOR) {
+        size_t rank = readCount();
+        view.size = 1;
+        for (size_t i = 0; i < rank; ++i) {
+            size_t dimension = readCount();
+            if (dimension != 0 && view.size > std::numeric_limits<size_t>::max() / sizeof(double) / dimension) {
+                throw SerializationError("Tensor shape is too large");
+            }
+            view.size *= dimension;
+            view.shape.push_back(dimension);
+        }
+    } else {
+        throw SerializationError("Expected a tensor or number array");
+    }
+    skipPadding();
+    const uint8_t* block = borrowBytes(view.size * sizeof(double));
+    if (reinterpret_cast<uintptr_t>(block) % alignof(double) != 0) {
+        throw SerializationError("Tensor block is misaligned in memory; use read()");
+    }
+    view.data = reinterpret_cast<const double*>(block);
+    view.owner = mapping;
+    return view;
+}
+
+void BinaryReader::readHeader() {
+    uint8_t header[4];
+    readBytes(header, sizeof(header));
+    if (header[0] != 'N' || header[1] != 'X' || header[2] != 'B') {
+        throw SerializationError("Not a Nexus binary stream");
+    }
+    if (header[3] == 0 || header[3] > BinaryWriter::VERSION) {
+        throw SerializationError("Unsupported binary format version " + std::to_string(header[3]));
+    }
+}
+
+void BinaryReader::readBytes(void* data, size_t size) {
+    if (in) {
+        in->read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+        if (static_cast<size_t>(in->gcount()) != size) {
+            throw SerializationError("Unexpected end of binary data");
+        }
+        offset += size;
+        return;
+    }
+    std::memcpy(data, borrowBytes(size), size);
+}
+
+const uint8_t* BinaryReader::borrowBytes(size_t size) {
+    if (in) throw SerializationError("Views need a memory-backed reader");
+    if (static_cast<size_t>(end - cursor) < size) {
+        throw SerializationError("Unexpected end of binary data");
+    }
+    const uint8_t* start = cursor;
+    cursor += size;
+    offset += size;
+    return start;
+}
+
+BinaryTag BinaryReader::readTag() {
+    uint8_t byte;
+    readBytes(&byte, 1);
+    return static_cast<BinaryTag>(byte);
+}
+
+uint64_t BinaryReader::readU64() {
+    uint64_t encoded;
+    readBytes(&encoded, sizeof(encoded));
+    return littleEndian(encoded);
+}
+
+int64_t BinaryReader::readI64() { return static_cast<int64_t>(readU64()); }
+double BinaryReader::readF64() { return bitsDouble(readU64()); }
+
+size_t BinaryReader::readCount() {
+    uint64_t count = readU64();
+    if (count > std::numeric_limits<size_t>::max() / sizeof(double)) {
+        throw SerializationError("Corrupt length in binary data");
+    }
+    return static_cast<size_t>(count);
+}
+
+// Stream sources grow the buffer chunk by chunk, so a corrupt length fails
+// at end of input rather than with a huge allocation
+std::string BinaryReader::readString() {
+    size_t length = readCount();
+    if (!in) {
+        const uint8_t* bytes = borrowBytes(length);
+        return std::string(reinterpret_cast<const char*>(bytes), length);
+    }
+    std::string text;
+    while (text.size() < length) {
+        size_t filled = text.size();
+        text.resize(filled + std::min(length - filled, STREAM_CHUNK));
+        readBytes(&text[filled], text.size() - filled);
+    }
+    return text;
+}
+
+void BinaryReader::readDoubles(TensorBuffer& values, size_t count) {
+    if (!in) {
+        const uint8_t* bytes = borrowBytes(count * sizeof(double));
+        values.resize(count);
+        std::memcpy(values.data(), bytes, count * sizeof(double));
+    } else {
+        values.clear();
+        while (values.size() < count) {
+            size_t filled = values.size();
+            values.resize(filled + std::min(count - filled, STREAM_CHUNK / sizeof(double)));
+            readBytes(values.data() + filled, (values.size() - filled) * sizeof(double));
+        }
+    }
+    if (!LITTLE_ENDIAN_HOST) {
+        for (double& value : values) value = bitsDouble(littleEndian(doubleBits(value)));
+    }
+}
+
+void BinaryReader::skipPadding() {
+    size_t padding = paddingAt(offset);
+    if (padding == 0) return;
+    if (in) {
+        char discard[BinaryWriter::BLOCK_ALIGNMENT];
+        readBytes(discard, padding);
+    } else {
+        borrowBytes(padding);
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "value.h"
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class SerializationError : public std::exception {
+private:
+    std::string message;
+    
+public:
+    explicit SerializationError(const std::string& msg) : message(msg) {}
+    const char* what() const noexcept override { return message.c_str(); }
+};
+
+// Binary value format. Integers and floats are little-endian; a stream is a
+// header followed by any number of values.
+//
+//   stream  := 'N' 'X' 'B' version:u8 value*
+//   value   := tag:u8 payload
+//   NIL, FALSE, TRUE     (no payload)
+//   INTEGER              i64
+//   NUMBER               f64
+//   STRING               length:u64 bytes
+//   ARRAY                count:u64 value*
+//   INT_ARRAY            count:u64 i64*
+//   DOUBLE_ARRAY         count:u64 pad f64*
+//   OBJECT               count:u64 (length:u64 key-bytes value)*
+//   TENSOR               rank:u64 dim:u64* pad f64*
+//
+// pad is zero bytes up to the next multiple of BLOCK_ALIGNMENT counted from
+// the start of the stream, so raw blocks in a mapped file are cache-line
+// aligned and can be used in place.
+enum class BinaryTag : uint8_t {
+    NIL,
+    FALSE,
+    TRUE,
+    INTEGER,
+    NUMBER,
+    STRING,
+    ARRAY,
+    INT_ARRAY,
+    DOUBLE_ARRAY,
+    OBJECT,
+    TENSOR
+};
+
+// Read-only file mapping (a plain read into memory where mmap is unavailable)
+class MappedFile {
+private:
+    const uint8_t* base;
+    size_t length;
+    std::vector<uint8_t> buffer;  // Only used without mmap
+    
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const uint8_t* data() const { return base; }
+    size_t size() const { return length; }
+};
+
+// Borrowed tensor payload; owner keeps the underlying buffer alive
+struct TensorView {
+    std::vector<size_t> shape;
+    const double* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> owner;
+};
+
+class BinaryWriter {
+private:
+    std::ostream& out;
+    uint64_t offset;
+    
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t BLOCK_ALIGNMENT = 64;
+    
+    explicit BinaryWriter(std::ostream& stream);  // Writes the stream header
+    
+    void write(const Value& value);
+    uint64_t bytesWritten() const { return offset; }
+    
+private:
+    void writeBytes(const void* data, size_t size);
+    void writeTag(BinaryTag tag);
+    void writeU64(uint64_t value);
+    void writeI64(int64_t value);
+    void writeF64(double value);
+    void writeString(const std::string& text);
+    void writeDoubles(const double* values, size_t count);
+    void writePadding();
+};
+
+// Reads values back either from an istream (copying) or from memory, such as
+// a mapped file. read() always materializes owned Values; with a memory
+// source, readStringView and readTensorView return the payload in place.
+class BinaryReader {
+private:
+    std::istream* in;
+    const uint8_t* cursor;
+    const uint8_t* end;
+    std::shared_ptr<const MappedFile> mapping;
+    uint64_t offset = 0;
+    int nesting = 0;  // Depth of the read() in progress
+    
+public:
+    explicit BinaryReader(std::istream& stream);
+    BinaryReader(const uint8_t* data, size_t size);
+    explicit BinaryReader(std::shared_ptr<const MappedFile> file);
+    
+    static BinaryReader open(const std::string& path);  // Maps the file
+    
+    bool atEnd();
+    BinaryTag peekTag();
+    Value read();
+    
+    // Zero-copy accessors; memory sources only. readTensorView also accepts
+    // a DOUBLE_ARRAY, viewed as a rank-1 tensor.
+    std::string_view readStringView();
+    TensorView readTensorView();
+    
+private:
+    Value readValue();
+    void readHeader();
+    void readBytes(void* data, size_t size);
+    const uint8_t* borrowBytes(size_t size);
+    BinaryTag readTag();
+    uint64_t readU64();
+    int64_t readI64();
+    double readF64();
+    size_t readCount();
+    std::string readString();
+    void readDoubles(TensorBuffer& values, size_t count);
+    void skipPadding();
+};
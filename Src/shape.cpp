@@ -0,0 +1,33 @@
+#include "shape.h"
+#include "runtime_context.h"
+
+Shape::Shape(Shape* from, const std::string& key)
+    : parent(from), keys(from->keys) {
+    keys.push_back(key);
+    if (keys.size() > LINEAR_LOOKUP_LIMIT) {
+        index.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            index.emplace(keys[i], static_cast<uint32_t>(i));
+        }
+    }
+}
+
+// Each runtime context has its own shape tree, so transitions are never
+// shared between interpreters running on different threads
+Shape* Shape::root() {
+    return RuntimeContext::current().getRootShape();
+}
+
+Shape* Shape::addProperty(const std::string& key) {
+    auto it = transitions.find(key);
+    if (it != transitions.end()) {
+        return it->second.get();
+    }
+    if (keys.size() >= MAX_SLOTS || transitions.size() >= MAX_TRANSITIONS) {
+        return nullptr;
+    }
+    auto child = std::make_unique<Shape>(this, key);
+    Shape* result = child.get();
+    transitions.emplace(key, std::move(child));
+    return result;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Hidden class shared by all objects that were built with the same sequence
+// of property names. A shape maps names to slot indices; adding a property
+// follows (or creates) a transition to a child shape. A tree lives as long as
+// the RuntimeContext that owns its root.
+class Shape {
+private:
+    Shape* parent;
+    std::vector<std::string> keys;                       // Slot order
+    std::unordered_map<std::string, uint32_t> index;     // Only for wide shapes
+    std::unordered_map<std::string, std::unique_ptr<Shape>> transitions;
+
+public:
+    // Objects with more properties than this, or created from a shape whose
+    // transition table is this wide, are kept in dictionary mode instead
+    static constexpr uint32_t MAX_SLOTS = 32;
+    static constexpr size_t MAX_TRANSITIONS = 64;
+    static constexpr size_t LINEAR_LOOKUP_LIMIT = 8;
+
+    Shape() : parent(nullptr) {}
+    Shape(Shape* from, const std::string& key);
+
+    // Shape of the empty object in the current RuntimeContext
+    static Shape* root();
+
+    // Slot of a property, or -1 when this shape does not have it
+    int32_t lookup(const std::string& key) const {
+        if (keys.size() <= LINEAR_LOOKUP_LIMIT) {
+            for (size_t i = 0; i < keys.size(); ++i) {
+                if (keys[i] == key) return static_cast<int32_t>(i);
+            }
+            return -1;
+        }
+        auto it = index.find(key);
+        return it == index.end() ? -1 : static_cast<int32_t>(it->second);
+    }
+
+    // Child shape with key appended, or nullptr when the object should switch
+    // to dictionary mode
+    Shape* addProperty(const std::string& key);
+
+    // Inspection
+    Shape* getParent() const { return parent; }
+    const std::vector<std::string>& getKeys() const { return keys; }
+    uint32_t getSlotCount() const { return static_cast<uint32_t>(keys.size()); }
+    size_t getTransitionCount() const { return transitions.size(); }
+};
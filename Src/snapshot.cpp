@@ -0,0 +1,175 @@
+#include "interpreter.h"
+#include <unordered_map>
+
+namespace {
+
+// Rebuilds a value graph inside the fork's runtime context. Values of the
+// source are owned by its thread (their refcounts are not atomic), so
+// containers and strings are copied, unboxed arrays in one block; tensor
+// storage and bound natives are shared through their atomic shared_ptrs,
+// tensors being copied on write (Value::mutableTensor). Functions share
+// their immutable token streams (the fork keeps its own caches, keyed by
+// Token::site) and are rebound to the fork's environments and upvalue cells,
+// and methods of builtin objects to copies of their NativeState.
+class Transplanter {
+private:
+    std::shared_ptr<Environment> sourceGlobals;
+    std::shared_ptr<Environment> targetGlobals;
+    GarbageCollector& collector;
+    std::unordered_map<const Environment*, std::shared_ptr<Environment>> environments;
+    std::unordered_map<const NexusFunction*, std::shared_ptr<NexusFunction>> functions;
+    std::unordered_map<const UpvalueCell*, std::shared_ptr<UpvalueCell>> cells;
+    std::unordered_map<const NativeState*, std::shared_ptr<NativeState>> states;
+
+public:
+    Transplanter(std::shared_ptr<Environment> from, std::shared_ptr<Environment> to, GarbageCollector& gc)
+        : sourceGlobals(std::move(from)), targetGlobals(std::move(to)), collector(gc) {}
+
+    Environment::Snapshot image(const Environment::Snapshot& source) {
+        Environment::Snapshot result;
+        result.constants = source.constants;
+        for (const auto& [name, value] : source.variables) {
+            result.variables.emplace(name, copy(value));
+        }
+        return result;
+    }
+
+    Value copy(const Value& source) {
+        if (const int64_t* integers = source.integerData()) {
+            return Value::integerArray(std::vector<int64_t>(integers, integers + source.arraySize()));
+        }
+        if (const double* doubles = source.doubleData()) {
+            return Value::numberArray(TensorBuffer(doubles, doubles + source.arraySize()));
+        }
+        if (source.isArray()) {
+            std::vector<Value> elements;
+            elements.reserve(source.arraySize());
+            for (auto it = source.begin(); it != source.end(); ++it) elements.push_back(copy(*it));
+            return Value(std::move(elements));
+        }
+        if (source.isObject()) {
+            Value result = Value::emptyObject();
+            for (auto it = source.begin(); it != source.end(); ++it) {
+                result.setProperty(it.key(), copy(*it));
+            }
+            return result;
+        }
+        if (source.isString()) return Value(source.asString());
+        if (source.isTensor()) return Value(source.asTensor());
+        if (source.isCallable()) return Value(callable(source.asCallable()));
+        if (source.isInteger()) return Value(source.asInteger());
+        return source;  // nil, booleans and doubles are immediate
+    }
+
+private:
+    std::shared_ptr<Callable> callable(const std::shared_ptr<Callable>& source) {
+        if (auto function = std::dynamic_pointer_cast<NexusFunction>(source)) {
+            return rebind(function);
+        }
+        if (auto native = std::dynamic_pointer_cast<NativeCallable>(source)) {
+            if (!native->getState()) {
+                throw SnapshotError("Cannot fork " + source->toString() + ": its state cannot be copied");
+            }
+            return native->rebind(state(native->getState()));
+        }
+        return source;  // Bound natives are stateless
+    }
+
+    std::shared_ptr<NativeState> state(const std::shared_ptr<NativeState>& source) {
+        auto found = states.find(source.get());
+        if (found != states.end()) return found->second;
+
+        auto result = source->blank();
+        states.emplace(source.get(), result);  // Before the contents, which may refer back
+        source->copyInto(*result, [this](const Value& value) { return copy(value); });
+        return result;
+    }
+
+    std::shared_ptr<NexusFunction> rebind(const std::shared_ptr<NexusFunction>& source) {
+        auto found = functions.find(source.get());
+        if (found != functions.end()) return found->second;
+
+        auto result = std::make_shared<NexusFunction>(source->getName(), source->getParameters(),
+                                                      source->shareTokens(),
+                                                      source->getBodyStart(),
+                                                      environment(source->getClosure()));
+        result->setLayout(source->shareLayout());  // Its upvalue indices follow this layout
+        functions.emplace(source.get(), result);  // Before the upvalues, which may refer back
+        collector.track(result);
+        for (size_t i = 0; i < source->getUpvalueCount(); ++i) {
+            result->setUpvalue(i, cell(source->shareUpvalue(i)));
+        }
+        return result;
+    }
+
+    std::shared_ptr<UpvalueCell> cell(const std::shared_ptr<UpvalueCell>& source) {
+        if (!source) return nullptr;
+        auto found = cells.find(source.get());
+        if (found != cells.end()) return found->second;
+
+        auto result = std::make_shared<UpvalueCell>();
+        cells.emplace(source.get(), result);
+        result->value = copy(source->value);
+        return result;
+    }
+
+    std::shared_ptr<Environment> environment(const std::shared_ptr<Environment>& source) {
+        if (!source) return nullptr;
+        if (source == sourceGlobals) return targetGlobals;
+        auto found = environments.find(source.get());
+        if (found != environments.end()) return found->second;
+
+        auto result = std::make_shared<Environment>(environment(source->getParent()), source->getScopeName());
+        environments.emplace(source.get(), result);
+        result->restore(image(source->snapshot()));
+        return result;
+    }
+};
+
+} // namespace
+
+std::shared_ptr<const InterpreterSnapshot> NexusInterpreter::snapshot() const {
+    return std::make_shared<InterpreterSnapshot>(InterpreterSnapshot{&context, globals->snapshot(), models});
+}
+
+// Rolls the global state back to a checkpoint; cached global cells are
+// revalidated through the environment's version
+void NexusInterpreter::restore(const InterpreterSnapshot& image) {
+    if (image.owner != &context) {
+        throw SnapshotError("Snapshot was taken by a different interpreter; use fork() instead");
+    }
+    if (callDepth > 0) {
+        runtimeError("Cannot restore a snapshot while a function is running");
+    }
+    RuntimeContext::Scope scope(context);
+    collector.touch(globals.get());
+    globals->restore(image.globals);
+    environment = globals;
+    models = image.models;
+    accountModels();
+}
+
+// New interpreter starting from a checkpoint, ready to be handed to another
+// thread. Unlike snapshot(), this copies every string, array, object and
+// builtin state reachable from the globals, so it costs time and memory in
+// proportion to the live data; only tensor storage (copied on write) and
+// models are shared. A fork must not train a model that others are still
+// using. Its payloads are built here but die on that thread, so none of them
+// may come from this thread's scratch arena.
+std::unique_ptr<NexusInterpreter> NexusInterpreter::fork(const InterpreterSnapshot& image) const {
+    if (image.owner != &context) {
+        throw SnapshotError("Snapshot was taken by a different interpreter");
+    }
+    ScratchArena::Bypass bypass;
+    auto result = std::make_unique<NexusInterpreter>();
+    result->debugMode = debugMode;
+    result->profilingMode = profilingMode;
+
+    RuntimeContext::Scope scope(result->context);
+    Transplanter transplanter(globals, result->globals, result->collector);
+    result->globals->restore(transplanter.image(image.globals));
+    result->environment = result->globals;
+    result->models = image.models;
+    result->accountModels();
+    return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "enviorment.h"
+#include "ml/neural_network.h"
+#include <map>
+#include <memory>
+#include <string>
+
+class RuntimeContext;
+
+class SnapshotError : public std::exception {
+private:
+    std::string message;
+
+public:
+    explicit SnapshotError(const std::string& msg) : message(msg) {}
+    const char* what() const noexcept override { return message.c_str(); }
+};
+
+// Checkpoint of an interpreter's global state: the global scope and the
+// model table. Both are copied as tables of handles, so a snapshot shares
+// every array, tensor and model with the live state (values are
+// copy-on-write) and taking one costs time in the number of globals, not in
+// how much data they hold. A snapshot belongs to the interpreter that took
+// it. Other threads get their own state through NexusInterpreter::fork,
+// which copies the data itself, since refcounts are not atomic.
+struct InterpreterSnapshot {
+    const RuntimeContext* owner;
+    Environment::Snapshot globals;
+    std::map<std::string, std::shared_ptr<NeuralNetwork>> models;
+};
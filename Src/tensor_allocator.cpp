@@ -0,0 +1,493 @@
+#include "tensor_allocator.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t CLASS_COUNT = 16;  // 64 bytes up to MAX_CLASS_BYTES
+static_assert(TensorMemory::MIN_CLASS_BYTES << (CLASS_COUNT - 1) == TensorMemory::MAX_CLASS_BYTES,
+              "size classes end at MAX_CLASS_BYTES");
+
+// A thread folds its change in bytes in use into the shared total once it
+// drifts this far, which is also how far off the peak can be per thread
+constexpr int64_t FOLD_BYTES = int64_t(1) << 20;
+
+std::atomic<int64_t> bytesInUse{0};  // Folded from the threads
+std::atomic<int64_t> peakBytes{0};
+std::atomic<size_t> cacheLimit{TensorMemory::DEFAULT_CACHE_LIMIT};
+
+size_t sizeClass(size_t bytes) {
+    size_t index = 0;
+    size_t capacity = TensorMemory::MIN_CLASS_BYTES;
+    while (capacity < bytes) {
+        capacity <<= 1;
+        index++;
+    }
+    return index;
+}
+
+size_t classBytes(size_t index) {
+    return TensorMemory::MIN_CLASS_BYTES << index;
+}
+
+// Bytes reserved for a request: its size class, or whole pages past the
+// largest class
+size_t roundedBytes(size_t bytes) {
+    if (bytes <= TensorMemory::MAX_CLASS_BYTES) return classBytes(sizeClass(bytes));
+    if (bytes > SIZE_MAX - TensorMemory::PAGE_BYTES) throw std::bad_alloc();
+    return (bytes + TensorMemory::PAGE_BYTES - 1) & ~(TensorMemory::PAGE_BYTES - 1);
+}
+
+// Byte counts with an optional K, M or G suffix
+bool parseBytes(const std::string& text, size_t& bytes) {
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str()) return false;
+    switch (*end) {
+        case '\0': break;
+        case 'k': case 'K': value <<= 10; ++end; break;
+        case 'm': case 'M': value <<= 20; ++end; break;
+        case 'g': case 'G': value <<= 30; ++end; break;
+        default: return false;
+    }
+    if (*end != '\0') return false;
+    bytes = static_cast<size_t>(value);
+    return true;
+}
+
+// The policy is read on every system allocation, so it is packed into one
+// word that a single atomic load reads and a store replaces: the threshold
+// in the low 48 bits (larger ones saturate, which no allocation reaches),
+// then the page mode, the placement and the node (saturated at 4095;
+// place() ignores any node past its mask anyway).
+constexpr int PAGES_SHIFT = 48;
+constexpr int PLACEMENT_SHIFT = 50;
+constexpr int NODE_SHIFT = 52;
+constexpr uint64_t THRESHOLD_MASK = (uint64_t(1) << PAGES_SHIFT) - 1;
+constexpr uint64_t NODE_MASK = 0xFFF;
+
+uint64_t packPolicy(const LargeBlockPolicy& policy) {
+    uint64_t threshold = std::min<uint64_t>(policy.threshold, THRESHOLD_MASK);
+    uint64_t node = std::min<uint64_t>(policy.node, NODE_MASK);
+    return threshold | uint64_t(policy.pages) << PAGES_SHIFT | uint64_t(policy.placement) << PLACEMENT_SHIFT |
+           node << NODE_SHIFT;
+}
+
+LargeBlockPolicy unpackPolicy(uint64_t word) {
+    LargeBlockPolicy policy;
+    policy.threshold = static_cast<size_t>(word & THRESHOLD_MASK);
+    policy.pages = static_cast<LargeBlockPolicy::Pages>((word >> PAGES_SHIFT) & 3);
+    policy.placement = static_cast<LargeBlockPolicy::Placement>((word >> PLACEMENT_SHIFT) & 3);
+    policy.node = static_cast<unsigned>((word >> NODE_SHIFT) & NODE_MASK);
+    return policy;
+}
+
+// Blocks mapped under the large-block policy, with their mapped length; the
+// rest came from aligned operator new. Only large allocations take the lock.
+struct LargeBlocks {
+    std::mutex lock;
+    std::atomic<uint64_t> policy;  // packPolicy
+    std::unordered_map<void*, size_t> mapped;
+    size_t bytes = 0;
+    std::atomic<size_t> count{0};  // mapped.size(), readable without the lock
+
+    LargeBlocks() {
+        LargeBlockPolicy initial;
+        if (const char* spec = std::getenv("NEXUS_TENSOR_MEMORY")) {
+            try {
+                initial = LargeBlockPolicy::parse(spec);
+            } catch (const std::invalid_argument& error) {
+                std::cerr << "Warning: ignoring NEXUS_TENSOR_MEMORY: " << error.what() << std::endl;
+            }
+        }
+        policy.store(packPolicy(initial), std::memory_order_relaxed);
+    }
+};
+
+LargeBlocks& largeBlocks() {
+    static LargeBlocks* blocks = new LargeBlocks();  // Never destroyed: blocks may be freed during exit
+    return *blocks;
+}
+
+#ifdef __linux__
+
+constexpr size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+constexpr size_t NODE_MASK_WORDS = 16;  // Up to 1024 NUMA nodes
+constexpr int MPOL_BIND_MODE = 2;
+constexpr int MPOL_INTERLEAVE_MODE = 3;
+
+// Parses /sys/devices/system/node/online ("0-1,3") into a node mask
+bool onlineNodes(unsigned long (&mask)[NODE_MASK_WORDS]) {
+    std::ifstream file("/sys/devices/system/node/online");
+    std::string list;
+    if (!(file >> list)) return false;
+    size_t position = 0;
+    while (position < list.size()) {
+        size_t comma = list.find(',', position);
+        std::string range = list.substr(position, comma == std::string::npos ? std::string::npos : comma - position);
+        size_t dash = range.find('-');
+        unsigned long first = std::strtoul(range.c_str(), nullptr, 10);
+        unsigned long last = dash == std::string::npos ? first : std::strtoul(range.c_str() + dash + 1, nullptr, 10);
+        for (unsigned long node = first; node <= last && node < NODE_MASK_WORDS * 64; ++node) {
+            mask[node / 64] |= 1UL << (node % 64);
+        }
+        if (comma == std::string::npos) break;
+        position = comma + 1;
+    }
+    return true;
+}
+
+// mbind(2) through syscall, so the build does not depend on libnuma. Failure
+// (a kernel without NUMA, a node that does not exist) leaves the default
+// first-touch placement.
+void place(void* block, size_t length, const LargeBlockPolicy& policy) {
+    if (policy.placement == LargeBlockPolicy::Placement::LOCAL) return;
+    unsigned long mask[NODE_MASK_WORDS] = {};
+    int mode = MPOL_BIND_MODE;
+    if (policy.placement == LargeBlockPolicy::Placement::INTERLEAVE) {
+        if (!onlineNodes(mask)) return;
+        mode = MPOL_INTERLEAVE_MODE;
+    } else {
+        if (policy.node >= NODE_MASK_WORDS * 64) return;
+        mask[policy.node / 64] |= 1UL << (policy.node % 64);
+    }
+    syscall(SYS_mbind, block, length, mode, mask, NODE_MASK_WORDS * 64 + 1, 0);
+}
+
+// Maps length bytes on a huge page boundary, or returns null
+void* mapLarge(size_t length, const LargeBlockPolicy& policy) {
+    if (policy.pages == LargeBlockPolicy::Pages::EXPLICIT) {
+        void* block = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block != MAP_FAILED) return block;
+    }
+    // Over-map by one huge page and trim both ends to the boundary
+    size_t span = length + HUGE_PAGE_BYTES;
+    void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+    if (aligned > start) munmap(raw, aligned - start);
+    size_t tail = start + span - (aligned + length);
+    if (tail > 0) munmap(reinterpret_cast<void*>(aligned + length), tail);
+    void* block = reinterpret_cast<void*>(aligned);
+    if (policy.pages != LargeBlockPolicy::Pages::NORMAL) madvise(block, length, MADV_HUGEPAGE);
+    return block;
+}
+
+void* allocateLarge(size_t bytes, LargeBlocks& blocks, const LargeBlockPolicy& policy) {
+    size_t length = (bytes + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+    void* block = mapLarge(length, policy);
+    if (!block) return nullptr;
+    place(block, length, policy);
+    std::lock_guard<std::mutex> guard(blocks.lock);
+    blocks.mapped.emplace(block, length);
+    blocks.bytes += length;
+    blocks.count.store(blocks.mapped.size(), std::memory_order_relaxed);
+    return block;
+}
+
+#endif
+
+void* systemAllocate(size_t bytes) {
+#ifdef __linux__
+    LargeBlocks& blocks = largeBlocks();
+    LargeBlockPolicy policy = unpackPolicy(blocks.policy.load(std::memory_order_relaxed));
+    bool mapped = policy.pages != LargeBlockPolicy::Pages::NORMAL ||
+                  policy.placement != LargeBlockPolicy::Placement::LOCAL;
+    if (mapped && bytes >= policy.threshold) {
+        if (void* block = allocateLarge(bytes, blocks, policy)) return block;
+    }
+#endif
+    return ::operator new(bytes, std::align_val_t(TensorMemory::ALIGNMENT));
+}
+
+void systemRelease(void* block) {
+#ifdef __linux__
+    LargeBlocks& blocks = largeBlocks();
+    if (blocks.count.load(std::memory_order_relaxed) > 0) {
+        std::unique_lock<std::mutex> guard(blocks.lock);
+        auto found = blocks.mapped.find(block);
+        if (found != blocks.mapped.end()) {
+            size_t length = found->second;
+            blocks.mapped.erase(found);
+            blocks.bytes -= length;
+            blocks.count.store(blocks.mapped.size(), std::memory_order_relaxed);
+            guard.unlock();
+            munmap(block, length);
+            return;
+        }
+    }
+#endif
+    ::operator delete(block, std::align_val_t(TensorMemory::ALIGNMENT));
+}
+
+// Set once the thread's cache has been destroyed; a trivially destructible
+// thread_local stays readable while later destructors on the thread run
+thread_local bool cacheGone = false;
+
+// Adds to a counter that only the calling thread writes: a plain load and
+// store, which other threads may read at any time
+template <typename T>
+void bump(std::atomic<T>& counter, T amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void fold(int64_t delta) {
+    int64_t inUse = bytesInUse.fetch_add(delta, std::memory_order_relaxed) + delta;
+    int64_t peak = peakBytes.load(std::memory_order_relaxed);
+    while (inUse > peak && !peakBytes.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {}
+}
+
+struct ThreadCache;
+
+// Live thread caches, for getStats, and the counters of exited threads
+struct Registry {
+    std::mutex lock;
+    std::vector<ThreadCache*> threads;
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry();  // Never destroyed: threads may exit during exit
+    return *instance;
+}
+
+struct ThreadCache {
+    std::array<std::vector<void*>, CLASS_COUNT> freeLists;
+    std::vector<std::pair<size_t, void*>> pageBlocks;  // Past the largest class, by rounded size
+
+    // Written only by this thread
+    std::atomic<size_t> held{0};
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+    std::atomic<int64_t> pending{0};  // Change in bytes in use not yet folded
+
+    ThreadCache() {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> guard(shared.lock);
+        shared.threads.push_back(this);
+    }
+
+    void account(int64_t delta) {
+        int64_t drift = pending.load(std::memory_order_relaxed) + delta;
+        if (drift > FOLD_BYTES || drift < -FOLD_BYTES) {
+            fold(drift);
+            drift = 0;
+        }
+        pending.store(drift, std::memory_order_relaxed);
+    }
+
+    void* take(size_t rounded) {
+        if (rounded <= TensorMemory::MAX_CLASS_BYTES) {
+            std::vector<void*>& list = freeLists[sizeClass(rounded)];
+            if (list.empty()) return nullptr;
+            void* block = list.back();
+            list.pop_back();
+            return block;
+        }
+        for (size_t i = pageBlocks.size(); i-- > 0;) {
+            if (pageBlocks[i].first != rounded) continue;
+            void* block = pageBlocks[i].second;
+            pageBlocks.erase(pageBlocks.begin() + static_cast<std::ptrdiff_t>(i));
+            return block;
+        }
+        return nullptr;
+    }
+
+    void keep(void* block, size_t rounded) {
+        if (rounded <= TensorMemory::MAX_CLASS_BYTES) {
+            freeLists[sizeClass(rounded)].push_back(block);
+        } else {
+            pageBlocks.emplace_back(rounded, block);
+        }
+    }
+
+    void drain() {
+        for (size_t index = 0; index < CLASS_COUNT; ++index) {
+            for (void* block : freeLists[index]) systemRelease(block);
+            freeLists[index].clear();
+            freeLists[index].shrink_to_fit();
+        }
+        for (const auto& entry : pageBlocks) systemRelease(entry.second);
+        pageBlocks.clear();
+        pageBlocks.shrink_to_fit();
+        held.store(0, std::memory_order_relaxed);
+    }
+
+    ~ThreadCache() {
+        drain();
+        Registry& shared = registry();
+        {
+            std::lock_guard<std::mutex> guard(shared.lock);
+            shared.threads.erase(std::find(shared.threads.begin(), shared.threads.end(), this));
+            shared.hits.fetch_add(hits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            shared.misses.fetch_add(misses.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        fold(pending.load(std::memory_order_relaxed));
+        cacheGone = true;
+    }
+};
+
+thread_local ThreadCache cache;
+
+} // namespace
+
+void* TensorMemory::allocate(size_t bytes) {
+    size_t rounded = roundedBytes(bytes);
+    if (cacheGone) {
+        fold(static_cast<int64_t>(rounded));
+        registry().misses.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        cache.account(static_cast<int64_t>(rounded));
+        if (void* block = cache.take(rounded)) {
+            cache.held.store(cache.held.load(std::memory_order_relaxed) - rounded, std::memory_order_relaxed);
+            bump(cache.hits, size_t(1));
+            return block;
+        }
+        bump(cache.misses, size_t(1));
+    }
+    try {
+        return systemAllocate(rounded);
+    } catch (...) {
+        if (cacheGone) fold(-static_cast<int64_t>(rounded));
+        else cache.account(-static_cast<int64_t>(rounded));
+        throw;
+    }
+}
+
+void TensorMemory::release(void* block, size_t bytes) {
+    if (!block) return;
+    size_t rounded = roundedBytes(bytes);
+    if (cacheGone) {
+        fold(-static_cast<int64_t>(rounded));
+        systemRelease(block);
+        return;
+    }
+    cache.account(-static_cast<int64_t>(rounded));
+    if (cache.held.load(std::memory_order_relaxed) + rounded <= cacheLimit.load(std::memory_order_relaxed)) {
+        try {
+            cache.keep(block, rounded);
+            bump(cache.held, rounded);
+            return;
+        } catch (const std::bad_alloc&) {
+            // No room to remember the block; give it back instead
+        }
+    }
+    systemRelease(block);
+}
+
+void TensorMemory::trim() {
+    if (!cacheGone) cache.drain();
+}
+
+void TensorMemory::setCacheLimit(size_t bytes) {
+    cacheLimit.store(bytes, std::memory_order_relaxed);
+}
+
+size_t TensorMemory::getCacheLimit() {
+    return cacheLimit.load(std::memory_order_relaxed);
+}
+
+void TensorMemory::setLargeBlockPolicy(const LargeBlockPolicy& policy) {
+    largeBlocks().policy.store(packPolicy(policy), std::memory_order_relaxed);
+}
+
+LargeBlockPolicy TensorMemory::getLargeBlockPolicy() {
+    return unpackPolicy(largeBlocks().policy.load(std::memory_order_relaxed));
+}
+
+TensorAllocatorStats TensorMemory::getStats() {
+    TensorAllocatorStats stats;
+    int64_t inUse = bytesInUse.load(std::memory_order_relaxed);
+    {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> guard(shared.lock);
+        stats.hits = shared.hits.load(std::memory_order_relaxed);
+        stats.misses = shared.misses.load(std::memory_order_relaxed);
+        for (const ThreadCache* thread : shared.threads) {
+            stats.hits += thread->hits.load(std::memory_order_relaxed);
+            stats.misses += thread->misses.load(std::memory_order_relaxed);
+            stats.bytesHeld += thread->held.load(std::memory_order_relaxed);
+            inUse += thread->pending.load(std::memory_order_relaxed);
+        }
+    }
+    // Blocks freed on another thread than their own can leave the sum of
+    // folded changes briefly below zero
+    int64_t peak = std::max(inUse, peakBytes.load(std::memory_order_relaxed));
+    stats.bytesInUse = static_cast<size_t>(std::max<int64_t>(inUse, 0));
+    stats.peakBytes = static_cast<size_t>(std::max<int64_t>(peak, 0));
+    LargeBlocks& blocks = largeBlocks();
+    std::lock_guard<std::mutex> guard(blocks.lock);
+    stats.largeBlocks = blocks.mapped.size();
+    stats.largeBytes = blocks.bytes;
+    return stats;
+}
+
+void TensorMemory::printStats(std::ostream& out) {
+    TensorAllocatorStats stats = getStats();
+    size_t requests = stats.hits + stats.misses;
+    out << std::fixed << std::setprecision(1);
+    out << "Tensor memory: " << stats.hits << " cache hits, " << stats.misses << " system allocations ("
+        << (requests ? 100.0 * stats.hits / requests : 0.0) << "% hit rate)" << std::endl;
+    out << "  in use " << stats.bytesInUse << " bytes, peak " << stats.peakBytes << " bytes, held in free lists "
+        << stats.bytesHeld << " bytes" << std::endl;
+    if (stats.largeBlocks > 0) {
+        out << "  " << stats.largeBlocks << " large blocks mapped, " << stats.largeBytes << " bytes" << std::endl;
+    }
+}
+
+LargeBlockPolicy LargeBlockPolicy::parse(const std::string& spec) {
+    LargeBlockPolicy policy;
+    size_t position = 0;
+    while (position < spec.size()) {
+        size_t comma = spec.find(',', position);
+        std::string item = spec.substr(position, comma == std::string::npos ? std::string::npos : comma - position);
+        position = comma == std::string::npos ? spec.size() : comma + 1;
+        if (item.empty()) continue;
+
+        size_t equals = item.find('=');
+        if (equals == std::string::npos) throw std::invalid_argument("Expected key=value in tensor memory policy: " + item);
+        std::string key = item.substr(0, equals);
+        std::string value = item.substr(equals + 1);
+        size_t number = 0;
+        if (key == "pages") {
+            if (value == "off" || value == "normal") policy.pages = Pages::NORMAL;
+            else if (value == "thp" || value == "transparent") policy.pages = Pages::TRANSPARENT;
+            else if (value == "huge" || value == "explicit") policy.pages = Pages::EXPLICIT;
+            else throw std::invalid_argument("Unknown page mode: " + value);
+        } else if (key == "numa") {
+            if (value == "local") policy.placement = Placement::LOCAL;
+            else if (value == "interleave") policy.placement = Placement::INTERLEAVE;
+            else if (parseBytes(value, number) && value.find_first_not_of("0123456789") == std::string::npos) {
+                policy.placement = Placement::BIND;
+                policy.node = static_cast<unsigned>(number);
+            } else {
+                throw std::invalid_argument("Unknown NUMA placement: " + value);
+            }
+        } else if (key == "threshold") {
+            if (!parseBytes(value, number)) throw std::invalid_argument("Invalid threshold: " + value);
+            policy.threshold = number;
+        } else {
+            throw std::invalid_argument("Unknown tensor memory option: " + key);
+        }
+    }
+    return policy;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Counters reported with --gc-stats
+struct TensorAllocatorStats {
+    size_t hits = 0;         // Blocks served from a free list
+    size_t misses = 0;       // Blocks taken from the system
+    size_t bytesInUse = 0;   // Rounded bytes handed out and not yet returned
+    size_t peakBytes = 0;    // High-water mark of bytesInUse, to within 1 MB per thread
+    size_t bytesHeld = 0;    // Free blocks cached across all threads
+    size_t largeBlocks = 0;  // Blocks currently mapped under the large-block policy
+    size_t largeBytes = 0;
+};
+
+// How blocks of at least `threshold` bytes are obtained from the system
+// (Linux only; elsewhere they are ordinary aligned allocations). They are
+// mapped on 2 MB boundaries and either advised as transparent huge pages or
+// taken from the explicit huge page pool (falling back to transparent ones
+// when it is empty), so matmul over a large tensor does not thrash the TLB.
+// Placement interleaves the pages across the online NUMA nodes or binds
+// them to one; with LOCAL, pages land on the node of the thread that first
+// touches them.
+//
+// Process-wide. The default comes from NEXUS_TENSOR_MEMORY, in the format
+// parse() accepts, e.g. "pages=huge,numa=interleave,threshold=8M"; an
+// invalid value is reported on stderr and the defaults are kept.
+struct LargeBlockPolicy {
+    enum class Pages : uint8_t { NORMAL, TRANSPARENT, EXPLICIT };
+    enum class Placement : uint8_t { LOCAL, INTERLEAVE, BIND };
+
+    size_t threshold = size_t(2) << 20;
+    Pages pages = Pages::TRANSPARENT;
+    Placement placement = Placement::LOCAL;
+    unsigned node = 0;  // For BIND
+
+    // Comma-separated key=value pairs: pages=off|thp|huge,
+    // numa=local|interleave|<node>, threshold=<bytes>[K|M|G].
+    // Throws std::invalid_argument.
+    static LargeBlockPolicy parse(const std::string& spec);
+};
+
+// Caching allocator behind every tensor and unboxed double array. Requests
+// up to MAX_CLASS_BYTES are rounded up to a power-of-two size class (64
+// bytes and up), larger ones to whole pages, so a 600 MB tensor takes
+// 600 MB rather than 1 GB; blocks are served 64-byte aligned. Freed blocks
+// go onto the calling thread's free list for their class (or its list of
+// page-granular blocks, matched by size) instead of back to the system.
+// Tensor arithmetic allocates the same few sizes over and over, so after the
+// first pass of a training loop every buffer comes from a free list. A block
+// may be freed on a different thread from the one that allocated it (forks
+// share tensors); it simply joins the freeing thread's cache.
+//
+// Each thread caches at most getCacheLimit() bytes; beyond that blocks are
+// returned to the system. A thread's cache is released when it exits.
+// Statistics are kept per thread and summed by getStats, so the hot path
+// performs no atomic read-modify-write.
+class TensorMemory {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr size_t MIN_CLASS_BYTES = 64;
+    static constexpr size_t MAX_CLASS_BYTES = size_t(2) << 20;  // Default large-block threshold
+    static constexpr size_t PAGE_BYTES = 4096;
+    static constexpr size_t DEFAULT_CACHE_LIMIT = size_t(256) << 20;
+
+    static void* allocate(size_t bytes);
+    static void release(void* block, size_t bytes);
+
+    // Returns the calling thread's cached blocks to the system
+    static void trim();
+
+    static void setCacheLimit(size_t bytes);
+    static size_t getCacheLimit();
+
+    // Applies to blocks taken from the system after the call
+    static void setLargeBlockPolicy(const LargeBlockPolicy& policy);
+    static LargeBlockPolicy getLargeBlockPolicy();
+
+    static TensorAllocatorStats getStats();
+    static void printStats(std::ostream& out);
+};
+
+// Standard allocator adaptor over TensorMemory
+template <typename T>
+struct TensorAllocator {
+    using value_type = T;
+
+    TensorAllocator() noexcept = default;
+    template <typename U>
+    TensorAllocator(const TensorAllocator<U>&) noexcept {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(TensorMemory::allocate(count * sizeof(T)));
+    }
+    void deallocate(T* block, size_t count) noexcept {
+        TensorMemory::release(block, count * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const TensorAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const TensorAllocator<U>&) const noexcept { return false; }
+};
+
+// Element storage of tensors and unboxed double arrays
+using TensorBuffer = std::vector<double, TensorAllocator<double>>;
@@ -4,18 +4,29 @@
 #include <vector>
 #include <map>
 #include <memory>
-#include <variant>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
 #include <functional>
+#include "shape.h"
+#include "heap_account.h"
+#include "scratch_arena.h"
+#include "tensor_allocator.h"
 
 // Forward declarations
 class NexusInterpreter;
 class Environment;
+class Value;
 
 // Value types enumeration
 enum class ValueType {
     NIL,
     BOOLEAN,
     NUMBER,
+    INTEGER,
     STRING,
     ARRAY,
     OBJECT,
@@ -27,13 +38,52 @@ enum class ValueType {
     DATASET
 };
 
+// Non-owning view over call arguments, usually a window of the interpreter's
+// value stack. Element access is defined after Value.
+class ArgSpan {
+private:
+    const Value* first;
+    size_t count;
+    
+public:
+    ArgSpan() : first(nullptr), count(0) {}
+    ArgSpan(const Value* data, size_t size) : first(data), count(size) {}
+    ArgSpan(const std::vector<Value>& values);
+    
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const Value* data() const { return first; }
+    const Value* begin() const { return first; }
+    const Value* end() const;
+    const Value& operator[](size_t index) const;
+    std::vector<Value> toVector() const;
+};
+
+// Element storage chosen for an array: unboxed while it only holds numbers
+enum class ArrayKind {
+    INTEGERS,
+    DOUBLES,
+    GENERIC
+};
+
 // Function signature for callable objects
-using NativeFunction = std::function<class Value(const std::vector<class Value>&)>;
+using NativeFunction = std::function<Value(ArgSpan)>;
+using ValueCopier = std::function<Value(const Value&)>;
+
+// Borrowed run of tensor elements; stride is 1 for rows and the row length
+// for columns. Valid while the tensor is alive and not reshaped.
+struct TensorRowView {
+    const double* data;
+    size_t length;
+    size_t stride;
+    
+    double operator[](size_t index) const { return data[index * stride]; }
+};
 
 // Tensor class for ML operations
 class Tensor {
 private:
-    std::vector<double> data;
+    TensorBuffer data;  // Pooled, 64-byte aligned
     std::vector<size_t> shape;
     size_t totalSize;
     
@@ -41,6 +91,7 @@ public:
     Tensor();
     Tensor(const std::vector<size_t>& shape);
     Tensor(const std::vector<size_t>& shape, const std::vector<double>& data);
+    Tensor(const std::vector<size_t>& shape, TensorBuffer&& data);  // Adopts the buffer
     Tensor(const std::vector<std::vector<double>>& matrix);
     
     // Shape operations
@@ -54,12 +105,20 @@ public:
     const double& operator[](size_t index) const { return data[index]; }
     double& at(const std::vector<size_t>& indices);
     const double& at(const std::vector<size_t>& indices) const;
+    double* rawData() { return data.data(); }  // Contiguous, row-major
+    const double* rawData() const { return data.data(); }
+    TensorRowView row(size_t index) const;     // Slice along the first dimension
+    TensorRowView column(size_t index) const;  // Rank 2 only
     
     // Mathematical operations
     Tensor operator+(const Tensor& other) const;
     Tensor operator-(const Tensor& other) const;
     Tensor operator*(const Tensor& other) const;  // Element-wise
     Tensor operator/(const Tensor& other) const;
+    Tensor& operator+=(const Tensor& other);      // Element-wise, in place;
+    Tensor& operator-=(const Tensor& other);      // shapes must match
+    Tensor& operator*=(const Tensor& other);
+    Tensor& operator/=(const Tensor& other);
     Tensor matmul(const Tensor& other) const;     // Matrix multiplication
     Tensor transpose() const;
     Tensor sum(int axis = -1) const;
@@ -78,47 +137,112 @@ private:
     void calculateTotalSize();
 };
 
+// In-place element-wise operations
+inline Tensor& Tensor::operator+=(const Tensor& other) {
+    if (shape != other.shape) throw std::invalid_argument("Tensor shapes do not match");
+    for (size_t i = 0; i < totalSize; ++i) data[i] += other.data[i];
+    return *this;
+}
+inline Tensor& Tensor::operator-=(const Tensor& other) {
+    if (shape != other.shape) throw std::invalid_argument("Tensor shapes do not match");
+    for (size_t i = 0; i < totalSize; ++i) data[i] -= other.data[i];
+    return *this;
+}
+inline Tensor& Tensor::operator*=(const Tensor& other) {
+    if (shape != other.shape) throw std::invalid_argument("Tensor shapes do not match");
+    for (size_t i = 0; i < totalSize; ++i) data[i] *= other.data[i];
+    return *this;
+}
+inline Tensor& Tensor::operator/=(const Tensor& other) {
+    if (shape != other.shape) throw std::invalid_argument("Tensor shapes do not match");
+    for (size_t i = 0; i < totalSize; ++i) data[i] /= other.data[i];
+    return *this;
+}
+
+inline TensorRowView Tensor::row(size_t index) const {
+    if (shape.empty() || index >= shape[0]) throw std::out_of_range("Tensor row out of bounds");
+    size_t length = totalSize / shape[0];
+    return {data.data() + index * length, length, 1};
+}
+
+inline TensorRowView Tensor::column(size_t index) const {
+    if (shape.size() != 2 || index >= shape[1]) throw std::out_of_range("Tensor column out of bounds");
+    return {data.data() + index, shape[0], shape[1]};
+}
+
 // Callable interface for functions and methods
 class Callable {
 public:
     virtual ~Callable() = default;
-    virtual Value call(NexusInterpreter& interpreter, const std::vector<Value>& arguments) = 0;
+    virtual Value call(NexusInterpreter& interpreter, ArgSpan arguments) = 0;
     virtual std::string toString() const = 0;
     virtual size_t arity() const = 0;
 };
 
-// Native function wrapper
+// State shared by the methods of one builtin object (a StringBuilder's
+// buffer, a Map's entries). A forked interpreter gets its own copy, made in
+// two steps so a state reachable from its own values is copied once: blank()
+// makes the empty copy, copyInto() fills it with values passed through copy.
+class NativeState {
+public:
+    virtual ~NativeState() = default;
+    virtual std::shared_ptr<NativeState> blank() const = 0;
+    virtual void copyInto(NativeState& target, const ValueCopier& copy) const = 0;
+};
+
+// Native function wrapper. A method over a NativeState keeps the binder that
+// made its function from the state, so it can be rebound to a copy.
 class NativeCallable : public Callable {
+public:
+    using Binder = std::function<NativeFunction(const std::shared_ptr<NativeState>&)>;
+
 private:
     NativeFunction function;
     size_t paramCount;
     std::string name;
+    std::shared_ptr<NativeState> state;  // Null unless made with a binder
+    Binder binder;
     
 public:
     NativeCallable(const std::string& n, size_t params, NativeFunction fn)
         : function(fn), paramCount(params), name(n) {}
+    NativeCallable(const std::string& n, size_t params, std::shared_ptr<NativeState> s, Binder b)
+        : function(b(s)), paramCount(params), name(n), state(std::move(s)), binder(std::move(b)) {}
         
-    Value call(NexusInterpreter& interpreter, const std::vector<Value>& arguments) override;
+    Value call(NexusInterpreter& interpreter, ArgSpan arguments) override;
     std::string toString() const override { return "<native fn " + name + ">"; }
     size_t arity() const override { return paramCount; }
+    
+    const std::shared_ptr<NativeState>& getState() const { return state; }
+    // The same method over other, a state of the same type
+    std::shared_ptr<NativeCallable> rebind(std::shared_ptr<NativeState> other) const {
+        return std::make_shared<NativeCallable>(name, paramCount, std::move(other), binder);
+    }
 };
 
-// Main Value class with optimized storage
+struct HeapObject;
+struct PropertyObject;
+
+// Main Value class: a single NaN-boxed 64-bit word. Numbers are stored as
+// plain doubles; everything else lives in the quiet-NaN space, either as an
+// immediate (nil, booleans, 48-bit integers) or as a 48-bit pointer to a
+// refcounted HeapObject. Integers outside the 48-bit range are boxed.
 class Value {
 private:
-    ValueType type_;
-    
-    // Optimized storage using variant
-    std::variant<
-        std::nullptr_t,           // NIL
-        bool,                     // BOOLEAN
-        double,                   // NUMBER
-        std::string,              // STRING
-        std::vector<Value>,       // ARRAY
-        std::map<std::string, Value>, // OBJECT
-        std::shared_ptr<Callable>, // FUNCTION
-        std::shared_ptr<Tensor>   // TENSOR
-    > data_;
+    uint64_t bits_;
+    
+    static constexpr uint64_t SIGN_BIT     = 0x8000000000000000ULL;
+    static constexpr uint64_t QNAN         = 0x7FFC000000000000ULL;
+    static constexpr uint64_t PAYLOAD_MASK = 0x0000FFFFFFFFFFFFULL;
+    static constexpr uint64_t TAG_NIL      = QNAN | 1;
+    static constexpr uint64_t TAG_FALSE    = QNAN | 2;
+    static constexpr uint64_t TAG_TRUE     = QNAN | 3;
+    static constexpr uint64_t TAG_HEAP     = SIGN_BIT | QNAN;
+    static constexpr uint64_t TAG_INT      = QNAN | 0x0001000000000000ULL;
+    static constexpr uint64_t TAG_MASK     = 0xFFFF000000000000ULL;
+    static constexpr int64_t SMALL_INT_MIN = -(int64_t(1) << 47);
+    static constexpr int64_t SMALL_INT_MAX = (int64_t(1) << 47) - 1;
+    static constexpr uint64_t CANONICAL_NAN = 0x7FF8000000000000ULL;
     
 public:
     // Constructors
@@ -126,11 +250,15 @@ public:
     Value(std::nullptr_t);
     Value(bool value);
     Value(int value);
+    Value(int64_t value);
     Value(double value);
     Value(const std::string& value);
+    Value(std::string&& value);
     Value(const char* value);
     Value(const std::vector<Value>& value);
+    Value(std::vector<Value>&& value);
     Value(const std::map<std::string, Value>& value);
+    Value(std::map<std::string, Value>&& value);
     Value(std::shared_ptr<Callable> value);
     Value(std::shared_ptr<Tensor> value);
     Value(const Tensor& value);
@@ -144,44 +272,76 @@ public:
     Value& operator=(Value&& other) noexcept;
     
     // Destructor
-    ~Value() = default;
+    ~Value();
     
     // Type checking
-    ValueType getType() const { return type_; }
-    bool isNil() const { return type_ == ValueType::NIL; }
-    bool isBoolean() const { return type_ == ValueType::BOOLEAN; }
-    bool isNumber() const { return type_ == ValueType::NUMBER; }
-    bool isString() const { return type_ == ValueType::STRING; }
-    bool isArray() const { return type_ == ValueType::ARRAY; }
-    bool isObject() const { return type_ == ValueType::OBJECT; }
-    bool isFunction() const { return type_ == ValueType::FUNCTION; }
-    bool isTensor() const { return type_ == ValueType::TENSOR; }
+    ValueType getType() const;
+    bool isNil() const { return bits_ == TAG_NIL; }
+    bool isBoolean() const { return (bits_ | 1) == TAG_TRUE; }
+    bool isNumber() const { return isDouble() || isInteger(); }
+    bool isInteger() const { return isSmallInt() || isHeapType(ValueType::INTEGER); }
+    bool isString() const { return isHeapType(ValueType::STRING); }
+    bool isArray() const { return isHeapType(ValueType::ARRAY); }
+    bool isObject() const { return isHeapType(ValueType::OBJECT); }
+    bool isFunction() const { return isHeapType(ValueType::FUNCTION); }
+    bool isTensor() const { return isHeapType(ValueType::TENSOR); }
     bool isCallable() const { return isFunction(); }
     
     // Type conversion
     bool asBool() const;
     double asNumber() const;
+    int64_t asInteger() const;
     std::string asString() const;
+    // Read-only container views, on const and non-const Values alike. The
+    // mutable forms unshare the payload (an O(n) clone while it is shared),
+    // so they are only for call sites that really write through them.
     const std::vector<Value>& asArray() const;
-    std::vector<Value>& asArray();
     const std::map<std::string, Value>& asObject() const;
-    std::map<std::string, Value>& asObject();
+    std::vector<Value>& mutableArray();
+    std::map<std::string, Value>& mutableObject();
     std::shared_ptr<Callable> asCallable() const;
-    std::shared_ptr<Tensor> asTensor() const;
+    std::shared_ptr<Tensor> asTensor() const;  // Shared storage: read only
+    Tensor& mutableTensor();  // Copies storage that another value (or a fork) shares
+    
+    // Object properties without going through the std::map view
+    const Value* findProperty(const std::string& name) const;  // nullptr if absent
+    void setProperty(const std::string& name, Value value);
+    bool removeProperty(const std::string& name);
+    Shape* getShape() const;  // nullptr for dictionary-mode objects and non-objects
+    const Value& slotAt(uint32_t slot) const;  // Raw slot access for inline caches
+    Value& slotAt(uint32_t slot);
+    void appendSlot(Shape* next, Value value);  // Cached transition adding one property
+    
+    // Identity: both refer to the same payload (or are the same immediate)
+    bool isSameObject(const Value& other) const { return bits_ == other.bits_; }
     
     // Safe conversion with default values
     bool toBool(bool defaultValue = false) const;
     double toNumber(double defaultValue = 0.0) const;
     std::string toString(const std::string& defaultValue = "") const;
     
-    // Arithmetic operations
-    Value operator+(const Value& other) const;
-    Value operator-(const Value& other) const;
-    Value operator*(const Value& other) const;
-    Value operator/(const Value& other) const;
+    // Arithmetic operations. The && overloads are picked for temporaries and
+    // write into this operand's string or tensor buffer when it is the only
+    // owner, so 'a + b + c' allocates one result
+    Value operator+(const Value& other) const&;
+    Value operator-(const Value& other) const&;
+    Value operator*(const Value& other) const&;
+    Value operator/(const Value& other) const&;
+    Value operator+(const Value& other) &&;
+    Value operator-(const Value& other) &&;
+    Value operator*(const Value& other) &&;
+    Value operator/(const Value& other) &&;
     Value operator%(const Value& other) const;
     Value operator-() const;  // Unary minus
     
+    // Bitwise operations (integers only, never via floating point)
+    Value operator&(const Value& other) const;
+    Value operator|(const Value& other) const;
+    Value operator^(const Value& other) const;
+    Value operator~() const;
+    Value operator<<(const Value& other) const;
+    Value operator>>(const Value& other) const;
+    
     // Comparison operations
     bool operator==(const Value& other) const;
     bool operator!=(const Value& other) const;
@@ -203,12 +363,26 @@ public:
     bool has(const Value& key) const;
     size_t length() const;
     
+    // Array element access that keeps unboxed arrays unboxed
+    size_t arraySize() const;
+    Value elementAt(int64_t index) const;
+    void setElement(int64_t index, Value value);
+    void pushElement(Value value);
+    ArrayKind getArrayKind() const;
+    const double* doubleData() const;  // nullptr unless the array is unboxed doubles
+    const int64_t* integerData() const;  // nullptr unless the array is unboxed integers
+    std::shared_ptr<Tensor> toTensor() const&;
+    std::shared_ptr<Tensor> toTensor() &&;  // Adopts an unshared double buffer
+    
     // Utility methods
     std::string getTypeString() const;
     bool isTruthy() const;
     bool isFalsy() const;
     Value deepCopy() const;
-    size_t hash() const;
+    Value convertToInteger(int bitWidth = 64) const;  // Narrowing for int/long/short/byte
+    size_t hash() const;  // Consistent with ==: 2 and 2.0 hash alike
+    bool sharesPayload() const;  // Another Value holds the same heap payload
+    size_t externalBytes() const;  // Tensor storage owned by this payload alone
     
     // ML-specific operations
     Value dot(const Value& other) const;      // Tensor dot product
@@ -216,30 +390,24 @@ public:
     Value transpose() const;                  // Matrix transpose
     Value reshape(const std::vector<size_t>& shape) const;
     
-    // Iteration support
-    class Iterator {
-    private:
-        const Value* value_;
-        size_t index_;
-        
-    public:
-        Iterator(const Value* v, size_t idx) : value_(v), index_(idx) {}
-        
-        Value operator*() const;
-        Iterator& operator++();
-        bool operator!=(const Iterator& other) const;
-    };
-    
+    // Borrowing iteration; see Value::Iterator below
+    class Iterator;
     Iterator begin() const;
     Iterator end() const;
+    size_t iterationLength() const;
     
     // Static factory methods
     static Value nil();
     static Value boolean(bool value);
     static Value number(double value);
+    static Value integer(int64_t value);
+    static Value fromNumberLiteral(const std::string& text);
     static Value string(const std::string& value);
     static Value array(const std::vector<Value>& elements = {});
+    static Value numberArray(TensorBuffer elements);
+    static Value integerArray(std::vector<int64_t> elements);
     static Value object(const std::map<std::string, Value>& properties = {});
+    static Value emptyObject();  // Starts at the root shape; fill with setProperty
     static Value tensor(const std::vector<size_t>& shape);
     static Value tensor(const std::vector<std::vector<double>>& matrix);
     
@@ -248,17 +416,1235 @@ public:
     static Value deserialize(const std::string& data);
     
 private:
+    // Boxing helpers
+    bool isDouble() const { return (bits_ & QNAN) != QNAN; }
+    bool isHeap() const { return (bits_ & TAG_HEAP) == TAG_HEAP; }
+    bool isHeapType(ValueType type) const;
+    bool isSmallInt() const { return (bits_ & TAG_MASK) == TAG_INT; }
+    int64_t unboxSmallInt() const { return static_cast<int64_t>(bits_ << 16) >> 16; }
+    HeapObject* heapObject() const { return reinterpret_cast<HeapObject*>(bits_ & PAYLOAD_MASK); }
+    void setHeapObject(HeapObject* object);  // Takes ownership of a new payload
+    double unboxDouble() const;
+    static int64_t integralDouble(double value);  // Throws unless exact
+    static size_t hashNumber(double value);  // Whole numbers hash like the equal integer
+    static size_t hashCombine(size_t seed, size_t value);
+    void retainPayload();
+    void releasePayload();
+    void ensureUnique();  // Copy-on-write: detach a shared payload before mutation
+    
+    // Overflow-checked int64 arithmetic; false when the result does not fit
+    static bool addInt64(int64_t a, int64_t b, int64_t& result);
+    static bool subInt64(int64_t a, int64_t b, int64_t& result);
+    static bool mulInt64(int64_t a, int64_t b, int64_t& result);
+    
     // Helper methods
-    void setType(ValueType type);
     void validateType(ValueType expected) const;
     std::string formatValue() const;
     
     // Type-specific helpers
     double compareNumbers(const Value& other) const;
     std::string concatenateStrings(const Value& other) const;
+    Value concatenateRope(const Value& other) const;  // Both operands are strings
+    bool updateInPlace(const Value& other, char op);  // false when a copy is needed
+    static const Value& character(unsigned char c);   // Interned one-byte strings
+    static Value tensorRow(const std::shared_ptr<Tensor>& tensor, size_t row);
     Value performArithmetic(const Value& other, char op) const;
 };
 
+static_assert(sizeof(Value) == 8, "Value must stay a single NaN-boxed word");
+
+// Borrowing iteration over arrays, strings, objects (property values)
+// and tensors (elements of rank 1, row views otherwise). operator*
+// returns a reference that stays valid until the iterator advances:
+// stored elements are referenced in place and produced ones (unboxed
+// numbers, characters, rows) are built without copying any payload.
+// The iterated value must outlive the iterator and not be mutated; objects
+// are walked in the representation they had when iteration began. A row
+// view still referenced elsewhere when the iterator moves on gets its own
+// copy of the row, so an escaped row does not alias the tensor.
+class Value::Iterator {
+private:
+    const Value* value_;
+    size_t index_;
+    mutable Value current_;  // Element produced by the last dereference
+    const Shape* shape_ = nullptr;  // Objects: shape at construction, null in dictionary mode
+    std::map<std::string, Value>::const_iterator entry_;  // Dictionary-mode objects
+    
+    const PropertyObject* properties() const;
+    void detachRow();
+    
+public:
+    Iterator(const Value* v, size_t idx);
+    Iterator(const Iterator&) = default;
+    Iterator& operator=(const Iterator&) = default;
+    ~Iterator();
+    
+    const Value& operator*() const;
+    Iterator& operator++();
+    bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+    const std::string& key() const;  // Property name when iterating an object
+};
+
+inline MemoryCategory memoryCategory(ValueType type) {
+    switch (type) {
+        case ValueType::STRING: return MemoryCategory::STRINGS;
+        case ValueType::ARRAY: return MemoryCategory::ARRAYS;
+        case ValueType::OBJECT: return MemoryCategory::OBJECTS;
+        case ValueType::TENSOR: return MemoryCategory::TENSORS;
+        default: return MemoryCategory::OTHER;
+    }
+}
+
+// Heap payloads for boxed values. Refcounts are not atomic: a Value is owned
+// by one interpreter and never shared across threads. Payloads created while
+// a statement runs come from the statement's scratch arena, and each one is
+// charged to its interpreter's HeapAccount for footprint() bytes.
+struct HeapObject {
+    uint32_t refCount = 1;
+    ValueType type;
+    HeapAccount* account = nullptr;  // Null when created outside an interpreter
+    size_t charged = 0;
+    
+    explicit HeapObject(ValueType t) : type(t) {}
+    virtual ~HeapObject() {
+        if (account) account->credit(memoryCategory(type), charged);
+    }
+    virtual HeapObject* clone() const = 0;
+    
+    // Bytes held: the object and the buffers it owns exclusively
+    virtual size_t footprint() const = 0;
+    
+    // Charges a new payload to the running interpreter
+    void open() {
+        account = HeapAccount::active();
+        recharge();
+    }
+    // Brings the charge up to date after the payload grew or shrank; throws
+    // HeapLimitError past the interpreter's limit
+    virtual void recharge() {
+        if (!account) return;
+        size_t previous = charged;
+        charged = footprint();
+        if (charged != previous) account->adjust(memoryCategory(type), previous, charged);
+    }
+    
+    static void* operator new(size_t bytes) { return ScratchArena::allocate(bytes); }
+    static void operator delete(void* block) noexcept { ScratchArena::release(block); }
+};
+
+// A string is either flat text or a rope node that only records the two
+// halves of a long concatenation. Ropes are flattened into chars the first
+// time the text is read (indexing, comparison, printing), so a loop of
+// 's = s + piece' costs linear rather than quadratic time.
+struct StringObject : HeapObject {
+    // Shorter concatenations are copied eagerly; ropes pay off above this
+    static constexpr size_t ROPE_MIN_LENGTH = 256;
+    
+    std::string chars;
+    StringObject* left = nullptr;   // Rope halves (retained), null once flat
+    StringObject* right = nullptr;
+    size_t length;
+    size_t hashCode = 0;            // Cached by hash(); cleared by in-place appends
+    bool hashed = false;
+    
+    explicit StringObject(std::string s)
+        : HeapObject(ValueType::STRING), chars(std::move(s)), length(chars.size()) {}
+    StringObject(StringObject* l, StringObject* r)
+        : HeapObject(ValueType::STRING), left(l), right(r), length(l->length + r->length) {
+        l->refCount++;
+        r->refCount++;
+    }
+    ~StringObject() override { releaseChildren(); }
+    HeapObject* clone() const override { return new StringObject(const_cast<StringObject*>(this)->flat()); }
+    size_t footprint() const override { return sizeof(StringObject) + chars.capacity(); }
+    
+    bool isRope() const { return left != nullptr; }
+    const std::string& flat() { flatten(); return chars; }
+    size_t hash() {
+        if (!hashed) {
+            hashCode = std::hash<std::string>()(flat());
+            hashed = true;
+        }
+        return hashCode;
+    }
+    
+    // Walks the leaves with an explicit stack: a rope built by repeated
+    // appends is as deep as the number of appends
+    void flatten() {
+        if (!isRope()) return;
+        std::string result;
+        result.reserve(length);
+        std::vector<const StringObject*> pending{right, left};
+        while (!pending.empty()) {
+            const StringObject* node = pending.back();
+            pending.pop_back();
+            if (node->isRope()) {
+                pending.push_back(node->right);
+                pending.push_back(node->left);
+            } else {
+                result += node->chars;
+            }
+        }
+        chars = std::move(result);
+        releaseChildren();
+        recharge();
+    }
+    
+    // Iterative for the same reason; nodes whose count drops to zero are
+    // detached from their children before being deleted
+    void releaseChildren() {
+        std::vector<StringObject*> dead;
+        auto drop = [&dead](StringObject* node) {
+            if (node && --node->refCount == 0) dead.push_back(node);
+        };
+        drop(left);
+        drop(right);
+        left = right = nullptr;
+        while (!dead.empty()) {
+            StringObject* node = dead.back();
+            dead.pop_back();
+            drop(node->left);
+            drop(node->right);
+            node->left = node->right = nullptr;
+            delete node;
+        }
+    }
+};
+
+// Array payload. Arrays holding only integers or only numbers store raw
+// int64/double elements; the first store of anything else boxes them once
+// into a generic Value vector. Ints stored into a double array are widened.
+struct ArrayObject : HeapObject {
+    ArrayKind kind;
+    std::vector<int64_t> integers;
+    TensorBuffer doubles;  // Same storage as tensors, so toTensor() can adopt it
+    std::vector<Value> elements;
+    
+    // Boxed image of an unboxed array for the read-only asArray() view, built
+    // on demand so reading never changes the representation; dropped by
+    // every write. Not charged, like PropertyObject::view.
+    mutable std::vector<Value> boxed;
+    mutable bool boxedValid = false;
+    
+    ArrayObject() : HeapObject(ValueType::ARRAY), kind(ArrayKind::INTEGERS) {}
+    explicit ArrayObject(std::vector<Value> e) : HeapObject(ValueType::ARRAY), kind(ArrayKind::INTEGERS) {
+        bool exact = true;  // Every integer survives a round trip through double
+        for (const Value& v : e) {
+            if (!v.isNumber()) {
+                kind = ArrayKind::GENERIC;
+                elements = std::move(e);
+                return;
+            }
+            if (!v.isInteger()) kind = ArrayKind::DOUBLES;
+            else exact = exact && exactDouble(v.asInteger());
+        }
+        if (kind == ArrayKind::DOUBLES && !exact) {
+            kind = ArrayKind::GENERIC;
+            elements = std::move(e);
+            return;
+        }
+        if (kind == ArrayKind::INTEGERS) {
+            integers.reserve(e.size());
+            for (const Value& v : e) integers.push_back(v.asInteger());
+        } else {
+            doubles.reserve(e.size());
+            for (const Value& v : e) doubles.push_back(v.asNumber());
+        }
+    }
+    explicit ArrayObject(TensorBuffer d)
+        : HeapObject(ValueType::ARRAY), kind(ArrayKind::DOUBLES), doubles(std::move(d)) {}
+    explicit ArrayObject(std::vector<int64_t> i)
+        : HeapObject(ValueType::ARRAY), kind(ArrayKind::INTEGERS), integers(std::move(i)) {}
+    HeapObject* clone() const override {
+        auto copy = new ArrayObject();
+        copy->kind = kind;
+        copy->integers = integers;
+        copy->doubles = doubles;
+        copy->elements = elements;
+        return copy;
+    }
+    size_t footprint() const override {
+        return sizeof(ArrayObject) + integers.capacity() * sizeof(int64_t) +
+               doubles.capacity() * sizeof(double) + elements.capacity() * sizeof(Value);
+    }
+    
+    size_t size() const {
+        switch (kind) {
+            case ArrayKind::INTEGERS: return integers.size();
+            case ArrayKind::DOUBLES: return doubles.size();
+            default: return elements.size();
+        }
+    }
+    
+    Value get(size_t index) const {
+        switch (kind) {
+            case ArrayKind::INTEGERS: return Value(integers[index]);
+            case ArrayKind::DOUBLES: return Value(doubles[index]);
+            default: return elements[index];
+        }
+    }
+    
+    void set(size_t index, Value value) {
+        invalidateView();
+        if (accept(value)) {
+            if (kind == ArrayKind::INTEGERS) integers[index] = value.asInteger();
+            else doubles[index] = value.asNumber();
+        } else {
+            elements[index] = std::move(value);
+        }
+    }
+    
+    void push(Value value) {
+        invalidateView();
+        if (accept(value)) {
+            if (kind == ArrayKind::INTEGERS) integers.push_back(value.asInteger());
+            else doubles.push_back(value.asNumber());
+        } else {
+            elements.push_back(std::move(value));
+        }
+    }
+    
+    // Transitions the storage so it can hold value; true if it stays unboxed.
+    // Doubles hold integers only up to 2^53, so an integer that would lose
+    // bits, or a switch to doubles that would round stored integers, boxes
+    // the array instead.
+    bool accept(const Value& value) {
+        if (kind == ArrayKind::GENERIC) return false;
+        if (!value.isNumber() || (kind == ArrayKind::DOUBLES && value.isInteger() && !exactDouble(value.asInteger()))) {
+            makeGeneric();
+            return false;
+        }
+        if (kind == ArrayKind::INTEGERS && !value.isInteger()) {
+            for (int64_t i : integers) {
+                if (!exactDouble(i)) {
+                    makeGeneric();
+                    return false;
+                }
+            }
+            doubles.reserve(integers.size() + 1);
+            for (int64_t i : integers) doubles.push_back(static_cast<double>(i));
+            integers = std::vector<int64_t>();
+            kind = ArrayKind::DOUBLES;
+        }
+        return true;
+    }
+    
+    void makeGeneric() {
+        if (kind == ArrayKind::GENERIC) return;
+        invalidateView();
+        elements.reserve(size());
+        if (kind == ArrayKind::INTEGERS) {
+            for (int64_t i : integers) elements.emplace_back(i);
+            integers = std::vector<int64_t>();
+        } else {
+            for (double d : doubles) elements.emplace_back(d);
+            doubles = TensorBuffer();
+        }
+        kind = ArrayKind::GENERIC;
+    }
+    
+    const std::vector<Value>& view() const {
+        if (kind == ArrayKind::GENERIC) return elements;
+        if (!boxedValid) {
+            boxed.reserve(size());
+            for (size_t i = 0; i < size(); ++i) boxed.push_back(get(i));
+            boxedValid = true;
+        }
+        return boxed;
+    }
+    void invalidateView() {
+        if (!boxedValid) return;
+        boxed = std::vector<Value>();
+        boxedValid = false;
+    }
+    
+    static bool exactDouble(int64_t value) {
+        double converted = static_cast<double>(value);
+        return converted < 9223372036854775808.0 && static_cast<int64_t>(converted) == value;
+    }
+};
+
+// Object payload. Objects built with the same property sequence share a
+// Shape and keep their values in a contiguous slot array. Objects with many
+// or unpredictable keys, or whose map was handed out for writing, switch to
+// dictionary mode (shape == nullptr) and stay there.
+struct PropertyObject : HeapObject {
+    Shape* shape;
+    std::vector<Value> slots;
+    std::map<std::string, Value> dictionary;
+    
+    // Map image of a shaped object for the read-only asObject() view, built
+    // on demand so reading never changes the representation; dropped by
+    // every write. It only holds extra handles, so it is not charged (the
+    // collector counts them as outside references until the next write).
+    mutable std::map<std::string, Value> view;
+    mutable bool viewValid = false;
+    
+    PropertyObject() : HeapObject(ValueType::OBJECT), shape(Shape::root()) {}
+    explicit PropertyObject(std::map<std::string, Value> properties)
+        : HeapObject(ValueType::OBJECT), shape(Shape::root()) {
+        if (properties.size() > Shape::MAX_SLOTS) {
+            shape = nullptr;
+            dictionary = std::move(properties);
+            return;
+        }
+        slots.reserve(properties.size());
+        for (auto& entry : properties) set(entry.first, std::move(entry.second));
+    }
+    HeapObject* clone() const override {
+        auto copy = new PropertyObject();
+        copy->shape = shape;
+        copy->slots = slots;
+        copy->dictionary = dictionary;
+        return copy;
+    }
+    // Map nodes are estimated at three pointers and a colour word each
+    size_t footprint() const override {
+        return sizeof(PropertyObject) + slots.capacity() * sizeof(Value) +
+               dictionary.size() * (sizeof(std::pair<const std::string, Value>) + 4 * sizeof(void*));
+    }
+    
+    const Value* find(const std::string& key) const {
+        if (shape) {
+            int32_t slot = shape->lookup(key);
+            return slot < 0 ? nullptr : &slots[static_cast<size_t>(slot)];
+        }
+        auto it = dictionary.find(key);
+        return it == dictionary.end() ? nullptr : &it->second;
+    }
+    
+    void set(const std::string& key, Value value) {
+        invalidateView();
+        if (shape) {
+            int32_t slot = shape->lookup(key);
+            if (slot >= 0) {
+                slots[static_cast<size_t>(slot)] = std::move(value);
+                return;
+            }
+            if (Shape* next = shape->addProperty(key)) {
+                shape = next;
+                slots.push_back(std::move(value));
+                return;
+            }
+            normalize();
+        }
+        dictionary[key] = std::move(value);
+    }
+    
+    bool remove(const std::string& key) {
+        normalize();
+        return dictionary.erase(key) > 0;
+    }
+    
+    size_t size() const { return shape ? slots.size() : dictionary.size(); }
+    
+    const std::map<std::string, Value>& properties() const {
+        if (!shape) return dictionary;
+        if (!viewValid) {
+            const std::vector<std::string>& keys = shape->getKeys();
+            for (size_t i = 0; i < keys.size(); ++i) view.emplace(keys[i], slots[i]);
+            viewValid = true;
+        }
+        return view;
+    }
+    void invalidateView() {
+        if (!viewValid) return;
+        view.clear();
+        viewValid = false;
+    }
+    
+    // Switch to dictionary mode, moving the slot values into the map
+    void normalize() {
+        if (!shape) return;
+        invalidateView();
+        const std::vector<std::string>& keys = shape->getKeys();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            dictionary.emplace(keys[i], std::move(slots[i]));
+        }
+        slots.clear();
+        shape = nullptr;
+    }
+};
+
+struct IntegerObject : HeapObject {
+    int64_t value;
+    explicit IntegerObject(int64_t v) : HeapObject(ValueType::INTEGER), value(v) {}
+    HeapObject* clone() const override { return new IntegerObject(value); }
+    size_t footprint() const override { return sizeof(IntegerObject); }
+};
+
+struct CallableObject : HeapObject {
+    std::shared_ptr<Callable> callable;
+    explicit CallableObject(std::shared_ptr<Callable> c)
+        : HeapObject(ValueType::FUNCTION), callable(std::move(c)) {}
+    HeapObject* clone() const override { return new CallableObject(callable); }
+    size_t footprint() const override { return sizeof(CallableObject); }
+};
+
+// A tensor, or a row view that borrows one row of base (sharing its storage,
+// which mutableTensor() then copies before writing) until something needs a
+// standalone Tensor.
+// The tensor's storage is charged through the account's per-tensor handle
+// count, so values sharing a tensor pay for it once; views pay nothing.
+struct TensorObject : HeapObject {
+    std::shared_ptr<Tensor> tensor;  // Null while this is an unmaterialized view
+    std::shared_ptr<Tensor> base;
+    size_t row = 0;
+    const Tensor* held = nullptr;    // Tensor whose storage this object is charged for
+    
+    explicit TensorObject(std::shared_ptr<Tensor> t)
+        : HeapObject(ValueType::TENSOR), tensor(std::move(t)) {}
+    TensorObject(std::shared_ptr<Tensor> from, size_t r)
+        : HeapObject(ValueType::TENSOR), base(std::move(from)), row(r) {}
+    ~TensorObject() override {
+        if (account && held) account->releaseTensor(held);
+    }
+    HeapObject* clone() const override {
+        return new TensorObject(const_cast<TensorObject*>(this)->get());
+    }
+    size_t footprint() const override { return sizeof(TensorObject); }
+    void recharge() override {
+        HeapObject::recharge();
+        if (!account || !tensor || tensor.get() == held) return;
+        if (held) account->releaseTensor(held);
+        held = tensor.get();
+        account->holdTensor(held, tensor->getSize() * sizeof(double));
+    }
+    
+    bool isView() const { return !tensor; }
+    
+    // Copies the viewed row into its own tensor on first use
+    std::shared_ptr<Tensor>& get() {
+        if (!tensor) {
+            TensorRowView view = base->row(row);
+            std::vector<size_t> shape(base->getShape().begin() + 1, base->getShape().end());
+            tensor = std::make_shared<Tensor>(shape, TensorBuffer(view.data, view.data + view.length));
+            base.reset();
+            recharge();
+        }
+        return tensor;
+    }
+};
+
+inline size_t Value::externalBytes() const {
+    if (!isTensor()) return 0;
+    auto object = static_cast<TensorObject*>(heapObject());
+    if (object->isView() || object->tensor.use_count() != 1) return 0;  // Views borrow their base
+    return object->tensor->getSize() * sizeof(double);
+}
+
+// Construction
+inline Value::Value() : bits_(TAG_NIL) {}
+inline Value::Value(std::nullptr_t) : bits_(TAG_NIL) {}
+inline Value::Value(bool value) : bits_(value ? TAG_TRUE : TAG_FALSE) {}
+inline Value::Value(int value) : bits_(TAG_INT | (static_cast<uint64_t>(value) & PAYLOAD_MASK)) {}
+inline Value::Value(int64_t value) {
+    if (value >= SMALL_INT_MIN && value <= SMALL_INT_MAX) {
+        bits_ = TAG_INT | (static_cast<uint64_t>(value) & PAYLOAD_MASK);
+    } else {
+        setHeapObject(new IntegerObject(value));
+    }
+}
+inline Value::Value(double value) {
+    // Every NaN is folded to one pattern so it cannot alias a tagged value
+    if (std::isnan(value)) {
+        bits_ = CANONICAL_NAN;
+    } else {
+        std::memcpy(&bits_, &value, sizeof(double));
+    }
+}
+inline Value::Value(const std::string& value) { setHeapObject(new StringObject(value)); }
+inline Value::Value(std::string&& value) { setHeapObject(new StringObject(std::move(value))); }
+inline Value::Value(const char* value) { setHeapObject(new StringObject(value)); }
+inline Value::Value(const std::vector<Value>& value) { setHeapObject(new ArrayObject(value)); }
+inline Value::Value(std::vector<Value>&& value) { setHeapObject(new ArrayObject(std::move(value))); }
+inline Value::Value(const std::map<std::string, Value>& value) { setHeapObject(new PropertyObject(value)); }
+inline Value::Value(std::map<std::string, Value>&& value) { setHeapObject(new PropertyObject(std::move(value))); }
+inline Value::Value(std::shared_ptr<Callable> value) { setHeapObject(new CallableObject(std::move(value))); }
+inline Value::Value(std::shared_ptr<Tensor> value) { setHeapObject(new TensorObject(std::move(value))); }
+inline Value::Value(const Tensor& value) { setHeapObject(new TensorObject(std::make_shared<Tensor>(value))); }
+
+// Copy, move and destruction
+inline Value::Value(const Value& other) : bits_(other.bits_) {
+    if (isHeap()) retainPayload();
+}
+inline Value::Value(Value&& other) noexcept : bits_(other.bits_) {
+    other.bits_ = TAG_NIL;
+}
+inline Value& Value::operator=(const Value& other) {
+    if (this != &other) {
+        Value copy(other);
+        std::swap(bits_, copy.bits_);
+    }
+    return *this;
+}
+inline Value& Value::operator=(Value&& other) noexcept {
+    if (this != &other) {
+        if (isHeap()) releasePayload();
+        bits_ = other.bits_;
+        other.bits_ = TAG_NIL;
+    }
+    return *this;
+}
+inline Value::~Value() {
+    if (isHeap()) releasePayload();
+}
+
+// Every payload passes through here once, when it is created or cloned
+inline void Value::setHeapObject(HeapObject* object) {
+    try {
+        object->open();
+    } catch (...) {
+        delete object;
+        throw;
+    }
+    bits_ = TAG_HEAP | reinterpret_cast<uint64_t>(object);
+}
+
+// Copies share the payload. Arrays and objects keep value semantics through
+// copy-on-write: mutable access clones a payload that is still shared.
+inline void Value::retainPayload() {
+    heapObject()->refCount++;
+}
+inline void Value::releasePayload() {
+    HeapObject* object = heapObject();
+    if (--object->refCount == 0) {
+        delete object;
+    }
+}
+inline bool Value::sharesPayload() const {
+    return isHeap() && heapObject()->refCount > 1;
+}
+inline void Value::ensureUnique() {
+    HeapObject* object = heapObject();
+    if (object->refCount > 1) {
+        setHeapObject(object->clone());
+        object->refCount--;
+    }
+}
+
+// Type inspection
+inline ValueType Value::getType() const {
+    if (isDouble()) return ValueType::NUMBER;
+    if (isHeap()) return heapObject()->type;
+    if (isSmallInt()) return ValueType::INTEGER;
+    return bits_ == TAG_NIL ? ValueType::NIL : ValueType::BOOLEAN;
+}
+inline bool Value::isHeapType(ValueType type) const {
+    return isHeap() && heapObject()->type == type;
+}
+inline double Value::unboxDouble() const {
+    double value;
+    std::memcpy(&value, &bits_, sizeof(double));
+    return value;
+}
+
+// Unboxing
+inline bool Value::asBool() const {
+    if (!isBoolean()) validateType(ValueType::BOOLEAN);
+    return bits_ == TAG_TRUE;
+}
+inline double Value::asNumber() const {
+    if (isDouble()) return unboxDouble();
+    if (isInteger()) return static_cast<double>(asInteger());
+    validateType(ValueType::NUMBER);
+    return 0.0;
+}
+inline int64_t Value::asInteger() const {
+    if (isSmallInt()) return unboxSmallInt();
+    if (isHeapType(ValueType::INTEGER)) return static_cast<IntegerObject*>(heapObject())->value;
+    if (isDouble()) return integralDouble(unboxDouble());
+    validateType(ValueType::INTEGER);
+    return 0;
+}
+// A double converts only when it is a whole number that int64_t can hold;
+// 2^63 itself is the first double past the range
+inline int64_t Value::integralDouble(double value) {
+    if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0)) {
+        throw std::out_of_range("Number " + std::to_string(value) + " is out of integer range");
+    }
+    if (std::trunc(value) != value) {
+        throw std::invalid_argument("Number " + std::to_string(value) + " is not an integer");
+    }
+    return static_cast<int64_t>(value);
+}
+inline Value Value::integer(int64_t value) { return Value(value); }
+inline std::string Value::asString() const {
+    if (!isString()) validateType(ValueType::STRING);
+    return static_cast<StringObject*>(heapObject())->flat();
+}
+// Unboxed arrays answer with a boxed image and stay unboxed
+inline const std::vector<Value>& Value::asArray() const {
+    if (!isArray()) validateType(ValueType::ARRAY);
+    return static_cast<const ArrayObject*>(heapObject())->view();
+}
+inline std::vector<Value>& Value::mutableArray() {
+    if (!isArray()) validateType(ValueType::ARRAY);
+    ensureUnique();
+    ArrayObject* array = static_cast<ArrayObject*>(heapObject());
+    array->makeGeneric();
+    array->recharge();  // Growth through the returned reference is charged at the next mutation
+    return array->elements;
+}
+// Shaped objects answer with a map image of their slots and stay shaped;
+// hot paths use the property API below. Mutable access forces dictionary mode.
+inline const std::map<std::string, Value>& Value::asObject() const {
+    if (!isObject()) validateType(ValueType::OBJECT);
+    return static_cast<const PropertyObject*>(heapObject())->properties();
+}
+inline std::map<std::string, Value>& Value::mutableObject() {
+    if (!isObject()) validateType(ValueType::OBJECT);
+    ensureUnique();
+    PropertyObject* object = static_cast<PropertyObject*>(heapObject());
+    object->normalize();
+    object->recharge();
+    return object->dictionary;
+}
+
+// Shaped property access
+inline Value Value::emptyObject() {
+    Value result;
+    result.setHeapObject(new PropertyObject());
+    return result;
+}
+inline const Value* Value::findProperty(const std::string& name) const {
+    if (!isObject()) validateType(ValueType::OBJECT);
+    return static_cast<PropertyObject*>(heapObject())->find(name);
+}
+inline void Value::setProperty(const std::string& name, Value value) {
+    if (!isObject()) validateType(ValueType::OBJECT);
+    ensureUnique();
+    static_cast<PropertyObject*>(heapObject())->set(name, std::move(value));
+    heapObject()->recharge();
+}
+inline bool Value::removeProperty(const std::string& name) {
+    if (!isObject()) validateType(ValueType::OBJECT);
+    ensureUnique();
+    bool removed = static_cast<PropertyObject*>(heapObject())->remove(name);
+    heapObject()->recharge();
+    return removed;
+}
+inline Shape* Value::getShape() const {
+    return isObject() ? static_cast<PropertyObject*>(heapObject())->shape : nullptr;
+}
+
+// Slot access for inline caches; callers have already matched the shape
+inline const Value& Value::slotAt(uint32_t slot) const {
+    return static_cast<PropertyObject*>(heapObject())->slots[slot];
+}
+inline Value& Value::slotAt(uint32_t slot) {
+    ensureUnique();
+    PropertyObject* object = static_cast<PropertyObject*>(heapObject());
+    object->invalidateView();
+    return object->slots[slot];
+}
+inline void Value::appendSlot(Shape* next, Value value) {
+    ensureUnique();
+    PropertyObject* object = static_cast<PropertyObject*>(heapObject());
+    object->invalidateView();
+    object->shape = next;
+    object->slots.push_back(std::move(value));
+    object->recharge();
+}
+inline std::shared_ptr<Callable> Value::asCallable() const {
+    if (!isFunction()) validateType(ValueType::FUNCTION);
+    return static_cast<CallableObject*>(heapObject())->callable;
+}
+inline std::shared_ptr<Tensor> Value::asTensor() const {
+    if (!isTensor()) validateType(ValueType::TENSOR);
+    return static_cast<TensorObject*>(heapObject())->get();
+}
+// Tensor storage is shared by handle, across threads too, so it is copied
+// before the first write while anything else still holds it
+inline Tensor& Value::mutableTensor() {
+    if (!isTensor()) validateType(ValueType::TENSOR);
+    ensureUnique();
+    TensorObject* object = static_cast<TensorObject*>(heapObject());
+    std::shared_ptr<Tensor>& tensor = object->get();
+    if (tensor.use_count() > 1) {
+        tensor = std::make_shared<Tensor>(*tensor);
+        object->recharge();
+    }
+    return *tensor;
+}
+
+// Integer arithmetic
+#if defined(__GNUC__) || defined(__clang__)
+inline bool Value::addInt64(int64_t a, int64_t b, int64_t& result) { return !__builtin_add_overflow(a, b, &result); }
+inline bool Value::subInt64(int64_t a, int64_t b, int64_t& result) { return !__builtin_sub_overflow(a, b, &result); }
+inline bool Value::mulInt64(int64_t a, int64_t b, int64_t& result) { return !__builtin_mul_overflow(a, b, &result); }
+#else
+inline bool Value::addInt64(int64_t a, int64_t b, int64_t& result) {
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) return false;
+    result = a + b;
+    return true;
+}
+inline bool Value::subInt64(int64_t a, int64_t b, int64_t& result) {
+    if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b)) return false;
+    result = a - b;
+    return true;
+}
+inline bool Value::mulInt64(int64_t a, int64_t b, int64_t& result) {
+    if (a != 0 && b != 0) {
+        if (a == -1 && b == INT64_MIN) return false;
+        if (b == -1 && a == INT64_MIN) return false;
+        int64_t product = static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+        if (product / b != a) return false;
+    }
+    result = a * b;
+    return true;
+}
+#endif
+
+// Arithmetic fast paths: int op int stays exact (falling back to double on
+// overflow), double op double is direct, string + anything concatenates;
+// tensors and other mixed operands go through performArithmetic
+inline Value Value::operator+(const Value& other) const& {
+    if (isSmallInt() && other.isSmallInt()) return Value(unboxSmallInt() + other.unboxSmallInt());
+    if (isDouble() && other.isDouble()) return Value(unboxDouble() + other.unboxDouble());
+    int64_t result;
+    if (isInteger() && other.isInteger()) {
+        if (addInt64(asInteger(), other.asInteger(), result)) return Value(result);
+        return Value(asNumber() + other.asNumber());
+    }
+    if (isString() && other.isString()) return concatenateRope(other);
+    if (isString() && !other.isTensor()) return concatenateRope(Value(other.toString()));
+    if (other.isString() && !isTensor()) return Value(toString()).concatenateRope(other);
+    return performArithmetic(other, '+');
+}
+
+inline Value Value::operator-(const Value& other) const& {
+    if (isSmallInt() && other.isSmallInt()) return Value(unboxSmallInt() - other.unboxSmallInt());
+    if (isDouble() && other.isDouble()) return Value(unboxDouble() - other.unboxDouble());
+    int64_t result;
+    if (isInteger() && other.isInteger()) {
+        if (subInt64(asInteger(), other.asInteger(), result)) return Value(result);
+        return Value(asNumber() - other.asNumber());
+    }
+    return performArithmetic(other, '-');
+}
+inline Value Value::operator*(const Value& other) const& {
+    if (isDouble() && other.isDouble()) return Value(unboxDouble() * other.unboxDouble());
+    int64_t result;
+    if (isInteger() && other.isInteger()) {
+        if (mulInt64(asInteger(), other.asInteger(), result)) return Value(result);
+        return Value(asNumber() * other.asNumber());
+    }
+    return performArithmetic(other, '*');
+}
+// Division is always true division, so it yields a double even for integers
+inline Value Value::operator/(const Value& other) const& {
+    if (isNumber() && other.isNumber()) return Value(asNumber() / other.asNumber());
+    return performArithmetic(other, '/');
+}
+inline Value Value::operator%(const Value& other) const {
+    if (isInteger() && other.isInteger()) {
+        int64_t divisor = other.asInteger();
+        if (divisor == -1) return Value(int64_t(0));
+        if (divisor != 0) return Value(asInteger() % divisor);
+    }
+    return performArithmetic(other, '%');
+}
+
+inline Value Value::concatenateRope(const Value& other) const {
+    StringObject* left = static_cast<StringObject*>(heapObject());
+    StringObject* right = static_cast<StringObject*>(other.heapObject());
+    if (right->length == 0) return *this;
+    if (left->length == 0) return other;
+    if (left->length + right->length < StringObject::ROPE_MIN_LENGTH) {
+        return Value(left->chars + right->chars);  // Both short, hence flat
+    }
+    Value result;
+    result.setHeapObject(new StringObject(left, right));
+    return result;
+}
+// Consuming forms: reuse this operand's payload when nothing else sees it
+inline Value Value::operator+(const Value& other) && {
+    if (updateInPlace(other, '+')) return std::move(*this);
+    return static_cast<const Value&>(*this) + other;
+}
+inline Value Value::operator-(const Value& other) && {
+    if (updateInPlace(other, '-')) return std::move(*this);
+    return static_cast<const Value&>(*this) - other;
+}
+inline Value Value::operator*(const Value& other) && {
+    if (updateInPlace(other, '*')) return std::move(*this);
+    return static_cast<const Value&>(*this) * other;
+}
+inline Value Value::operator/(const Value& other) && {
+    if (updateInPlace(other, '/')) return std::move(*this);
+    return static_cast<const Value&>(*this) / other;
+}
+
+// Appends to a uniquely owned flat string, or combines equally shaped
+// tensors element-wise when neither the Value nor the Tensor is shared.
+// Ropes and everything else take the copying path.
+inline bool Value::updateInPlace(const Value& other, char op) {
+    if (!isHeap() || heapObject()->refCount != 1) return false;
+    if (op == '+' && isString()) {
+        StringObject* string = static_cast<StringObject*>(heapObject());
+        if (string->isRope()) return false;
+        if (other.isString() && static_cast<StringObject*>(other.heapObject())->isRope()) {
+            return false;  // Copying the rope's text in would flatten it every time
+        }
+        if (other.isString()) {
+            string->chars += static_cast<StringObject*>(other.heapObject())->flat();
+        } else if (!other.isTensor()) {
+            string->chars += other.toString();
+        } else {
+            return false;
+        }
+        string->length = string->chars.size();
+        string->hashed = false;
+        string->recharge();
+        return true;
+    }
+    if (isTensor() && other.isTensor()) {
+        std::shared_ptr<Tensor>& tensor = static_cast<TensorObject*>(heapObject())->get();
+        const Tensor& operand = *static_cast<TensorObject*>(other.heapObject())->get();
+        if (tensor.use_count() != 1 || tensor->getShape() != operand.getShape()) return false;
+        switch (op) {
+            case '+': *tensor += operand; return true;
+            case '-': *tensor -= operand; return true;
+            case '*': *tensor *= operand; return true;
+            case '/': *tensor /= operand; return true;
+        }
+    }
+    return false;
+}
+
+// Strings hash their text (cached on the payload) and numbers their value;
+// arrays, objects and tensors compare by contents and hash by type only
+inline size_t Value::hashNumber(double number) {
+    if (number == std::floor(number) && std::fabs(number) < 9.2e18) {
+        return std::hash<int64_t>()(static_cast<int64_t>(number));
+    }
+    return std::hash<double>()(number);
+}
+inline size_t Value::hashCombine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+// Containers hash their contents the way == compares them: arrays element by
+// element in order, objects by their key/value pairs in any order, tensors
+// by shape and elements. Reading never materializes views or boxes arrays.
+inline size_t Value::hash() const {
+    if (isSmallInt()) return std::hash<int64_t>()(unboxSmallInt());
+    if (isDouble()) return hashNumber(unboxDouble());
+    if (!isHeap()) return std::hash<uint64_t>()(bits_);
+    switch (heapObject()->type) {
+        case ValueType::INTEGER:
+            return std::hash<int64_t>()(static_cast<IntegerObject*>(heapObject())->value);
+        case ValueType::STRING:
+            return static_cast<StringObject*>(heapObject())->hash();
+        case ValueType::FUNCTION:
+            return std::hash<const Callable*>()(static_cast<CallableObject*>(heapObject())->callable.get());
+        case ValueType::ARRAY: {
+            const ArrayObject* array = static_cast<ArrayObject*>(heapObject());
+            size_t result = array->size();
+            for (size_t i = 0; i < array->size(); ++i) result = hashCombine(result, array->get(i).hash());
+            return result;
+        }
+        case ValueType::OBJECT: {
+            const PropertyObject* object = static_cast<PropertyObject*>(heapObject());
+            size_t pairs = 0;  // Summed, so the order of the pairs does not matter
+            if (object->shape) {
+                const std::vector<std::string>& keys = object->shape->getKeys();
+                for (size_t i = 0; i < keys.size(); ++i) {
+                    pairs += hashCombine(std::hash<std::string>()(keys[i]), object->slots[i].hash());
+                }
+            } else {
+                for (const auto& [key, value] : object->dictionary) {
+                    pairs += hashCombine(std::hash<std::string>()(key), value.hash());
+                }
+            }
+            return hashCombine(object->size(), pairs);
+        }
+        case ValueType::TENSOR: {
+            const TensorObject* object = static_cast<TensorObject*>(heapObject());
+            const double* data;
+            size_t count;
+            std::vector<size_t>::const_iterator dimension, last;
+            if (object->isView()) {
+                TensorRowView view = object->base->row(object->row);
+                data = view.data;
+                count = view.length;
+                dimension = object->base->getShape().begin() + 1;
+                last = object->base->getShape().end();
+            } else {
+                data = object->tensor->rawData();
+                count = object->tensor->getSize();
+                dimension = object->tensor->getShape().begin();
+                last = object->tensor->getShape().end();
+            }
+            size_t result = static_cast<size_t>(last - dimension);
+            for (; dimension != last; ++dimension) result = hashCombine(result, *dimension);
+            for (size_t i = 0; i < count; ++i) result = hashCombine(result, hashNumber(data[i]));
+            return result;
+        }
+        default:
+            return std::hash<int>()(static_cast<int>(heapObject()->type));
+    }
+}
+
+
+// Bitwise operators require integral operands; doubles holding whole
+// numbers are accepted through asInteger
+inline Value Value::operator&(const Value& other) const { return Value(asInteger() & other.asInteger()); }
+inline Value Value::operator|(const Value& other) const { return Value(asInteger() | other.asInteger()); }
+inline Value Value::operator^(const Value& other) const { return Value(asInteger() ^ other.asInteger()); }
+inline Value Value::operator~() const { return Value(~asInteger()); }
+inline Value Value::operator<<(const Value& other) const {
+    // Shift counts are masked to 0..63 as in Java/C#
+    uint64_t shifted = static_cast<uint64_t>(asInteger()) << (other.asInteger() & 63);
+    return Value(static_cast<int64_t>(shifted));
+}
+inline Value Value::operator>>(const Value& other) const {
+    return Value(asInteger() >> (other.asInteger() & 63));
+}
+
+// Integer-indexed element access; unboxed arrays stay unboxed
+inline size_t Value::arraySize() const {
+    if (!isArray()) validateType(ValueType::ARRAY);
+    return static_cast<ArrayObject*>(heapObject())->size();
+}
+inline Value Value::elementAt(int64_t index) const {
+    if (!isArray()) validateType(ValueType::ARRAY);
+    const ArrayObject* array = static_cast<ArrayObject*>(heapObject());
+    if (index < 0 || static_cast<uint64_t>(index) >= array->size()) {
+        throw std::out_of_range("Array index " + std::to_string(index) + " out of bounds");
+    }
+    return array->get(static_cast<size_t>(index));
+}
+inline void Value::setElement(int64_t index, Value value) {
+    if (!isArray()) validateType(ValueType::ARRAY);
+    ensureUnique();
+    ArrayObject* array = static_cast<ArrayObject*>(heapObject());
+    if (index < 0 || static_cast<uint64_t>(index) >= array->size()) {
+        throw std::out_of_range("Array index " + std::to_string(index) + " out of bounds");
+    }
+    array->set(static_cast<size_t>(index), std::move(value));
+    array->recharge();
+}
+inline void Value::pushElement(Value value) {
+    if (!isArray()) validateType(ValueType::ARRAY);
+    ensureUnique();
+    static_cast<ArrayObject*>(heapObject())->push(std::move(value));
+    heapObject()->recharge();
+}
+inline ArrayKind Value::getArrayKind() const {
+    if (!isArray()) validateType(ValueType::ARRAY);
+    return static_cast<ArrayObject*>(heapObject())->kind;
+}
+inline const double* Value::doubleData() const {
+    if (!isArray()) return nullptr;
+    const ArrayObject* array = static_cast<ArrayObject*>(heapObject());
+    return array->kind == ArrayKind::DOUBLES ? array->doubles.data() : nullptr;
+}
+inline const int64_t* Value::integerData() const {
+    if (!isArray()) return nullptr;
+    const ArrayObject* array = static_cast<ArrayObject*>(heapObject());
+    return array->kind == ArrayKind::INTEGERS ? array->integers.data() : nullptr;
+}
+inline Value Value::numberArray(TensorBuffer elements) {
+    Value result;
+    result.setHeapObject(new ArrayObject(std::move(elements)));
+    return result;
+}
+inline Value Value::integerArray(std::vector<int64_t> elements) {
+    Value result;
+    result.setHeapObject(new ArrayObject(std::move(elements)));
+    return result;
+}
+
+// Converts a numeric array to a 1-D tensor. Converting an rvalue that is the
+// only owner of an unboxed double array hands the buffer to the tensor.
+inline std::shared_ptr<Tensor> Value::toTensor() && {
+    if (!isArray()) validateType(ValueType::ARRAY);
+    ArrayObject* array = static_cast<ArrayObject*>(heapObject());
+    if (array->kind == ArrayKind::DOUBLES && array->refCount == 1) {
+        std::vector<size_t> shape{array->size()};
+        array->invalidateView();
+        auto tensor = std::make_shared<Tensor>(shape, std::move(array->doubles));
+        array->recharge();
+        return tensor;
+    }
+    return static_cast<const Value&>(*this).toTensor();
+}
+inline std::shared_ptr<Tensor> Value::toTensor() const& {
+    if (!isArray()) validateType(ValueType::ARRAY);
+    const ArrayObject* array = static_cast<ArrayObject*>(heapObject());
+    std::vector<size_t> shape{array->size()};
+    TensorBuffer data;
+    data.reserve(array->size());
+    for (size_t i = 0; i < array->size(); ++i) data.push_back(array->get(i).asNumber());
+    return std::make_shared<Tensor>(shape, std::move(data));
+}
+
+// Integer literals (decimal, 0x, 0b, 0o) become exact integers; anything with
+// a fraction or exponent, or too large for int64, becomes a double
+inline Value Value::fromNumberLiteral(const std::string& text) {
+    int base = 10;
+    size_t offset = 0;
+    if (text.size() > 2 && text[0] == '0') {
+        char prefix = static_cast<char>(text[1] | 0x20);
+        if (prefix == 'x') base = 16;
+        else if (prefix == 'b') base = 2;
+        else if (prefix == 'o') base = 8;
+        if (base != 10) offset = 2;
+    }
+    bool integral = base != 10 || text.find_first_of(".eE") == std::string::npos;
+    if (integral) {
+        errno = 0;
+        char* end = nullptr;
+        long long parsed = std::strtoll(text.c_str() + offset, &end, base);
+        if (errno == 0 && end && *end == '\0') return Value(static_cast<int64_t>(parsed));
+        // strtod reads 0b and 0o literals as 0, and a hex literal past int64
+        // would silently lose bits; only decimal integers widen to doubles
+        if (base != 10 && errno == ERANGE) throw std::out_of_range("Integer literal " + text + " is out of range");
+        if (base != 10) throw std::invalid_argument("Malformed integer literal " + text);
+    }
+    return Value(std::strtod(text.c_str(), nullptr));
+}
+
+// Narrowing conversion for typed declarations: drops a fraction, then wraps
+// to the declared width (64 = long, 32 = int, 16 = short, 8 = byte)
+inline Value Value::convertToInteger(int bitWidth) const {
+    int64_t value = isDouble() ? integralDouble(std::trunc(unboxDouble())) : asInteger();
+    if (bitWidth < 64) {
+        uint64_t mask = (uint64_t(1) << bitWidth) - 1;
+        uint64_t wrapped = static_cast<uint64_t>(value) & mask;
+        if (wrapped & (uint64_t(1) << (bitWidth - 1))) wrapped |= ~mask;
+        value = static_cast<int64_t>(wrapped);
+    }
+    return Value(value);
+}
+
+// ArgSpan element access (needs the complete Value type)
+inline ArgSpan::ArgSpan(const std::vector<Value>& values)
+    : first(values.data()), count(values.size()) {}
+// Iteration
+inline Value::Iterator::Iterator(const Value* v, size_t idx) : value_(v), index_(idx) {
+    if (v->isObject()) {
+        const PropertyObject* object = static_cast<PropertyObject*>(v->heapObject());
+        shape_ = object->shape;
+        if (!shape_) entry_ = idx == 0 ? object->dictionary.begin() : object->dictionary.end();
+    }
+}
+inline Value::Iterator::~Iterator() {
+    try {
+        detachRow();
+    } catch (...) {
+        // Past the heap limit the row stays a view
+    }
+}
+
+// The object being walked, checked against the representation captured at
+// construction; the entry iterator or slot index means nothing in the other
+inline const PropertyObject* Value::Iterator::properties() const {
+    const PropertyObject* object = static_cast<PropertyObject*>(value_->heapObject());
+    if (object->shape != shape_) throw std::logic_error("Object changed during iteration");
+    return object;
+}
+
+inline void Value::Iterator::detachRow() {
+    if (!current_.isTensor() || current_.heapObject()->refCount == 1) return;
+    TensorObject* row = static_cast<TensorObject*>(current_.heapObject());
+    if (row->isView()) row->get();
+}
+
+inline const Value& Value::Iterator::operator*() const {
+    HeapObject* object = value_->heapObject();
+    switch (object->type) {
+        case ValueType::ARRAY: {
+            const ArrayObject* array = static_cast<ArrayObject*>(object);
+            if (array->kind == ArrayKind::GENERIC) return array->elements[index_];
+            current_ = array->get(index_);
+            return current_;
+        }
+        case ValueType::OBJECT: {
+            const PropertyObject* walked = properties();
+            return shape_ ? walked->slots[index_] : entry_->second;
+        }
+        case ValueType::STRING:
+            return character(static_cast<unsigned char>(static_cast<StringObject*>(object)->flat()[index_]));
+        default: {
+            const std::shared_ptr<Tensor>& tensor = static_cast<TensorObject*>(object)->get();
+            if (tensor->getDimensions() <= 1) {
+                current_ = Value((*tensor)[index_]);
+                return current_;
+            }
+            // Re-point the previous row view when nothing else kept it
+            if (current_.isTensor() && current_.heapObject()->refCount == 1) {
+                TensorObject* view = static_cast<TensorObject*>(current_.heapObject());
+                if (view->isView() && view->base == tensor) {
+                    view->row = index_;
+                    return current_;
+                }
+            }
+            current_ = tensorRow(tensor, index_);
+            return current_;
+        }
+    }
+}
+
+inline Value::Iterator& Value::Iterator::operator++() {
+    if (value_->isObject() && !shape_) ++entry_;
+    detachRow();
+    ++index_;
+    return *this;
+}
+
+inline const std::string& Value::Iterator::key() const {
+    properties();
+    return shape_ ? shape_->getKeys()[index_] : entry_->first;
+}
+
+inline Value::Iterator Value::begin() const { return Iterator(this, 0); }
+inline Value::Iterator Value::end() const { return Iterator(this, iterationLength()); }
+
+inline size_t Value::iterationLength() const {
+    if (!isHeap()) validateType(ValueType::ARRAY);
+    HeapObject* object = heapObject();
+    switch (object->type) {
+        case ValueType::ARRAY:
+            return static_cast<ArrayObject*>(object)->size();
+        case ValueType::OBJECT:
+            return static_cast<PropertyObject*>(object)->size();
+        case ValueType::STRING:
+            return static_cast<StringObject*>(object)->length;
+        case ValueType::TENSOR: {
+            const std::shared_ptr<Tensor>& tensor = static_cast<TensorObject*>(object)->get();
+            return tensor->getDimensions() == 0 ? 0 : tensor->getShape()[0];
+        }
+        default:
+            validateType(ValueType::ARRAY);
+            return 0;
+    }
+}
+
+// One table per thread: refcounts are not atomic
+inline const Value& Value::character(unsigned char c) {
+    thread_local std::vector<Value> table = [] {
+        HeapAccount::Exempt exempt;  // Outlives every interpreter on the thread
+        std::vector<Value> characters;
+        characters.reserve(256);
+        for (int i = 0; i < 256; ++i) characters.emplace_back(std::string(1, static_cast<char>(i)));
+        return characters;
+    }();
+    return table[c];
+}
+
+inline Value Value::tensorRow(const std::shared_ptr<Tensor>& tensor, size_t row) {
+    Value result;
+    result.setHeapObject(new TensorObject(tensor, row));
+    return result;
+}
+
+inline const Value* ArgSpan::end() const { return first + count; }
+inline const Value& ArgSpan::operator[](size_t index) const { return first[index]; }
+inline std::vector<Value> ArgSpan::toVector() const { return std::vector<Value>(begin(), end()); }
+
 // Global utility functions
 std::ostream& operator<<(std::ostream& os, const Value& value);
 std::ostream& operator<<(std::ostream& os, ValueType type);
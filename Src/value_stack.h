@@ -0,0 +1,95 @@
+#pragma once
+
+#include "value.h"
+#include <array>
+#include <string>
+#include <vector>
+
+class StackOverflowError : public std::exception {
+private:
+    std::string message;
+
+public:
+    explicit StackOverflowError(const std::string& msg) : message(msg) {}
+    const char* what() const noexcept override { return message.c_str(); }
+};
+
+// Interpreter-managed stack of Values used to pass call arguments.
+// Storage is reserved once and never reallocated, so an ArgSpan over the top
+// of the stack stays valid while the callee pushes arguments of its own.
+class ValueStack {
+private:
+    std::vector<Value> slots;
+    size_t capacity;
+
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    explicit ValueStack(size_t maxSize = DEFAULT_CAPACITY) : capacity(maxSize) {
+        slots.reserve(capacity);
+    }
+
+    // Push/pop
+    void push(const Value& value) {
+        checkCapacity();
+        slots.push_back(value);
+    }
+    void push(Value&& value) {
+        checkCapacity();
+        slots.push_back(std::move(value));
+    }
+    Value pop() {
+        Value top = std::move(slots.back());
+        slots.pop_back();
+        return top;
+    }
+
+    // Frame windows
+    size_t size() const { return slots.size(); }
+    ArgSpan window(size_t base) const { return ArgSpan(slots.data() + base, slots.size() - base); }
+    void truncate(size_t base) { slots.resize(base); }
+    Value& operator[](size_t index) { return slots[index]; }
+    const Value& operator[](size_t index) const { return slots[index]; }
+
+private:
+    void checkCapacity() const {
+        if (slots.size() == capacity) {
+            throw StackOverflowError("Value stack overflow (" + std::to_string(capacity) + " slots)");
+        }
+    }
+};
+
+// Argument buffer for native code calling back into script functions.
+// Up to N arguments live inline; larger calls spill to a heap vector.
+template<size_t N = 8>
+class SmallArgBuffer {
+private:
+    std::array<Value, N> inlineValues;
+    std::vector<Value> overflow;
+    size_t count = 0;
+
+public:
+    void push(Value value) {
+        if (count < N) {
+            inlineValues[count++] = std::move(value);
+            return;
+        }
+        if (overflow.empty()) {
+            overflow.reserve(N * 2);
+            for (auto& v : inlineValues) overflow.push_back(std::move(v));
+        }
+        overflow.push_back(std::move(value));
+        count++;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < count && i < N; ++i) inlineValues[i] = Value();
+        overflow.clear();
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    ArgSpan span() const {
+        return count <= N ? ArgSpan(inlineValues.data(), count) : ArgSpan(overflow);
+    }
+};
@@ -0,0 +1,138 @@
+// Collector pause distribution under a large live heap.
+//
+// Builds a live heap of closures over environments that hold tensors
+// (external storage, default 4 GB in total) and small arrays, then churns
+// short-lived closure cycles while calling the collector at the same safe
+// point the interpreter uses. Every slice is timed; the report gives the
+// pause percentiles of both phases against the configured target. Major
+// passes run while the live heap grows, and the last slice of each is
+// linear in its graph, so the build phase carries the longest pauses.
+//
+//   nexus_gc_latency [--live-gb 4] [--live-closures 200000]
+//                    [--garbage 1000000] [--max-pause-ms 5]
+//
+// Built with -DBUILD_BENCHMARKS=ON against the interpreter sources; it needs
+// environment.cpp and value.cpp, which are not part of this tree.
+
+#include "enviorment.h"
+#include "gc.h"
+#include "runtime_context.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    double liveGb = 4.0;
+    size_t liveClosures = 200000;
+    size_t garbage = 1000000;
+    double maxPauseMs = 5.0;
+};
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        const char* value = argv[i + 1];
+        if (flag == "--live-gb") options.liveGb = std::atof(value);
+        else if (flag == "--live-closures") options.liveClosures = std::strtoull(value, nullptr, 10);
+        else if (flag == "--garbage") options.garbage = std::strtoull(value, nullptr, 10);
+        else if (flag == "--max-pause-ms") options.maxPauseMs = std::atof(value);
+        else {
+            std::cerr << "Unknown option: " << flag << std::endl;
+            std::exit(1);
+        }
+    }
+    return options;
+}
+
+std::shared_ptr<NexusFunction> closureOver(std::shared_ptr<Environment> scope) {
+    static auto body = std::make_shared<const std::vector<Token>>();
+    return std::make_shared<NexusFunction>("f", std::vector<std::string>{}, body, 0, std::move(scope));
+}
+
+Value callable(const std::shared_ptr<NexusFunction>& function) {
+    return Value(std::static_pointer_cast<Callable>(function));
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[index];
+}
+
+void reportPauses(const char* phase, std::vector<double> pauses, double target) {
+    std::sort(pauses.begin(), pauses.end());
+    std::cout << phase << " pauses (" << pauses.size() << " slices, target " << target << " ms):" << std::endl;
+    std::cout << "  p50   " << percentile(pauses, 0.50) << " ms" << std::endl;
+    std::cout << "  p90   " << percentile(pauses, 0.90) << " ms" << std::endl;
+    std::cout << "  p99   " << percentile(pauses, 0.99) << " ms" << std::endl;
+    std::cout << "  p99.9 " << percentile(pauses, 0.999) << " ms" << std::endl;
+    std::cout << "  max   " << (pauses.empty() ? 0.0 : pauses.back()) << " ms" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+    RuntimeContext context;
+    RuntimeContext::Scope scope(context);
+    GarbageCollector collector;
+    collector.setMaxPause(options.maxPauseMs);
+
+    std::vector<double> pauses;
+    auto safePoint = [&]() {
+        if (!collector.shouldCollect()) return;
+        auto start = std::chrono::steady_clock::now();
+        collector.collect();
+        pauses.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    };
+
+    // Live heap: every closure is stored in the scope it captures, so the
+    // collector has to prove each one reachable on every major pass
+    constexpr size_t TENSOR_ELEMENTS = (size_t(1) << 20) / sizeof(double) * 16;  // 16 MB
+    size_t tensors = static_cast<size_t>(options.liveGb * 1024 / 16);
+    auto root = std::make_shared<Environment>(nullptr, "root");
+    std::vector<std::shared_ptr<Environment>> live;
+    live.reserve(options.liveClosures);
+    for (size_t i = 0; i < options.liveClosures; ++i) {
+        auto environment = std::make_shared<Environment>(root, "live");
+        auto function = closureOver(environment);
+        safePoint();
+        collector.track(function);
+        environment->define("self", callable(function));
+        environment->define("items", Value(std::vector<Value>{Value(int64_t(i)), Value("item"), Value(0.5)}));
+        if (i < tensors) {
+            environment->define("weights", Value(std::make_shared<Tensor>(
+                std::vector<size_t>{TENSOR_ELEMENTS}, TensorBuffer(TENSOR_ELEMENTS, 1.0))));
+        }
+        live.push_back(std::move(environment));
+    }
+    size_t warmupSlices = pauses.size();
+
+    // Churn: closure cycles that die immediately
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < options.garbage; ++i) {
+        auto environment = std::make_shared<Environment>(root, "temp");
+        auto function = closureOver(environment);
+        safePoint();
+        collector.track(function);
+        environment->define("self", callable(function));
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "live: " << live.size() << " closures, " << std::min(tensors, live.size()) * 16
+              << " MB of tensors; churned " << options.garbage << " cycles in " << elapsed << " ms" << std::endl;
+    reportPauses("build", {pauses.begin(), pauses.begin() + warmupSlices}, options.maxPauseMs);
+    reportPauses("churn", {pauses.begin() + warmupSlices, pauses.end()}, options.maxPauseMs);
+    collector.printStats(std::cout);
+
+    for (auto& environment : live) environment->clear();
+    return 0;
+}
@@ -0,0 +1,219 @@
+// Single-core GEMM throughput against the machine's FMA peak.
+//
+// Times Gemm::multiply on square products and on the skinny shapes of a
+// 784-256 dense layer trained in batches of 32 (forward, input gradient
+// and weight gradient), checks each result against a naive product, and
+// reports GFLOP/s as a fraction of peak. Peak is measured with a
+// register-only FMA loop at the width of the selected kernel, so it
+// reflects the clock the core actually runs at; --peak overrides it.
+//
+//   nexus_gemm [--kernel scalar|avx2|avx512] [--peak <GFLOP/s>]
+//              [--seconds 0.5]
+
+#include "ml/gemm.h"
+#include "tensor_allocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NEXUS_GEMM_X86 1
+#endif
+
+namespace {
+
+struct Options {
+    std::string kernel;
+    double peak = 0.0;
+    double seconds = 0.5;
+};
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        const char* value = argv[i + 1];
+        if (flag == "--kernel") options.kernel = value;
+        else if (flag == "--peak") options.peak = std::atof(value);
+        else if (flag == "--seconds") options.seconds = std::atof(value);
+        else {
+            std::cerr << "Unknown option: " << flag << std::endl;
+            std::exit(1);
+        }
+    }
+    return options;
+}
+
+struct Shape {
+    std::string label;
+    size_t m, k, n;  // (m×k)·(k×n)
+};
+
+double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Independent FMA chains, enough of them to cover latency × ports. The
+// chains are unrolled so the compiler cannot interchange the loops into one
+// latency-bound chain at a time.
+constexpr size_t PEAK_ITERATIONS = size_t(1) << 24;
+
+double scalarPeak() {
+    double sum[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    volatile double scale = 0.999999;
+    double factor = scale;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < PEAK_ITERATIONS; ++i) {
+#pragma GCC unroll 8
+        for (double& value : sum) value = value * factor + 1e-9;
+    }
+    double elapsed = seconds(start);
+    double total = 0.0;
+    for (double value : sum) total += value;
+    volatile double sink = total;  // Keeps every chain live
+    (void)sink;
+    return PEAK_ITERATIONS * 8 * 2 / elapsed / 1e9;
+}
+
+#ifdef NEXUS_GEMM_X86
+
+__attribute__((target("avx2,fma")))
+double avx2Peak() {
+    __m256d sum[12];
+    for (size_t i = 0; i < 12; ++i) sum[i] = _mm256_set1_pd(static_cast<double>(i));
+    __m256d factor = _mm256_set1_pd(0.999999);
+    __m256d offset = _mm256_set1_pd(1e-9);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < PEAK_ITERATIONS; ++i) {
+#pragma GCC unroll 12
+        for (size_t j = 0; j < 12; ++j) sum[j] = _mm256_fmadd_pd(sum[j], factor, offset);
+    }
+    double elapsed = seconds(start);
+    for (size_t j = 1; j < 12; ++j) sum[0] = _mm256_add_pd(sum[0], sum[j]);
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum[0]);
+    volatile double sink = lanes[0];
+    (void)sink;
+    return PEAK_ITERATIONS * 12 * 4 * 2 / elapsed / 1e9;
+}
+
+__attribute__((target("avx512f")))
+double avx512Peak() {
+    __m512d sum[24];
+    for (size_t i = 0; i < 24; ++i) sum[i] = _mm512_set1_pd(static_cast<double>(i));
+    __m512d factor = _mm512_set1_pd(0.999999);
+    __m512d offset = _mm512_set1_pd(1e-9);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < PEAK_ITERATIONS; ++i) {
+#pragma GCC unroll 24
+        for (size_t j = 0; j < 24; ++j) sum[j] = _mm512_fmadd_pd(sum[j], factor, offset);
+    }
+    double elapsed = seconds(start);
+    for (size_t j = 1; j < 24; ++j) sum[0] = _mm512_add_pd(sum[0], sum[j]);
+    double lanes[8];
+    _mm512_storeu_pd(lanes, sum[0]);
+    volatile double sink = lanes[0];
+    (void)sink;
+    return PEAK_ITERATIONS * 24 * 8 * 2 / elapsed / 1e9;
+}
+
+#endif
+
+double peakOnce(Gemm::Kernel kernel) {
+#ifdef NEXUS_GEMM_X86
+    if (kernel == Gemm::Kernel::AVX512) return avx512Peak();
+    if (kernel == Gemm::Kernel::AVX2) return avx2Peak();
+#else
+    (void)kernel;
+#endif
+    return scalarPeak();
+}
+
+// Best of a few runs, so a preempted run does not flatter the results
+double measurePeak(Gemm::Kernel kernel) {
+    double best = 0.0;
+    for (int run = 0; run < 3; ++run) best = std::max(best, peakOnce(kernel));
+    return best;
+}
+
+void naive(const Shape& shape, const double* a, const double* b, double* c) {
+    for (size_t i = 0; i < shape.m; ++i) {
+        for (size_t j = 0; j < shape.n; ++j) {
+            double sum = 0.0;
+            for (size_t p = 0; p < shape.k; ++p) sum += a[i * shape.k + p] * b[p * shape.n + j];
+            c[i * shape.n + j] = sum;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+    if (!options.kernel.empty()) {
+        Gemm::Kernel wanted = options.kernel == "avx512" ? Gemm::Kernel::AVX512
+                            : options.kernel == "avx2"   ? Gemm::Kernel::AVX2
+                                                         : Gemm::Kernel::SCALAR;
+        if (!Gemm::supported(wanted)) {
+            std::cerr << "Kernel " << options.kernel << " is not supported on this CPU" << std::endl;
+            return 1;
+        }
+        Gemm::select(wanted);
+    }
+    Gemm::Kernel kernel = Gemm::selected();
+    double peak = options.peak > 0 ? options.peak : measurePeak(kernel);
+
+    std::vector<Shape> shapes = {
+        {"64^3", 64, 64, 64},
+        {"128^3", 128, 128, 128},
+        {"256^3", 256, 256, 256},
+        {"512^3", 512, 512, 512},
+        {"1024^3", 1024, 1024, 1024},
+        {"32x784 * 784x256", 32, 784, 256},   // Forward
+        {"32x256 * 256x784", 32, 256, 784},   // Input gradient
+        {"784x32 * 32x256", 784, 32, 256},    // Weight gradient
+    };
+
+    std::cout << "kernel " << Gemm::name(kernel) << ", peak " << std::fixed << std::setprecision(1) << peak
+              << " GFLOP/s (" << (options.peak > 0 ? "given" : "measured") << ")" << std::endl;
+    std::cout << std::left << std::setw(20) << "shape" << std::right << std::setw(12) << "ms/call"
+              << std::setw(12) << "GFLOP/s" << std::setw(10) << "% peak" << std::setw(12) << "max error"
+              << std::endl;
+
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    for (const Shape& shape : shapes) {
+        TensorBuffer a(shape.m * shape.k), b(shape.k * shape.n), c(shape.m * shape.n), expected(shape.m * shape.n);
+        for (double& value : a) value = uniform(random);
+        for (double& value : b) value = uniform(random);
+
+        naive(shape, a.data(), b.data(), expected.data());
+        Gemm::multiply(shape.m, shape.n, shape.k, a.data(), shape.k, b.data(), shape.n, c.data(), shape.n);
+        double error = 0.0;
+        for (size_t i = 0; i < c.size(); ++i) error = std::max(error, std::fabs(c[i] - expected[i]));
+
+        // Repeat until the budget is spent; report the best call
+        double best = 1e30;
+        auto start = std::chrono::steady_clock::now();
+        size_t calls = 0;
+        while (calls < 3 || seconds(start) < options.seconds) {
+            auto call = std::chrono::steady_clock::now();
+            Gemm::multiply(shape.m, shape.n, shape.k, a.data(), shape.k, b.data(), shape.n, c.data(), shape.n);
+            best = std::min(best, seconds(call));
+            calls++;
+        }
+        double gflops = 2.0 * shape.m * shape.n * shape.k / best / 1e9;
+        std::cout << std::left << std::setw(20) << shape.label << std::right << std::setprecision(3)
+                  << std::setw(12) << best * 1e3 << std::setprecision(1) << std::setw(12) << gflops
+                  << std::setw(9) << 100.0 * gflops / peak << "%" << std::scientific << std::setprecision(1)
+                  << std::setw(12) << error << std::fixed << std::endl;
+    }
+    return 0;
+}
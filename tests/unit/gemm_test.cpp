@@ -0,0 +1,105 @@
+#include "ml/gemm.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Shape {
+    size_t m, n, k;
+};
+
+// Small integers, so every kernel's sums are exact and comparable with ==
+std::vector<double> matrix(size_t rows, size_t columns, uint32_t seed) {
+    std::vector<double> values(rows * columns);
+    for (double& value : values) {
+        seed = seed * 1664525u + 1013904223u;
+        value = static_cast<double>(static_cast<int>(seed >> 28) - 8);
+    }
+    return values;
+}
+
+void naive(const Shape& s, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc,
+           bool accumulate) {
+    for (size_t i = 0; i < s.m; ++i) {
+        for (size_t j = 0; j < s.n; ++j) {
+            double sum = accumulate ? c[i * ldc + j] : 0.0;
+            for (size_t p = 0; p < s.k; ++p) sum += a[i * lda + p] * b[p * ldb + j];
+            c[i * ldc + j] = sum;
+        }
+    }
+}
+
+// Runs every product with one micro-kernel selected
+class GemmKernelTest : public ::testing::TestWithParam<Gemm::Kernel> {
+protected:
+    Gemm::Kernel previous = Gemm::selected();
+
+    void SetUp() override {
+        if (!Gemm::supported(GetParam())) GTEST_SKIP() << Gemm::name(GetParam()) << " not supported here";
+        Gemm::select(GetParam());
+        ASSERT_EQ(Gemm::selected(), GetParam());
+    }
+    void TearDown() override { Gemm::select(previous); }
+
+    // Pads each leading dimension by padding columns, which must be left alone
+    void check(const Shape& s, bool accumulate, size_t padding = 0) {
+        size_t lda = s.k + padding, ldb = s.n + padding, ldc = s.n + padding;
+        std::vector<double> a = matrix(s.m, lda, 1);
+        std::vector<double> b = matrix(s.k, ldb, 2);
+        std::vector<double> c = matrix(s.m, ldc, 3);
+        std::vector<double> expected = c;
+
+        Gemm::multiply(s.m, s.n, s.k, a.data(), lda, b.data(), ldb, c.data(), ldc, accumulate);
+        naive(s, a.data(), lda, b.data(), ldb, expected.data(), ldc, accumulate);
+        for (size_t i = 0; i < s.m; ++i) {
+            for (size_t j = 0; j < ldc; ++j) {
+                ASSERT_EQ(c[i * ldc + j], expected[i * ldc + j])
+                    << Gemm::name(GetParam()) << " " << s.m << "x" << s.n << "x" << s.k << " at (" << i << ", " << j
+                    << ")";
+            }
+        }
+    }
+};
+
+// Multiples of every micro-tile (12×16 divides 48×48), so no edge tiles
+TEST_P(GemmKernelTest, WholeTiles) {
+    check({48, 48, 48}, false);
+    check({48, 48, 48}, true);
+}
+
+// Remainders in every direction for 4×4, 6×8 and 12×16 tiles
+TEST_P(GemmKernelTest, EdgeTiles) {
+    for (Shape s : {Shape{37, 41, 53}, Shape{49, 33, 31}, Shape{35, 17, 67}, Shape{13, 101, 29}}) {
+        check(s, false);
+        check(s, true);
+    }
+}
+
+// Deeper than one KC slice, taller than one MC block, wider than one NC panel
+TEST_P(GemmKernelTest, SpansSeveralBlocks) {
+    check({21, 19, 613}, false);
+    check({301, 23, 37}, true);
+    check({7, 2100, 40}, false);
+}
+
+TEST_P(GemmKernelTest, HonoursLeadingDimensions) {
+    check({37, 41, 53}, false, 5);
+    check({37, 41, 53}, true, 3);
+}
+
+// Below the packing threshold, and the degenerate k = 0
+TEST_P(GemmKernelTest, SmallProductsAndEmptyDepth) {
+    check({3, 5, 7}, false);
+    check({9, 9, 0}, false);
+    check({9, 9, 0}, true);
+}
+
+INSTANTIATE_TEST_SUITE_P(AllKernels, GemmKernelTest,
+                         ::testing::Values(Gemm::Kernel::SCALAR, Gemm::Kernel::AVX2, Gemm::Kernel::AVX512),
+                         [](const ::testing::TestParamInfo<Gemm::Kernel>& info) {
+                             return std::string(Gemm::name(info.param));
+                         });
+
+} // namespace
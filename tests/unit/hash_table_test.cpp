@@ -0,0 +1,115 @@
+#include "hash_table.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+TEST(ValueHashTableTest, GrowsAndKeepsEveryEntry) {
+    ValueHashTable table;
+    size_t capacity = table.capacity();
+    int grown = 0;
+    for (int64_t i = 0; i < 10000; ++i) {
+        EXPECT_TRUE(table.insert(Value(i), Value(i * 2)));
+        if (table.capacity() != capacity) {
+            capacity = table.capacity();
+            grown++;
+            // Power of two, and never more than 7/8 full
+            EXPECT_EQ(capacity & (capacity - 1), 0u);
+            EXPECT_LE(table.size() * 8, capacity * 7);
+        }
+    }
+    EXPECT_GT(grown, 5);
+    ASSERT_EQ(table.size(), 10000u);
+    for (int64_t i = 0; i < 10000; ++i) {
+        const Value* found = table.find(Value(i));
+        ASSERT_NE(found, nullptr) << i;
+        EXPECT_EQ(found->asInteger(), i * 2);
+    }
+    EXPECT_EQ(table.find(Value(int64_t(10000))), nullptr);
+}
+
+TEST(ValueHashTableTest, InsertReplacesTheValueOfAnExistingKey) {
+    ValueHashTable table;
+    EXPECT_TRUE(table.insert(Value("k"), Value(1)));
+    EXPECT_FALSE(table.insert(Value("k"), Value(2)));
+    EXPECT_EQ(table.size(), 1u);
+    EXPECT_EQ(table.find(Value("k"))->asInteger(), 2);
+}
+
+// Erased slots become tombstones: later keys in the same probe chain must
+// still be found, and the slots are reused rather than growing the table
+TEST(ValueHashTableTest, ErasedKeysLeaveTheRestReachable) {
+    ValueHashTable table;
+    for (int64_t i = 0; i < 1000; ++i) table.insert(Value(i), Value(i));
+    for (int64_t i = 0; i < 1000; i += 2) EXPECT_TRUE(table.erase(Value(i)));
+    EXPECT_FALSE(table.erase(Value(int64_t(0))));
+    EXPECT_EQ(table.size(), 500u);
+    for (int64_t i = 0; i < 1000; ++i) {
+        EXPECT_EQ(table.find(Value(i)) != nullptr, i % 2 == 1) << i;
+    }
+
+    size_t capacity = table.capacity();
+    for (int64_t i = 0; i < 1000; i += 2) table.insert(Value(i), Value(-i));
+    EXPECT_EQ(table.size(), 1000u);
+    EXPECT_EQ(table.capacity(), capacity);
+    EXPECT_EQ(table.find(Value(int64_t(998)))->asInteger(), -998);
+}
+
+TEST(ValueHashTableTest, ChurnDoesNotGrowTheTable) {
+    ValueHashTable table;
+    for (int64_t i = 0; i < 100000; ++i) {
+        table.insert(Value(i), Value(i));
+        if (i >= 8) table.erase(Value(i - 8));
+    }
+    EXPECT_EQ(table.size(), 8u);
+    EXPECT_LE(table.capacity(), 32u);
+}
+
+// Random inserts, erases and lookups checked against std::unordered_map
+TEST(ValueHashTableTest, MatchesAReferenceMap) {
+    ValueHashTable table;
+    std::unordered_map<int64_t, int64_t> reference;
+    uint32_t state = 12345;
+    for (int64_t i = 0; i < 200000; ++i) {
+        state = state * 1103515245u + 12345u;
+        int64_t key = (state >> 8) % 5000;
+        switch (state % 3) {
+            case 0:
+                EXPECT_EQ(table.insert(Value(key), Value(i)), reference.count(key) == 0);
+                reference[key] = i;
+                break;
+            case 1:
+                EXPECT_EQ(table.erase(Value(key)), reference.erase(key) == 1);
+                break;
+            default: {
+                const Value* found = table.find(Value(key));
+                ASSERT_EQ(found != nullptr, reference.count(key) == 1);
+                if (found) EXPECT_EQ(found->asInteger(), reference[key]);
+            }
+        }
+        ASSERT_EQ(table.size(), reference.size());
+    }
+}
+
+TEST(ValueHashTableTest, EqualNumbersAreOneKey) {
+    ValueHashTable table;
+    table.insert(Value(int64_t(2)), Value("int"));
+    EXPECT_FALSE(table.insert(Value(2.0), Value("double")));
+    EXPECT_EQ(table.size(), 1u);
+    EXPECT_EQ(table.find(Value(int64_t(2)))->asString(), "double");
+}
+
+TEST(ValueHashTableTest, NanIsASingleKey) {
+    ValueHashTable table;
+    EXPECT_TRUE(table.insert(Value(std::nan("")), Value(1)));
+    EXPECT_FALSE(table.insert(Value(-std::nan("1")), Value(2)));
+    EXPECT_EQ(table.size(), 1u);
+    ASSERT_NE(table.find(Value(NAN)), nullptr);
+    EXPECT_EQ(table.find(Value(NAN))->asInteger(), 2);
+    EXPECT_TRUE(table.erase(Value(NAN)));
+    EXPECT_TRUE(table.empty());
+}
+
+} // namespace
@@ -0,0 +1,191 @@
+#include "interpreter.h"
+#include "hash_table.h"
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+
+// A million frames would overflow the native stack many times over if each
+// 'return f(...)' recursed through invokeFunction
+TEST(TailCallTest, DeepSelfRecursionRunsInConstantStack) {
+    NexusInterpreter interpreter;
+    interpreter.execute(
+        "function down(n) { if (n == 0) { return 0; } return down(n - 1); }"
+        "var result = down(1000000);");
+    EXPECT_EQ(interpreter.evaluateExpression("result").asInteger(), 0);
+}
+
+TEST(TailCallTest, MutualRecursionIsAlsoEliminated) {
+    NexusInterpreter interpreter;
+    interpreter.execute(
+        "function even(n) { if (n == 0) { return true; } return odd(n - 1); }"
+        "function odd(n) { if (n == 0) { return false; } return even(n - 1); }"
+        "var result = even(1000001);");
+    EXPECT_FALSE(interpreter.evaluateExpression("result").isTruthy());
+}
+
+// Leaving the frame early would take the call out of the handler's reach
+TEST(TailCallTest, ReturnInsideTryStillReachesTheHandler) {
+    NexusInterpreter interpreter;
+    interpreter.execute(
+        "function fail(n) { throw n; }"
+        "function guarded(n) { try { return fail(n); } catch (e) { return e + 1; } }"
+        "var result = guarded(41);");
+    EXPECT_EQ(interpreter.evaluateExpression("result").asInteger(), 42);
+}
+
+// Every '.x' read, '.x' store and method call after the first goes through
+// its site's cache
+TEST(InlineCacheTest, PropertySitesHitAfterTheFirstExecution) {
+    NexusInterpreter interpreter;
+    interpreter.execute(
+        "var point = {x: 0, step: function(n) { return n + 1; }};"
+        "for (var i = 0; i < 100; i++) { point.x = point.step(point.x); }");
+    EXPECT_EQ(interpreter.evaluateExpression("point.x").asInteger(), 100);
+
+    InlineCacheStats stats = interpreter.getInlineCacheStats();
+    EXPECT_GE(stats.monomorphic, 3u);
+    EXPECT_EQ(stats.megamorphic, 0u);
+    EXPECT_GE(stats.hits, 3u * 99u);
+}
+
+TEST(ForEachTest, AllHeaderFormsVisitEveryElement) {
+    NexusInterpreter interpreter;
+    interpreter.execute(
+        "var items = [1, 2, 3, 4];"
+        "var a = 0; for (x in items) { a += x; }"
+        "var b = 0; for (var x : items) { b += x; }"
+        "var c = 0; for (int x : items) { c += x; }");
+    EXPECT_EQ(interpreter.evaluateExpression("a").asInteger(), 10);
+    EXPECT_EQ(interpreter.evaluateExpression("b").asInteger(), 10);
+    EXPECT_EQ(interpreter.evaluateExpression("c").asInteger(), 10);
+}
+
+TEST(ForEachTest, BreakContinueAndReturnLeaveTheLoop) {
+    NexusInterpreter interpreter;
+    interpreter.execute(
+        "function firstOver(items, limit) { for (x in items) { if (x > limit) { return x; } } return -1; }"
+        "var odd = 0; for (x in [1, 2, 3, 4, 5, 6]) { if (x % 2 == 0) { continue; } if (x > 4) { break; } odd += x; }"
+        "var found = firstOver([3, 8, 12], 5);");
+    EXPECT_EQ(interpreter.evaluateExpression("odd").asInteger(), 4);
+    EXPECT_EQ(interpreter.evaluateExpression("found").asInteger(), 8);
+}
+
+// 's = s + "y"' on an unshared string appends in place: the only growth
+// is the buffer's own, never a second copy alive next to the first
+TEST(InPlaceUpdateTest, UniqueStringIsAppendedWithoutACopy) {
+    NexusInterpreter interpreter;
+    interpreter.execute("var s = \"" + std::string(10000, 'x') + "\";");
+    size_t before = interpreter.getHeapAccount().getTotal();
+    interpreter.execute("for (var i = 0; i < 9000; i++) { s = s + \"y\"; }");
+    EXPECT_EQ(interpreter.evaluateExpression("len(s)").asInteger(), 19000);
+    EXPECT_LT(interpreter.getHeapAccount().getPeak() - before, 15000u);
+}
+
+TEST(InPlaceUpdateTest, UniqueArrayElementIsWrittenWithoutACopy) {
+    std::string elements = "0";
+    for (int i = 1; i < 10000; ++i) elements += ", 0";
+    NexusInterpreter interpreter;
+    interpreter.execute("var a = [" + elements + "];");
+    size_t before = interpreter.getHeapAccount().getTotal();
+    interpreter.execute("for (var i = 0; i < 100; i++) { a[0] = i; a[9999] = a[9999] + 1; }");
+    EXPECT_EQ(interpreter.evaluateExpression("a[0]").asInteger(), 99);
+    EXPECT_EQ(interpreter.evaluateExpression("a[9999]").asInteger(), 100);
+    EXPECT_LT(interpreter.getHeapAccount().getPeak() - before, 10000u * sizeof(double) / 2);
+}
+
+// A StringBuilder's text and a Map's table live outside any Value payload
+TEST(HeapAccountTest, BuiltinBuffersAreCharged) {
+    NexusInterpreter interpreter;
+    interpreter.execute("var sb = StringBuilder(); var m = Map();");
+    size_t strings = interpreter.getHeapAccount().getBytes(MemoryCategory::STRINGS);
+    size_t objects = interpreter.getHeapAccount().getBytes(MemoryCategory::OBJECTS);
+    interpreter.execute("for (var i = 0; i < 10000; i++) { sb.append(\"0123456789\"); m.set(i, i); }");
+    EXPECT_GE(interpreter.getHeapAccount().getBytes(MemoryCategory::STRINGS) - strings, 100000u);
+    EXPECT_GE(interpreter.getHeapAccount().getBytes(MemoryCategory::OBJECTS) - objects,
+              10000u * sizeof(ValueHashTable::Entry));
+
+    interpreter.execute("sb = 0; m = 0;");
+    EXPECT_LE(interpreter.getHeapAccount().getBytes(MemoryCategory::STRINGS), strings);
+    EXPECT_LE(interpreter.getHeapAccount().getBytes(MemoryCategory::OBJECTS), objects);
+}
+
+// Loop statements rewind their temporaries as they go; values kept past
+// their statement pin at most MAX_PINNED_CHUNKS chunks, then go to the heap
+TEST(ScratchArenaTest, KeptValuesPinABoundedNumberOfChunks) {
+    NexusInterpreter interpreter;
+    ScratchArenaStats before = ScratchArena::getStats();
+    interpreter.execute("var n = 0; for (var i = 0; i < 100000; i++) { var s = \"a\" + i; n = n + len(s); }");
+    ScratchArenaStats temporaries = ScratchArena::getStats();
+    EXPECT_GE(temporaries.arenaObjects - before.arenaObjects, 100000u);
+    EXPECT_LE(temporaries.chunks, before.chunks + 2);
+
+    interpreter.execute("var kept = {}; for (var i = 0; i < 100000; i++) { kept[i] = \"a\" + i; }");
+    ScratchArenaStats kept = ScratchArena::getStats();
+    EXPECT_LE(kept.pinnedChunks, ScratchArena::MAX_PINNED_CHUNKS);
+    EXPECT_GT(kept.heapObjects, temporaries.heapObjects);
+    EXPECT_EQ(interpreter.evaluateExpression("kept[99999]").asString(), "a99999");
+}
+
+TEST(GcStatsTest, ReportFollowsEachTopLevelRun) {
+    NexusInterpreter interpreter;
+    testing::internal::CaptureStdout();
+    interpreter.execute("var quiet = 1;");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+
+    interpreter.enableGcStats();
+    testing::internal::CaptureStdout();
+    interpreter.execute(
+        "function outer() { var f = 0; f = function() { return f; }; return 0; }"
+        "for (var i = 0; i < 2000; i++) { outer(); }");
+    std::string report = testing::internal::GetCapturedStdout();
+    EXPECT_NE(report.find("GC: "), std::string::npos) << report;
+    EXPECT_GT(interpreter.getGcStats().objectsFreed, 0u);
+}
+
+// Each builtin object's methods move to one copy of its state, which the
+// original never sees again
+TEST(ForkTest, BuiltinObjectsGetTheirOwnState) {
+    NexusInterpreter interpreter;
+    interpreter.execute(
+        "var m = Map(); m.set(\"a\", 1); m.set(\"self\", m);"
+        "var sb = StringBuilder(); sb.append(\"x\");");
+    auto fork = interpreter.fork(*interpreter.snapshot());
+    fork->execute("m.set(\"b\", 2); sb.append(\"y\"); var inner = m.get(\"self\").size();");
+
+    EXPECT_EQ(interpreter.evaluateExpression("m.size()").asInteger(), 2);
+    EXPECT_EQ(interpreter.evaluateExpression("sb.toString()").asString(), "x");
+    EXPECT_EQ(fork->evaluateExpression("m.size()").asInteger(), 3);
+    EXPECT_EQ(fork->evaluateExpression("inner").asInteger(), 3);
+    EXPECT_EQ(fork->evaluateExpression("sb.toString()").asString(), "xy");
+}
+
+TEST(ForkTest, UnboxedArraysStayUnboxed) {
+    NexusInterpreter interpreter;
+    interpreter.execute("var ints = [1, 2, 3]; var reals = [0.5, 1.5];");
+    auto fork = interpreter.fork(*interpreter.snapshot());
+
+    Value ints = fork->evaluateExpression("ints");
+    Value reals = fork->evaluateExpression("reals");
+    EXPECT_EQ(ints.getArrayKind(), ArrayKind::INTEGERS);
+    EXPECT_EQ(ints.elementAt(2).asInteger(), 3);
+    EXPECT_EQ(reals.getArrayKind(), ArrayKind::DOUBLES);
+    EXPECT_EQ(reals.elementAt(1).asNumber(), 1.5);
+}
+
+// The fork shares the tensor's storage until one side writes to it
+TEST(ForkTest, TensorsAreCopiedOnWrite) {
+    NexusInterpreter interpreter;
+    interpreter.execute("tensor t = [1.5, 2.5, 3.5];");
+    auto fork = interpreter.fork(*interpreter.snapshot());
+    EXPECT_EQ(fork->evaluateExpression("t").asTensor(), interpreter.evaluateExpression("t").asTensor());
+
+    fork->execute("t[0] = 9;");
+    interpreter.execute("var u = t; u[1] = 7;");
+    EXPECT_EQ((*interpreter.evaluateExpression("t").asTensor())[0], 1.5);
+    EXPECT_EQ((*interpreter.evaluateExpression("t").asTensor())[1], 2.5);
+    EXPECT_EQ((*interpreter.evaluateExpression("u").asTensor())[1], 7.0);
+    EXPECT_EQ((*fork->evaluateExpression("t").asTensor())[0], 9.0);
+}
+
+} // namespace
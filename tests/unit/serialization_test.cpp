@@ -0,0 +1,72 @@
+#include "serialization.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace {
+
+// Writes values to a scratch file and removes it afterwards
+class MappedFileTest : public ::testing::Test {
+protected:
+    std::string path = ::testing::TempDir() + "nexus_serialization_test.nxb";
+
+    void TearDown() override { std::remove(path.c_str()); }
+
+    void writeFile(const std::vector<Value>& values) {
+        std::ofstream out(path, std::ios::binary);
+        BinaryWriter writer(out);
+        for (const Value& value : values) writer.write(value);
+    }
+};
+
+TEST_F(MappedFileTest, ReadsValuesBackFromAMappedFile) {
+    Value record = Value::emptyObject();
+    record.setProperty("name", Value(std::string("weights")));
+    record.setProperty("epochs", Value(int64_t(12)));
+    Value nested(std::vector<Value>{Value(int64_t(1)), Value(std::vector<Value>{Value(2.5), Value("x")})});
+    writeFile({record, nested, Value::numberArray(TensorBuffer{1.0, 2.0, 3.0})});
+
+    BinaryReader reader = BinaryReader::open(path);
+    Value first = reader.read();
+    ASSERT_TRUE(first.isObject());
+    EXPECT_EQ(first.findProperty("name")->asString(), "weights");
+    EXPECT_EQ(first.findProperty("epochs")->asInteger(), 12);
+
+    Value second = reader.read();
+    ASSERT_EQ(second.arraySize(), 2u);
+    EXPECT_EQ(second.elementAt(0).asInteger(), 1);
+    EXPECT_EQ(second.elementAt(1).elementAt(0).asNumber(), 2.5);
+    EXPECT_EQ(second.elementAt(1).elementAt(1).asString(), "x");
+
+    TensorView view = reader.readTensorView();
+    ASSERT_EQ(view.size, 3u);
+    EXPECT_EQ(view.data[2], 3.0);
+    EXPECT_TRUE(reader.atEnd());
+}
+
+// The nesting guard starts from zero for mapped files as for streams
+TEST_F(MappedFileTest, AcceptsDeepButBoundedNesting) {
+    Value deep = Value::array();
+    for (int i = 0; i < 100; ++i) deep = Value(std::vector<Value>{deep});
+    writeFile({deep});
+
+    BinaryReader reader = BinaryReader::open(path);
+    Value result = reader.read();
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(result.arraySize(), 1u);
+        result = result.elementAt(0);
+    }
+    EXPECT_EQ(result.arraySize(), 0u);
+}
+
+TEST_F(MappedFileTest, RejectsNestingPastTheLimit) {
+    Value deep = Value::array();
+    for (int i = 0; i < 1000; ++i) deep = Value(std::vector<Value>{deep});
+    writeFile({deep});
+
+    BinaryReader reader = BinaryReader::open(path);
+    EXPECT_THROW(reader.read(), SerializationError);
+}
+
+} // namespace
@@ -0,0 +1,159 @@
+#include "value.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr int64_t SMALL_MAX = (int64_t(1) << 47) - 1;
+constexpr int64_t SMALL_MIN = -(int64_t(1) << 47);
+
+double doubleFromBits(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(double));
+    return value;
+}
+
+// Immediates carry no payload, so only a boxed integer's copy shares one
+bool isBoxed(const Value& value) {
+    Value copy = value;
+    return copy.sharesPayload();
+}
+
+TEST(SmallIntTest, BoundariesRoundTripExactly) {
+    for (int64_t n : {SMALL_MAX, SMALL_MAX - 1, SMALL_MIN, SMALL_MIN + 1, int64_t(-1), int64_t(0)}) {
+        Value value(n);
+        ASSERT_TRUE(value.isInteger()) << n;
+        EXPECT_EQ(value.asInteger(), n);
+        EXPECT_FALSE(isBoxed(value)) << n;
+    }
+}
+
+TEST(SmallIntTest, ValuesJustOutsideTheRangeAreBoxed) {
+    for (int64_t n : {SMALL_MAX + 1, SMALL_MIN - 1, INT64_MAX, INT64_MIN}) {
+        Value value(n);
+        ASSERT_TRUE(value.isInteger()) << n;
+        EXPECT_EQ(value.asInteger(), n);
+        EXPECT_TRUE(isBoxed(value)) << n;
+    }
+}
+
+TEST(SmallIntTest, ArithmeticCrossesTheBoundaryWithoutLosingPrecision) {
+    EXPECT_EQ((Value(SMALL_MAX) + Value(1)).asInteger(), SMALL_MAX + 1);
+    EXPECT_EQ((Value(SMALL_MIN) - Value(1)).asInteger(), SMALL_MIN - 1);
+    EXPECT_EQ((Value(SMALL_MAX + 1) - Value(1)).asInteger(), SMALL_MAX);
+    EXPECT_EQ((Value(SMALL_MIN) * Value(-1)).asInteger(), SMALL_MAX + 1);
+    EXPECT_EQ((-Value(SMALL_MIN)).asInteger(), SMALL_MAX + 1);
+}
+
+TEST(SmallIntTest, OverflowPastInt64FallsBackToDouble) {
+    Value sum = Value(INT64_MAX) + Value(1);
+    EXPECT_FALSE(sum.isInteger());
+    EXPECT_DOUBLE_EQ(sum.asNumber(), 9223372036854775808.0);
+}
+
+// INT64_MIN % -1 traps in hardware, so it has to be answered before dividing
+TEST(IntegerTest, RemainderByMinusOneIsZero) {
+    Value remainder = Value(INT64_MIN) % Value(-1);
+    ASSERT_TRUE(remainder.isInteger());
+    EXPECT_EQ(remainder.asInteger(), 0);
+    EXPECT_EQ((Value(SMALL_MIN) % Value(-1)).asInteger(), 0);
+    EXPECT_EQ((Value(-7) % Value(2)).asInteger(), -1);
+}
+
+TEST(IntegerTest, MultiplyOverflowFallsBackToDouble) {
+    Value product = Value(INT64_MIN) * Value(-1);
+    EXPECT_FALSE(product.isInteger());
+    EXPECT_DOUBLE_EQ(product.asNumber(), 9223372036854775808.0);
+    EXPECT_EQ((Value(int64_t(1) << 40) * Value(int64_t(1) << 20)).asInteger(), int64_t(1) << 60);
+}
+
+TEST(CopyOnWriteTest, WritingACopyLeavesTheOriginalAlone) {
+    Value original(std::vector<Value>{Value("a"), Value("b")});
+    Value copy = original;
+    EXPECT_TRUE(original.sharesPayload());
+
+    copy.setElement(0, Value("z"));
+    EXPECT_EQ(original.elementAt(0).asString(), "a");
+    EXPECT_EQ(copy.elementAt(0).asString(), "z");
+    EXPECT_FALSE(original.sharesPayload());
+    EXPECT_FALSE(copy.sharesPayload());
+}
+
+TEST(CopyOnWriteTest, UniqueArrayIsWrittenInPlace) {
+    Value array(std::vector<Value>{Value("a"), Value("b")});
+    const Value* elements = array.asArray().data();
+    array.setElement(1, Value("c"));
+    EXPECT_EQ(array.asArray().data(), elements);
+    EXPECT_EQ(array.elementAt(1).asString(), "c");
+}
+
+TEST(CopyOnWriteTest, ObjectsDetachOnPropertyWrites) {
+    Value original = Value::emptyObject();
+    original.setProperty("x", Value(1));
+    Value copy = original;
+    copy.setProperty("x", Value(2));
+    copy.setProperty("y", Value(3));
+    EXPECT_EQ(original.findProperty("x")->asInteger(), 1);
+    EXPECT_EQ(original.findProperty("y"), nullptr);
+    EXPECT_EQ(copy.findProperty("x")->asInteger(), 2);
+}
+
+// Each '+' adds a rope node; a recursive flatten or destructor would
+// overflow the stack long before 200000 levels
+TEST(RopeTest, DeepLeftLeaningRopeFlattens) {
+    Value text(std::string(64, 'x'));
+    std::string expected(64, 'x');
+    for (int i = 0; i < 200000; ++i) {
+        text = text + Value("ab");
+        expected += "ab";
+    }
+    Value alias = text;
+    EXPECT_EQ(text.asString(), expected);
+    EXPECT_EQ(alias.asString(), expected);
+}
+
+TEST(RopeTest, DeepRightLeaningRopeFlattens) {
+    Value text(std::string(64, 'x'));
+    std::string expected;
+    for (int i = 0; i < 200000; ++i) {
+        text = Value("ab") + text;
+        expected += "ab";
+    }
+    EXPECT_EQ(text.asString(), expected + std::string(64, 'x'));
+}
+
+TEST(RopeTest, DeepRopeIsReleasedWithoutFlattening) {
+    Value text(std::string(64, 'x'));
+    for (int i = 0; i < 200000; ++i) text = text + Value("ab");
+    text = Value();
+    EXPECT_TRUE(text.isNil());
+}
+
+// A NaN whose bits fell in the tagged space would read back as nil, a
+// boolean, an integer or a heap pointer
+TEST(NanBoxingTest, EveryNanIsCanonicalized) {
+    const uint64_t patterns[] = {
+        0x7FF8000000000000ULL,  // Default quiet NaN
+        0xFFF8000000000000ULL,  // Negative quiet NaN
+        0x7FF0000000000001ULL,  // Signalling NaN
+        0x7FFC000000000001ULL,  // Same bits as the nil tag
+        0x7FFD000000000005ULL,  // Same bits as a small integer
+        0xFFFC000000001000ULL,  // Same bits as a heap pointer
+    };
+    for (uint64_t bits : patterns) {
+        Value value(doubleFromBits(bits));
+        EXPECT_EQ(value.getType(), ValueType::NUMBER) << std::hex << bits;
+        EXPECT_FALSE(value.isInteger()) << std::hex << bits;
+        EXPECT_TRUE(std::isnan(value.asNumber())) << std::hex << bits;
+    }
+}
+
+TEST(NanBoxingTest, InfinitiesAndSignedZeroKeepTheirBits) {
+    EXPECT_EQ(Value(INFINITY).asNumber(), INFINITY);
+    EXPECT_EQ(Value(-INFINITY).asNumber(), -INFINITY);
+    EXPECT_TRUE(std::signbit(Value(-0.0).asNumber()));
+}
+
+} // namespace